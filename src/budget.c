@@ -0,0 +1,128 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "budget.h"
+
+static MEMORY_BUDGET budget; // the process has a single budget
+
+static THREAD_LOCAL LONGLONG url_bytes = 0; // charged by this thread for its url
+
+static THREAD_LOCAL LONGLONG url_peak = 0; // most url_bytes reached for the url
+
+static const char *area_names[MEM_AREAS] = {"reply headers", "shared hop replies", 
+        "capture copies", "queued results"};
+
+/*
+ * Raises peak to value if it is higher
+ */
+static void raise_peak(volatile LONGLONG *peak, LONGLONG value) {
+    LONGLONG old;
+    while ((old = *peak) < value) {
+        if (InterlockedCompareExchange64(peak, value, old) == old) break;
+    }
+}
+
+/*
+ * Sets the bytes admitted urls may keep in use, 0 for no limit
+ */
+void set_budget(LONGLONG limit) {
+    budget.limit = limit;
+    budget.per_url = BUDGET_URL_GUESS;
+}
+
+/*
+ * Counts bytes newly kept by an area
+ */
+void budget_charge(int area, LONGLONG bytes) {
+    if (!bytes) return;
+    url_bytes += bytes;
+    if (url_bytes > url_peak) url_peak = url_bytes;
+    raise_peak(&budget.peak[area], InterlockedExchangeAdd64(&budget.used[area], bytes) + bytes);
+    raise_peak(&budget.total_peak, InterlockedExchangeAdd64(&budget.total, bytes) + bytes);
+}
+
+/*
+ * Gives back bytes counted by budget_charge()
+ */
+void budget_release(int area, LONGLONG bytes) {
+    if (!bytes) return;
+    url_bytes -= bytes;
+    InterlockedExchangeAdd64(&budget.used[area], -bytes);
+    InterlockedExchangeAdd64(&budget.total, -bytes);
+}
+
+/*
+ * Marks the start of probing a url on this thread, budget_leave()
+ * follows once its results are handed on
+ */
+void budget_enter(void) {
+    url_bytes = url_peak = 0;
+}
+
+/*
+ * Marks the end of probing a url on this thread and learns from the
+ * most it kept at once
+ * The estimate follows peaks at once and forgets them slowly
+ */
+void budget_leave(void) {
+    LONGLONG per_url = budget.per_url;
+    budget.per_url = url_peak > per_url ? url_peak : per_url - per_url / 64;
+}
+
+/*
+ * Returns TRUE if another url may be started next to in_progress
+ * ones, FALSE if it should wait for some of them to finish
+ * in_progress counts urls admitted and not finished, probing or not
+ * Each is expected to keep as much as urls kept lately, whether or
+ * not it got that far yet, so urls admitted together can not
+ * overshoot the budget
+ * One url is always admitted when none are in progress
+ */
+BOOL budget_admit(u_int in_progress) {
+    if (!budget.limit || !in_progress) return TRUE;
+    
+    LONGLONG per_url = budget.per_url;
+    LONGLONG expected = per_url * in_progress;
+    if (budget.total > expected) expected = budget.total;
+    if (expected + per_url <= budget.limit) return TRUE;
+    InterlockedIncrement64(&budget.deferred);
+    return FALSE;
+}
+
+/*
+ * Prints the bytes in use and the peak of every area
+ */
+void print_budget(void) {
+    printf("\nMemory in use (KB)                 now       peak\n");
+    for (int i = 0; i < MEM_AREAS; i++) {
+        printf("    %-24s %10lld %10lld\n", area_names[i], budget.used[i] >> 10, 
+                budget.peak[i] >> 10);
+    }
+    printf("    %-24s %10lld %10lld\n", "total", budget.total >> 10, budget.total_peak >> 10);
+    if (budget.limit) {
+        printf("Budget %lld KB, %lld KB expected per url, urls held back %lld times\n", 
+                budget.limit >> 10, budget.per_url >> 10, budget.deferred);
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   budget.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Memory budget of a run
+ * Every area holding data of urls in progress counts the bytes it
+ * keeps, a new url is only admitted if the urls in progress and the
+ * new one are expected to stay under the budget given with -M
+ * 
+ * Created on October 26, 2026, 5:40 PM
+ */
+
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+
+#define BUDGET_URL_GUESS (32 << 10) // bytes a url is thought to keep until one is seen
+
+// Areas of memory counted against the budget
+enum {
+    MEM_HEADERS, // parsed reply headers of the chains being reported
+    MEM_HOPS, // replies fetched, kept while chains share them
+    MEM_CAPTURE, // raw bytes copied into chains for the capture
+    MEM_RESULTS, // results text queued for the writer
+    MEM_AREAS
+};
+
+// Bytes in use by area, and the highest they reached
+typedef struct {
+    volatile LONGLONG used[MEM_AREAS];
+    volatile LONGLONG peak[MEM_AREAS];
+    volatile LONGLONG total; // sum of used
+    volatile LONGLONG total_peak;
+    LONGLONG limit; // bytes, 0 for no budget
+    volatile LONGLONG per_url; // most bytes a url kept at once, lately
+    volatile LONGLONG deferred; // times a url was held back
+}MEMORY_BUDGET;
+
+void set_budget(LONGLONG limit);
+void budget_charge(int area, LONGLONG bytes);
+void budget_release(int area, LONGLONG bytes);
+void budget_enter(void);
+void budget_leave(void);
+BOOL budget_admit(u_int in_progress);
+void print_budget(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUDGET_H */
@@ -0,0 +1,243 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "capture.h"
+
+/*
+ * Checks that the map starts with a capture header of this build
+ */
+static BOOL valid_header(const MAPPED_FILE *map) {
+    const CAPTURE_HEADER *header = (const CAPTURE_HEADER*) map->data;
+    return map->size >= sizeof(CAPTURE_HEADER) && 
+            memcmp(header->magic, CAPTURE_MAGIC, 8) == 0 &&
+            header->record_size == sizeof(CAPTURE_RECORD);
+}
+
+/*
+ * Size of a record holding fields of the given lengths
+ */
+static u_int record_size(const u_int lengths[CAPTURE_FIELDS]) {
+    ULONGLONG size = sizeof(CAPTURE_RECORD);
+    for (int i = 0; i < CAPTURE_FIELDS; i++) size += lengths[i] + 1;
+    return (u_int) ((size + 7) & ~7ULL);
+}
+
+/*
+ * Returns the record at pos, NULL if the map ends before it does
+ */
+static const CAPTURE_RECORD *record_at(const MAPPED_FILE *map, ULONGLONG pos) {
+    if (pos + sizeof(CAPTURE_RECORD) > map->size) return NULL;
+    const CAPTURE_RECORD *record = (const CAPTURE_RECORD*) (map->data + pos);
+    for (int i = 0; i < CAPTURE_FIELDS; i++) {
+        if (record->lengths[i] > map->size) return NULL;
+    }
+    if (record->size != record_size(record->lengths) || 
+            pos + record->size > map->size) return NULL;
+    return record;
+}
+
+/*
+ * Opens the capture file for appending, creating it if needed
+ * A record torn by a crash is cut off
+ * Returns NULL if the file can not be opened or is not a capture
+ */
+CAPTURE *open_capture(const char *name) {
+    MAPPED_FILE map;
+    ULONGLONG size = 0;
+    u_int chain = 0;
+    
+    if (map_file(name, &map)) {
+        if (map.size && !valid_header(&map)) {
+            printf("not a capture file: %s\n", name);
+            unmap_file(&map);
+            return NULL;
+        }
+        const CAPTURE_RECORD *record;
+        ULONGLONG found = map.size;
+        if (map.size) {
+            size = sizeof(CAPTURE_HEADER);
+            while ((record = record_at(&map, size)) != NULL) {
+                chain = record->chain + 1;
+                size += record->size;
+            }
+        }
+        unmap_file(&map);
+        if (size != found && !truncate_file(name, size)) {
+            printf("unable to repair capture file: %s\n", name);
+            return NULL;
+        }
+    }
+    
+    FILE *file = fopen(name, "ab");
+    if (!file) {
+        printf("unable to open capture file: %s\n", name);
+        return NULL;
+    }
+    if (!size) {
+        CAPTURE_HEADER header;
+        memset(&header, 0, sizeof(CAPTURE_HEADER));
+        memcpy(header.magic, CAPTURE_MAGIC, 8);
+        header.version = 1;
+        header.record_size = sizeof(CAPTURE_RECORD);
+        fwrite(&header, sizeof(CAPTURE_HEADER), 1, file);
+    }
+    CAPTURE *capture = (CAPTURE*) malloc(sizeof(CAPTURE));
+    capture->file = file;
+    capture->chain = chain;
+    InitializeCriticalSection(&capture->lock);
+    return capture;
+}
+
+/*
+ * Appends every hop of a chain, count records and their fields
+ * Field lengths must be set in the records, NULL fields are stored empty
+ * The hops are written together under the chain's new id and flushed,
+ * so chains of different workers never interleave
+ */
+void capture_chain(CAPTURE *capture, CAPTURE_RECORD *records, 
+        const char *(*fields)[CAPTURE_FIELDS], u_int count) {
+    static const char padding[8];
+    
+    EnterCriticalSection(&capture->lock);
+    for (u_int i = 0; i < count; i++) {
+        CAPTURE_RECORD *record = &records[i];
+        u_int written = sizeof(CAPTURE_RECORD);
+        record->chain = capture->chain;
+        record->size = record_size(record->lengths);
+        fwrite(record, sizeof(CAPTURE_RECORD), 1, capture->file);
+        for (int k = 0; k < CAPTURE_FIELDS; k++) {
+            if (fields[i][k]) fwrite(fields[i][k], 1, record->lengths[k], capture->file);
+            fputc('\0', capture->file);
+            written += record->lengths[k] + 1;
+        }
+        fwrite(padding, 1, record->size - written, capture->file);
+    }
+    capture->chain++;
+    fflush(capture->file);
+    LeaveCriticalSection(&capture->lock);
+}
+
+/*
+ * Closes the capture
+ */
+void close_capture(CAPTURE *capture) {
+    fclose(capture->file);
+    DeleteCriticalSection(&capture->lock);
+    free(capture);
+}
+
+/*
+ * Microseconds between two QueryPerformanceCounter() values,
+ * until now if until is NULL
+ */
+u_int capture_micros(LARGE_INTEGER *since, LARGE_INTEGER *until) {
+    LARGE_INTEGER now, frequency;
+    if (!until) {
+        QueryPerformanceCounter(&now);
+        until = &now;
+    }
+    QueryPerformanceFrequency(&frequency);
+    return (u_int) ((until->QuadPart - since->QuadPart) * 1000000 / frequency.QuadPart);
+}
+
+/*
+ * Duplicates the given bytes, NULL if there are none
+ */
+static char *copy_bytes(const char *bytes, u_int len) {
+    if (!bytes) return NULL;
+    char *copy = (char*) malloc(len + 1);
+    memcpy(copy, bytes, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+/*
+ * Copies a hop capture, the copy owns its own buffers
+ */
+void copy_hop_capture(HOP_CAPTURE *to, const HOP_CAPTURE *from) {
+    *to = *from;
+    to->request = copy_bytes(from->request, from->request_len);
+    to->reply = copy_bytes(from->reply, from->reply_len);
+}
+
+/*
+ * Frees the buffers of a hop capture
+ */
+void free_hop_capture(HOP_CAPTURE *capture) {
+    if (capture->request) free(capture->request);
+    if (capture->reply) free(capture->reply);
+    capture->request = capture->reply = NULL;
+}
+
+/*
+ * Maps the capture file for replaying
+ * Returns FALSE if it can not be read or is not a capture
+ */
+BOOL open_replay(const char *name, CAPTURE_READER *reader) {
+    if (!map_file(name, &reader->map)) {
+        printf("unable to open capture file: %s\n", name);
+        return FALSE;
+    }
+    if (!valid_header(&reader->map)) {
+        printf("not a capture file: %s\n", name);
+        unmap_file(&reader->map);
+        return FALSE;
+    }
+    replay_rewind(reader);
+    return TRUE;
+}
+
+/*
+ * Returns the next record and points fields into the map,
+ * every field is followed by a NUL
+ * Returns NULL at the end of the capture
+ */
+const CAPTURE_RECORD *replay_next(CAPTURE_READER *reader, 
+        const char *fields[CAPTURE_FIELDS]) {
+    const CAPTURE_RECORD *record = record_at(&reader->map, reader->pos);
+    if (!record) return NULL;
+    
+    const char *field = (const char*) (record + 1);
+    for (int i = 0; i < CAPTURE_FIELDS; i++) {
+        fields[i] = field;
+        field += record->lengths[i] + 1;
+    }
+    reader->pos += record->size;
+    return record;
+}
+
+/*
+ * Starts the capture over from its first record
+ */
+void replay_rewind(CAPTURE_READER *reader) {
+    reader->pos = sizeof(CAPTURE_HEADER);
+}
+
+/*
+ * Releases the capture
+ */
+void close_replay(CAPTURE_READER *reader) {
+    unmap_file(&reader->map);
+}
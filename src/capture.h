@@ -0,0 +1,142 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   capture.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Captures of the raw bytes of each hop
+ * Record mode appends the request, the reply exactly as received and
+ * the timing of every hop to a capture file, replay mode reads them
+ * back through the reply parser and the report without any network
+ * 
+ * Created on October 24, 2026, 4:15 PM
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+#include "sockopt.h"
+
+#define CAPTURE_MAGIC "ARCCAP1"
+#define CAPTURE_TAPE_MAX (16 << 20) // reply bytes kept per hop, the rest is dropped
+
+// Flags of a captured hop
+#define CAPTURE_GET 1 // body was read
+#define CAPTURE_DECODE 2 // body was decoded
+#define CAPTURE_FAILED 4 // hop failed before a reply, see CF_FAIL_*
+#define CAPTURE_TRUNCATED 8 // reply was longer than CAPTURE_TAPE_MAX
+#define CAPTURE_LOOP 16 // last hop, its redirect leads back into the chain
+#define CAPTURE_TOO_LONG 32 // last hop, redirect not followed after the hop limit
+
+// Fields stored after each record, in this order
+enum {
+    CF_URL,
+    CF_SERVER_IP,
+    CF_CLIENT_IP,
+    CF_FAIL_CODE,
+    CF_FAIL_REASON,
+    CF_REQUEST,
+    CF_REPLY,
+    CAPTURE_FIELDS
+};
+
+// Times of a hop in microseconds since it started
+enum {
+    CT_RESOLVED,
+    CT_CONNECTED,
+    CT_FIRST_BYTE,
+    CT_DONE,
+    CAPTURE_TIMES
+};
+
+// Start of a capture file
+typedef struct {
+    char magic[8];
+    u_int version;
+    u_int record_size; // size of CAPTURE_RECORD, the fields not included
+}CAPTURE_HEADER;
+
+// One hop as stored in a capture
+// Each field follows with a NUL after it, the record is padded to 8 bytes
+typedef struct {
+    u_int size; // bytes of the record including this header and padding
+    u_int chain; // hops of the same chain share this and are stored together
+    ULONGLONG time; // seconds since 1970
+    u_short hop; // position in the chain
+    u_short flags;
+    u_short server_port;
+    u_short client_port;
+    u_int times[CAPTURE_TIMES];
+    TCP_STATS tcp;
+    u_int lengths[CAPTURE_FIELDS];
+}CAPTURE_RECORD;
+
+// Raw bytes and timing of a hop, kept until its chain is captured
+typedef struct {
+    u_int flags;
+    char *request;
+    u_int request_len;
+    char *reply;
+    u_int reply_len;
+    u_int times[CAPTURE_TIMES];
+    TCP_STATS tcp; // read before the connection is closed or given back
+}HOP_CAPTURE;
+
+// Capture opened for recording
+typedef struct {
+    FILE *file;
+    u_int chain; // next chain id
+    CRITICAL_SECTION lock;
+}CAPTURE;
+
+// Capture opened for replaying
+typedef struct {
+    MAPPED_FILE map;
+    ULONGLONG pos; // offset of the next record
+}CAPTURE_READER;
+
+CAPTURE *open_capture(const char *name);
+void capture_chain(CAPTURE *capture, CAPTURE_RECORD *records, 
+        const char *(*fields)[CAPTURE_FIELDS], u_int count);
+void close_capture(CAPTURE *capture);
+u_int capture_micros(LARGE_INTEGER *since, LARGE_INTEGER *until);
+void copy_hop_capture(HOP_CAPTURE *to, const HOP_CAPTURE *from);
+void free_hop_capture(HOP_CAPTURE *capture);
+BOOL open_replay(const char *name, CAPTURE_READER *reader);
+const CAPTURE_RECORD *replay_next(CAPTURE_READER *reader, 
+        const char *fields[CAPTURE_FIELDS]);
+void replay_rewind(CAPTURE_READER *reader);
+void close_replay(CAPTURE_READER *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAPTURE_H */
@@ -0,0 +1,270 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "decode.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_BROTLI
+#include <brotli/decode.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/*
+ * Returns the Accept-Encoding value listing every compiled in coding,
+ * NULL if there are none
+ */
+const char *accepted_encodings(void) {
+    static const char *list = ""
+#ifdef HAVE_ZLIB
+            ", gzip, deflate"
+#endif
+#ifdef HAVE_BROTLI
+            ", br"
+#endif
+#ifdef HAVE_ZSTD
+            ", zstd"
+#endif
+            ;
+    return list[0] ? list + 2 : NULL;
+}
+
+/*
+ * Returns the coding named by a Content-Encoding value
+ * Only a single coding is understood, stacked codings are unknown
+ */
+int coding_from_header(const char *value, u_int len) {
+    while (len && (value[len - 1] == ' ' || value[len - 1] == '\t' || 
+            value[len - 1] == '\r')) len--;
+    if (!len || (len == 8 && _strnicmp(value, "identity", 8) == 0)) return CODING_IDENTITY;
+    if (len == 4 && _strnicmp(value, "gzip", 4) == 0) return CODING_GZIP;
+    if (len == 6 && _strnicmp(value, "x-gzip", 6) == 0) return CODING_GZIP;
+    if (len == 7 && _strnicmp(value, "deflate", 7) == 0) return CODING_DEFLATE;
+    if (len == 2 && _strnicmp(value, "br", 2) == 0) return CODING_BR;
+    if (len == 4 && _strnicmp(value, "zstd", 4) == 0) return CODING_ZSTD;
+    return CODING_UNKNOWN;
+}
+
+/*
+ * Returns the name of the coding for results
+ */
+const char *coding_name(int coding) {
+    static const char *names[] = {"identity", "gzip", "deflate", "br", "zstd", "unknown"};
+    return names[coding];
+}
+
+/*
+ * Prepares the decoder for a body in the given coding
+ * A coding that is not compiled in marks the decoder failed
+ */
+void decoder_init(BODY_DECODER *decoder, int coding) {
+    memset(decoder, 0, sizeof(BODY_DECODER));
+    decoder->coding = coding;
+    decoder->failed = TRUE;
+    switch (coding) {
+#ifdef HAVE_ZLIB
+        case CODING_GZIP:
+        case CODING_DEFLATE: {
+            z_stream *stream = (z_stream*) calloc(1, sizeof(z_stream));
+            // adding 32 accepts both the gzip and the zlib wrapper,
+            // deflate without either is retried raw by decoder_feed()
+            if (inflateInit2(stream, 15 + 32) != Z_OK) {
+                free(stream);
+                return;
+            }
+            decoder->state = stream;
+            break;
+        }
+#endif
+#ifdef HAVE_BROTLI
+        case CODING_BR:
+            decoder->state = BrotliDecoderCreateInstance(NULL, NULL, NULL);
+            if (!decoder->state) return;
+            break;
+#endif
+#ifdef HAVE_ZSTD
+        case CODING_ZSTD:
+            decoder->state = ZSTD_createDStream();
+            if (!decoder->state) return;
+            ZSTD_initDStream((ZSTD_DStream*) decoder->state);
+            break;
+#endif
+        default:
+            return;
+    }
+    decoder->out = (unsigned char*) malloc(DECODE_BUFFER);
+    decoder->failed = FALSE;
+}
+
+#ifdef HAVE_ZLIB
+/*
+ * Inflates the given bytes, counting and dropping the output
+ * Returns the last inflate() status, Z_STREAM_END once the stream is done
+ */
+static int inflate_piece(BODY_DECODER *decoder, const unsigned char *data, u_int len) {
+    z_stream *stream = (z_stream*) decoder->state;
+    int status;
+    stream->next_in = (Bytef*) data;
+    stream->avail_in = len;
+    // a full buffer may leave output pending, so go round again
+    do {
+        stream->next_out = decoder->out;
+        stream->avail_out = DECODE_BUFFER;
+        status = inflate(stream, Z_NO_FLUSH);
+        decoder->decoded_size += DECODE_BUFFER - stream->avail_out;
+        if (status == Z_STREAM_END) decoder->done = TRUE;
+        else if (status != Z_OK && status != Z_BUF_ERROR) break;
+    } while (!decoder->done && (stream->avail_in || !stream->avail_out));
+    return status;
+}
+#endif
+
+/*
+ * Decodes the next piece of the body
+ * Output is counted and dropped, bytes after the end of the
+ * compressed stream are ignored
+ */
+void decoder_feed(BODY_DECODER *decoder, const unsigned char *data, u_int len) {
+    if (decoder->failed || decoder->done || !len) return;
+#if !defined(HAVE_ZLIB) && !defined(HAVE_BROTLI) && !defined(HAVE_ZSTD)
+    (void) data; // no decoder compiled in
+#endif
+    LARGE_INTEGER start, end;
+    QueryPerformanceCounter(&start);
+    
+    switch (decoder->coding) {
+#ifdef HAVE_ZLIB
+        case CODING_GZIP:
+        case CODING_DEFLATE: {
+            z_stream *stream = (z_stream*) decoder->state;
+            u_int lead = decoder->lead_len;
+            for (u_int i = 0; decoder->lead_len < 2 && i < len; i++) {
+                decoder->lead[decoder->lead_len++] = data[i];
+            }
+            int status = inflate_piece(decoder, data, len);
+            // some servers send deflate without the zlib wrapper, start over as
+            // raw if the wrapper header was refused, everything it took is in lead
+            if (status == Z_DATA_ERROR && decoder->coding == CODING_DEFLATE && 
+                    !decoder->raw && stream->total_in <= 2 && 
+                    inflateReset2(stream, -15) == Z_OK) {
+                decoder->raw = TRUE;
+                status = inflate_piece(decoder, decoder->lead, lead);
+                if (status == Z_OK || status == Z_BUF_ERROR) {
+                    status = inflate_piece(decoder, data, len);
+                }
+            }
+            if (status != Z_OK && status != Z_BUF_ERROR && status != Z_STREAM_END) {
+                decoder->failed = TRUE;
+            }
+            break;
+        }
+#endif
+#ifdef HAVE_BROTLI
+        case CODING_BR: {
+            size_t in_left = len;
+            const uint8_t *in = data;
+            while (!decoder->done) {
+                size_t out_left = DECODE_BUFFER;
+                uint8_t *out = decoder->out;
+                BrotliDecoderResult status = BrotliDecoderDecompressStream(
+                        (BrotliDecoderState*) decoder->state, &in_left, &in, 
+                        &out_left, &out, NULL);
+                decoder->decoded_size += DECODE_BUFFER - out_left;
+                if (status == BROTLI_DECODER_RESULT_SUCCESS) decoder->done = TRUE;
+                else if (status == BROTLI_DECODER_RESULT_ERROR) {
+                    decoder->failed = TRUE;
+                    break;
+                }
+                else if (status == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT) break;
+            }
+            break;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case CODING_ZSTD: {
+            ZSTD_inBuffer in = {data, len, 0};
+            while (!decoder->done) {
+                ZSTD_outBuffer out = {decoder->out, DECODE_BUFFER, 0};
+                size_t status = ZSTD_decompressStream((ZSTD_DStream*) decoder->state, 
+                        &out, &in);
+                decoder->decoded_size += out.pos;
+                if (ZSTD_isError(status)) {
+                    decoder->failed = TRUE;
+                    break;
+                }
+                if (!status) decoder->done = TRUE;
+                else if (in.pos == in.size && out.pos < out.size) break;
+            }
+            break;
+        }
+#endif
+    }
+    QueryPerformanceCounter(&end);
+    decoder->ticks += end.QuadPart - start.QuadPart;
+}
+
+/*
+ * Releases the library stream and buffer of the decoder
+ * A stream that stopped before its end is marked failed
+ */
+void decoder_end(BODY_DECODER *decoder) {
+    if (decoder->state) {
+        switch (decoder->coding) {
+#ifdef HAVE_ZLIB
+            case CODING_GZIP:
+            case CODING_DEFLATE:
+                inflateEnd((z_stream*) decoder->state);
+                free(decoder->state);
+                break;
+#endif
+#ifdef HAVE_BROTLI
+            case CODING_BR:
+                BrotliDecoderDestroyInstance((BrotliDecoderState*) decoder->state);
+                break;
+#endif
+#ifdef HAVE_ZSTD
+            case CODING_ZSTD:
+                ZSTD_freeDStream((ZSTD_DStream*) decoder->state);
+                break;
+#endif
+        }
+        decoder->state = NULL;
+    }
+    if (decoder->out) free(decoder->out);
+    decoder->out = NULL;
+    if (!decoder->done) decoder->failed = TRUE;
+}
+
+/*
+ * Returns the time spent decoding in seconds
+ */
+double decoder_seconds(BODY_DECODER *decoder) {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (double) decoder->ticks / (double) frequency.QuadPart;
+}
@@ -0,0 +1,87 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   decode.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Streaming Content-Encoding decoders
+ * Bodies are decoded a piece at a time into a fixed buffer and only
+ * counted, so memory stays the same however large the output gets
+ * Each coding is compiled in when its library is available:
+ *      HAVE_ZLIB   gzip, deflate (link zlib)
+ *      HAVE_BROTLI br (link brotlidec)
+ *      HAVE_ZSTD   zstd (link zstd)
+ * 
+ * Created on October 22, 2026, 2:15 PM
+ */
+
+#ifndef DECODE_H
+#define DECODE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+
+#define DECODE_BUFFER 65536 // decoded bytes produced at once
+
+// Content codings
+enum {
+    CODING_IDENTITY,
+    CODING_GZIP,
+    CODING_DEFLATE,
+    CODING_BR,
+    CODING_ZSTD,
+    CODING_UNKNOWN
+};
+
+// Decoder of one body
+typedef struct {
+    int coding;
+    void *state; // library stream
+    unsigned char *out; // DECODE_BUFFER bytes
+    ULONGLONG decoded_size;
+    ULONGLONG ticks; // time spent decoding, QueryPerformanceCounter units
+    BOOL done; // end of the compressed stream reached
+    BOOL failed; // corrupt data or coding not compiled in
+    BOOL raw; // deflate sent without its zlib wrapper
+    unsigned char lead[2]; // first bytes, fed again if the wrapper is missing
+    u_int lead_len;
+}BODY_DECODER;
+
+const char *accepted_encodings(void);
+int coding_from_header(const char *value, u_int len);
+const char *coding_name(int coding);
+void decoder_init(BODY_DECODER *decoder, int coding);
+void decoder_feed(BODY_DECODER *decoder, const unsigned char *data, u_int len);
+void decoder_end(BODY_DECODER *decoder);
+double decoder_seconds(BODY_DECODER *decoder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DECODE_H */
@@ -0,0 +1,751 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "h2.h"
+#include <ctype.h>
+
+#define PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n" // client connection preface
+#define FRAME_HEADER 9 // bytes before every frame payload
+
+// Frame types
+enum {
+    FRAME_DATA = 0,
+    FRAME_HEADERS = 1,
+    FRAME_RST_STREAM = 3,
+    FRAME_SETTINGS = 4,
+    FRAME_PUSH_PROMISE = 5,
+    FRAME_PING = 6,
+    FRAME_GOAWAY = 7,
+    FRAME_WINDOW_UPDATE = 8,
+    FRAME_CONTINUATION = 9
+};
+
+// Frame flags
+#define FLAG_END_STREAM 0x1
+#define FLAG_ACK 0x1
+#define FLAG_END_HEADERS 0x4
+#define FLAG_PADDED 0x8
+#define FLAG_PRIORITY 0x20
+
+#define SETTINGS_ENABLE_PUSH 0x2
+#define SETTINGS_MAX_CONCURRENT_STREAMS 0x3
+#define ERROR_REFUSED_STREAM 0x7
+
+// Reason phrases, HTTP/2 replies carry the status code only
+static const struct {
+    int code;
+    const char *reason;
+} reasons[] = {
+    {200, "OK"}, {201, "Created"}, {202, "Accepted"}, {204, "No Content"},
+    {206, "Partial Content"}, {301, "Moved Permanently"}, {302, "Found"},
+    {303, "See Other"}, {304, "Not Modified"}, {307, "Temporary Redirect"},
+    {308, "Permanent Redirect"}, {400, "Bad Request"}, {401, "Unauthorized"},
+    {403, "Forbidden"}, {404, "Not Found"}, {405, "Method Not Allowed"},
+    {410, "Gone"}, {429, "Too Many Requests"}, {500, "Internal Server Error"},
+    {501, "Not Implemented"}, {502, "Bad Gateway"}, {503, "Service Unavailable"},
+    {504, "Gateway Timeout"}, {0, ""}
+};
+
+// Header block being decoded for a stream
+typedef struct {
+    H2_STREAM *stream; // NULL if the stream is gone, the block is decoded all the same
+    BOOL informational; // a 1xx status, dropped
+}BLOCK_TARGET;
+
+/*
+ * Reads exactly len bytes
+ * Returns FALSE if the connection fails or closes first
+ */
+static BOOL recv_all(SOCKET s, unsigned char *data, u_int len) {
+    while (len) {
+        int got = recv(s, (char*) data, len, 0);
+        if (got <= 0) return FALSE;
+        data += got;
+        len -= got;
+    }
+    return TRUE;
+}
+
+/*
+ * Sends a frame, the connection's lock must be held so frames of
+ * several threads do not interleave
+ * Returns FALSE if the connection fails
+ */
+static BOOL send_frame(H2_CONNECTION *connection, int type, int flags, u_int id, 
+        const unsigned char *payload, u_int len) {
+    unsigned char *frame = (unsigned char*) malloc(FRAME_HEADER + len);
+    u_int sent = 0, total = FRAME_HEADER + len;
+    
+    frame[0] = (unsigned char) (len >> 16);
+    frame[1] = (unsigned char) (len >> 8);
+    frame[2] = (unsigned char) len;
+    frame[3] = (unsigned char) type;
+    frame[4] = (unsigned char) flags;
+    frame[5] = (unsigned char) ((id >> 24) & 0x7f);
+    frame[6] = (unsigned char) (id >> 16);
+    frame[7] = (unsigned char) (id >> 8);
+    frame[8] = (unsigned char) id;
+    if (len) memcpy(frame + FRAME_HEADER, payload, len);
+    while (!connection->closed && sent < total) {
+        int out = send(connection->s, (char*) frame + sent, total - sent, 0);
+        if (out <= 0) break;
+        sent += out;
+    }
+    free(frame);
+    return sent == total;
+}
+
+/*
+ * Reads a 32 bit big endian number
+ */
+static u_int read_u32(const unsigned char *data) {
+    return ((u_int) data[0] << 24) | ((u_int) data[1] << 16) | ((u_int) data[2] << 8) | 
+            data[3];
+}
+
+/*
+ * Returns the open stream with the id, NULL if there is none
+ * The connection's lock must be held
+ */
+static H2_STREAM *find_stream(H2_CONNECTION *connection, u_int id) {
+    for (u_int i = 0; i < connection->stream_count; i++) {
+        if (connection->streams[i]->id == id) return connection->streams[i];
+    }
+    return NULL;
+}
+
+/*
+ * Ends a stream and wakes the request waiting on it
+ * The connection's lock must be held
+ */
+static void end_stream(H2_CONNECTION *connection, H2_STREAM *stream, int state, 
+        const char *reason, BOOL retry) {
+    if (!stream || stream->state != H2_OPEN) return;
+    stream->state = state;
+    stream->reason = reason;
+    stream->retry = retry;
+    WakeAllConditionVariable(&connection->changed);
+}
+
+/*
+ * Appends text to a head, line breaks in it become spaces so a field
+ * can not add lines of its own
+ */
+static void append_text(TEXT_BUFFER *head, const char *text, u_int len) {
+    u_int start = head->len;
+    text_append(head, "%.*s", len, text);
+    for (u_int i = start; i < head->len; i++) {
+        if (head->data[i] == '\r' || head->data[i] == '\n') head->data[i] = ' ';
+    }
+}
+
+/*
+ * Adds a decoded field to the head of the stream the block is for
+ * :status becomes the status line, other pseudo headers are dropped
+ */
+static BOOL add_field(void *context, const char *name, u_int name_len, 
+        const char *value, u_int value_len) {
+    BLOCK_TARGET *target = (BLOCK_TARGET*) context;
+    H2_STREAM *stream = target->stream;
+    
+    if (name_len == 7 && memcmp(name, ":status", 7) == 0) {
+        target->informational = value_len && value[0] == '1';
+        if (!stream || target->informational) return TRUE;
+        int code = 0, i = 0;
+        // decoded values are not terminated
+        for (u_int j = 0; j < value_len && j < 3 && isdigit((unsigned char) value[j]); j++) {
+            code = code * 10 + value[j] - '0';
+        }
+        while (reasons[i].code && reasons[i].code != code) i++;
+        text_append(&stream->head, "HTTP/2.0 %03d %s\r\n", code, reasons[i].reason);
+        return TRUE;
+    }
+    // fields before the status are malformed, the head then stays empty
+    if (!stream || target->informational || !stream->head.len || 
+            (name_len && name[0] == ':')) return TRUE;
+    append_text(&stream->head, name, name_len);
+    text_append(&stream->head, ": ");
+    append_text(&stream->head, value, value_len);
+    text_append(&stream->head, "\r\n");
+    return TRUE;
+}
+
+/*
+ * Decodes a complete header block for stream id and ends the stream
+ * if it was the final reply and the frame ended it
+ * Trailers and blocks of streams already gone still go through the
+ * decoder to keep its table in step
+ * Returns FALSE if the block can not be decoded
+ */
+static BOOL header_block(H2_CONNECTION *connection, u_int id, const unsigned char *block, 
+        u_int len, BOOL end) {
+    BLOCK_TARGET target;
+    LARGE_INTEGER now;
+    
+    QueryPerformanceCounter(&now);
+    EnterCriticalSection(&connection->lock);
+    target.stream = find_stream(connection, id);
+    // the request may go away once its stream ended, only this thread ends it
+    if (target.stream && (target.stream->state != H2_OPEN || target.stream->final)) {
+        target.stream = NULL;
+    }
+    LeaveCriticalSection(&connection->lock);
+    target.informational = FALSE;
+    if (target.stream && !target.stream->first_byte.QuadPart) target.stream->first_byte = now;
+    
+    BOOL decoded = hpack_decode(&connection->table, block, len, add_field, &target);
+    EnterCriticalSection(&connection->lock);
+    H2_STREAM *stream = find_stream(connection, id);
+    if (decoded && target.stream && !target.informational) {
+        if (target.stream->head.len) {
+            text_append(&target.stream->head, "\r\n");
+            target.stream->final = TRUE;
+        } else {
+            end_stream(connection, target.stream, H2_FAILED, "Reply without status", FALSE);
+        }
+    }
+    if (decoded && end && stream) {
+        if (stream->final) end_stream(connection, stream, H2_DONE, NULL, FALSE);
+        else end_stream(connection, stream, H2_FAILED, "Reply without status", FALSE);
+    }
+    LeaveCriticalSection(&connection->lock);
+    return decoded;
+}
+
+/*
+ * Takes the server's settings and acknowledges them
+ * Returns FALSE if the frame is malformed
+ */
+static BOOL take_settings(H2_CONNECTION *connection, const unsigned char *payload, 
+        u_int len) {
+    if (len % 6) return FALSE;
+    EnterCriticalSection(&connection->lock);
+    for (u_int i = 0; i < len; i += 6) {
+        u_int id = ((u_int) payload[i] << 8) | payload[i + 1];
+        u_int value = read_u32(payload + i + 2);
+        if (id == SETTINGS_MAX_CONCURRENT_STREAMS) {
+            connection->max_streams = value < 1 ? 1 : value > H2_STREAMS_MAX ? 
+                    H2_STREAMS_MAX : value;
+        }
+    }
+    connection->settled = TRUE;
+    send_frame(connection, FRAME_SETTINGS, FLAG_ACK, 0, NULL, 0);
+    WakeAllConditionVariable(&connection->changed);
+    LeaveCriticalSection(&connection->lock);
+    return TRUE;
+}
+
+/*
+ * Gives back the flow control window a DATA frame used, on the
+ * connection and on its stream
+ * HEAD replies have no body, this keeps a server that sends one anyway
+ * from stalling the other streams
+ */
+static void return_window(H2_CONNECTION *connection, u_int id, u_int len) {
+    unsigned char increment[4];
+    increment[0] = (unsigned char) (len >> 24);
+    increment[1] = (unsigned char) (len >> 16);
+    increment[2] = (unsigned char) (len >> 8);
+    increment[3] = (unsigned char) len;
+    EnterCriticalSection(&connection->lock);
+    send_frame(connection, FRAME_WINDOW_UPDATE, 0, 0, increment, 4);
+    if (find_stream(connection, id)) {
+        send_frame(connection, FRAME_WINDOW_UPDATE, 0, id, increment, 4);
+    }
+    LeaveCriticalSection(&connection->lock);
+}
+
+/*
+ * Drops the connection's memory once nothing refers to it
+ */
+static void release_connection(H2_CONNECTION *connection) {
+    if (InterlockedDecrement(&connection->refs)) return;
+    if (connection->reader) CloseHandle(connection->reader);
+    hpack_free(&connection->table);
+    DeleteCriticalSection(&connection->lock);
+    free(connection->origin);
+    free(connection);
+}
+
+/*
+ * Reader thread of a connection
+ * Reads frames until the connection fails or closes, decodes every
+ * header block in order and ends the streams their replies complete
+ * A server whose first frame is not SETTINGS does not speak HTTP/2
+ * Open streams are failed when it stops, or left to HTTP/1.1 if the
+ * origin turned out to have no h2c
+ */
+static DWORD WINAPI h2_reader(LPVOID param) {
+    H2_CONNECTION *connection = (H2_CONNECTION*) param;
+    unsigned char header[FRAME_HEADER];
+    unsigned char *payload = (unsigned char*) malloc(H2_FRAME_MAX);
+    unsigned char *block = NULL;
+    u_int block_len = 0, block_id = 0;
+    BOOL block_end = FALSE, failed = FALSE;
+    
+    while (!failed && recv_all(connection->s, header, FRAME_HEADER)) {
+        u_int len = ((u_int) header[0] << 16) | ((u_int) header[1] << 8) | header[2];
+        int type = header[3], flags = header[4];
+        u_int id = read_u32(header + 5) & 0x7fffffff;
+        
+        if (!connection->settled && type != FRAME_SETTINGS) break;
+        // a header block goes on in CONTINUATION frames and nothing else
+        if (len > H2_FRAME_MAX || (block && (type != FRAME_CONTINUATION || id != block_id))) {
+            break;
+        }
+        if (!recv_all(connection->s, payload, len)) break;
+        
+        const unsigned char *data = payload;
+        u_int data_len = len;
+        switch (type) {
+            case FRAME_HEADERS:
+                if (flags & FLAG_PADDED) {
+                    if (!len || payload[0] >= len) {
+                        failed = TRUE;
+                        break;
+                    }
+                    data++;
+                    data_len -= 1 + payload[0];
+                }
+                if (flags & FLAG_PRIORITY) {
+                    if (data_len < 5) {
+                        failed = TRUE;
+                        break;
+                    }
+                    data += 5;
+                    data_len -= 5;
+                }
+                block_id = id;
+                block_end = (flags & FLAG_END_STREAM) != 0;
+                // the fragment is gathered the same way as a continuation
+                /* fall through */
+            case FRAME_CONTINUATION:
+                if (type == FRAME_CONTINUATION && !block) {
+                    failed = TRUE;
+                    break;
+                }
+                if (block_len + data_len > H2_BLOCK_MAX) {
+                    failed = TRUE;
+                    break;
+                }
+                block = (unsigned char*) realloc(block, block_len + data_len + 1);
+                memcpy(block + block_len, data, data_len);
+                block_len += data_len;
+                if (flags & FLAG_END_HEADERS) {
+                    failed = !header_block(connection, block_id, block, block_len, block_end);
+                    free(block);
+                    block = NULL;
+                    block_len = 0;
+                }
+                break;
+            case FRAME_DATA:
+                if (len) return_window(connection, id, len);
+                if (flags & FLAG_END_STREAM) {
+                    EnterCriticalSection(&connection->lock);
+                    H2_STREAM *stream = find_stream(connection, id);
+                    if (stream && stream->final) end_stream(connection, stream, H2_DONE, NULL, FALSE);
+                    else end_stream(connection, stream, H2_FAILED, "Reply without status", FALSE);
+                    LeaveCriticalSection(&connection->lock);
+                }
+                break;
+            case FRAME_RST_STREAM:
+                if (len != 4) {
+                    failed = TRUE;
+                    break;
+                }
+                EnterCriticalSection(&connection->lock);
+                // a refused stream was not processed and may be sent again
+                end_stream(connection, find_stream(connection, id), H2_FAILED, "Stream reset", 
+                        read_u32(payload) == ERROR_REFUSED_STREAM);
+                LeaveCriticalSection(&connection->lock);
+                break;
+            case FRAME_SETTINGS:
+                if (!(flags & FLAG_ACK)) failed = !take_settings(connection, payload, len);
+                break;
+            case FRAME_PING:
+                if (len != 8) {
+                    failed = TRUE;
+                } else if (!(flags & FLAG_ACK)) {
+                    EnterCriticalSection(&connection->lock);
+                    send_frame(connection, FRAME_PING, FLAG_ACK, 0, payload, 8);
+                    LeaveCriticalSection(&connection->lock);
+                }
+                break;
+            case FRAME_GOAWAY:
+                if (len < 8) {
+                    failed = TRUE;
+                    break;
+                }
+                EnterCriticalSection(&connection->lock);
+                // streams past the last one the server took may go elsewhere
+                connection->draining = TRUE;
+                for (u_int i = 0; i < connection->stream_count; i++) {
+                    if (connection->streams[i]->id > (read_u32(payload) & 0x7fffffff)) {
+                        end_stream(connection, connection->streams[i], H2_FAILED, 
+                                "Connection closed", TRUE);
+                    }
+                }
+                LeaveCriticalSection(&connection->lock);
+                break;
+            case FRAME_PUSH_PROMISE:
+                // push is turned off in our settings
+                failed = TRUE;
+                break;
+        }
+    }
+    if (block) free(block);
+    free(payload);
+    
+    EnterCriticalSection(&connection->lock);
+    connection->closed = connection->draining = TRUE;
+    connection->refused = !connection->settled;
+    connection->idle_since = GetTickCount64();
+    closesocket(connection->s);
+    for (u_int i = 0; i < connection->stream_count; i++) {
+        H2_STREAM *stream = connection->streams[i];
+        if (connection->refused) end_stream(connection, stream, H2_UNSUPPORTED, NULL, FALSE);
+        else end_stream(connection, stream, H2_FAILED, "recv() failed", 
+                !stream->first_byte.QuadPart);
+    }
+    WakeAllConditionVariable(&connection->changed);
+    LeaveCriticalSection(&connection->lock);
+    release_connection(connection);
+    return 0;
+}
+
+/*
+ * Connects to the origin, sends the preface and our settings and
+ * starts the reader
+ * Requests for the origin wait on the connection meanwhile, if it
+ * fails they fail with it
+ */
+static void open_connection(H2_POOL *pool, H2_CONNECTION *connection, const char *ip, 
+        int port) {
+    struct sockaddr_in server, client;
+    int client_len = sizeof(client);
+    unsigned char settings[6] = {0, SETTINGS_ENABLE_PUSH, 0, 0, 0, 0};
+    BOOL opened = FALSE;
+    
+    SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = inet_addr(ip);
+    server.sin_port = htons(port);
+    if (s != INVALID_SOCKET && tune_socket(s, pool->tuning) && 
+            connect(s, (struct sockaddr*) &server, sizeof(server)) == 0) {
+        if (getsockname(s, (struct sockaddr*) &client, &client_len) == 0) {
+            snprintf(connection->client_ip, 100, "%s", inet_ntoa(client.sin_addr));
+            connection->client_port = ntohs(client.sin_port);
+        }
+        opened = send(s, PREFACE, strlen(PREFACE), 0) == (int) strlen(PREFACE);
+    }
+    
+    EnterCriticalSection(&connection->lock);
+    connection->s = s;
+    connection->connecting = FALSE;
+    // the pool may have dropped it while connecting
+    opened = opened && !connection->draining && 
+            send_frame(connection, FRAME_SETTINGS, 0, 0, settings, 6);
+    if (opened) {
+        InterlockedIncrement(&connection->refs);
+        connection->reader = CreateThread(NULL, 0, h2_reader, connection, 0, NULL);
+        if (!connection->reader) {
+            printf("Could not create h2c reader thread\n");
+            InterlockedDecrement(&connection->refs);
+            opened = FALSE;
+        }
+    }
+    if (opened) {
+        InterlockedIncrement(&pool->opened);
+    } else {
+        if (s != INVALID_SOCKET) closesocket(s);
+        connection->closed = connection->draining = TRUE;
+        connection->idle_since = GetTickCount64();
+    }
+    WakeAllConditionVariable(&connection->changed);
+    LeaveCriticalSection(&connection->lock);
+}
+
+/*
+ * Drops the pool's hold on the connection at index, closing it if it
+ * is still open, the pool's lock must be held
+ */
+static void drop_connection(H2_POOL *pool, u_int index) {
+    H2_CONNECTION *connection = pool->connections[index];
+    EnterCriticalSection(&connection->lock);
+    connection->draining = TRUE;
+    // the reader wakes up, closes the socket and ends
+    if (!connection->closed && !connection->connecting) shutdown(connection->s, SD_BOTH);
+    LeaveCriticalSection(&connection->lock);
+    pool->connections[index] = pool->connections[--pool->count];
+    release_connection(connection);
+}
+
+/*
+ * Finds the connection of an origin, opening one if there is none
+ * that takes new streams, and holds it for the caller
+ * The connection goes in the pool before it is opened so the workers
+ * asking for the origin meanwhile share it instead of opening more
+ * Closed connections and idle ones are dropped on the way, origins
+ * without h2c are remembered for H2_REFUSED_MS
+ * Returns NULL if the origin has no h2c or there is no room for
+ * another connection
+ */
+static H2_CONNECTION *get_connection(H2_POOL *pool, const char *ip, int port, 
+        const char *authority) {
+    char origin[URL_MAX + 120];
+    H2_CONNECTION *found = NULL;
+    ULONGLONG now = GetTickCount64();
+    int oldest = -1;
+    
+    snprintf(origin, sizeof(origin), "%s %s:%d", authority, ip, port);
+    EnterCriticalSection(&pool->lock);
+    for (u_int i = 0; i < pool->count; i++) {
+        H2_CONNECTION *connection = pool->connections[i];
+        EnterCriticalSection(&connection->lock);
+        BOOL gone = connection->connecting ? FALSE : 
+                connection->refused ? now - connection->idle_since > H2_REFUSED_MS :
+                connection->draining ? !connection->stream_count :
+                !connection->stream_count && now - connection->idle_since > H2_IDLE_MS;
+        BOOL match = !gone && strcmp(connection->origin, origin) == 0 && 
+                (connection->refused || !connection->draining);
+        LeaveCriticalSection(&connection->lock);
+        if (gone) {
+            drop_connection(pool, i--);
+        } else if (match) {
+            found = connection;
+        }
+    }
+    if (found) {
+        if (found->refused) found = NULL;
+        else InterlockedIncrement(&found->refs);
+        LeaveCriticalSection(&pool->lock);
+        return found;
+    }
+    
+    // make room by closing the connection idle the longest
+    for (u_int i = 0; pool->count == H2_CONNECTIONS_MAX && i < pool->count; i++) {
+        H2_CONNECTION *connection = pool->connections[i];
+        if (!connection->stream_count && !connection->connecting && (oldest < 0 || 
+                connection->idle_since < pool->connections[oldest]->idle_since)) {
+            oldest = i;
+        }
+    }
+    if (oldest >= 0) drop_connection(pool, oldest);
+    if (pool->count == H2_CONNECTIONS_MAX) {
+        // every connection is busy, this request goes over HTTP/1.1
+        LeaveCriticalSection(&pool->lock);
+        return NULL;
+    }
+    found = (H2_CONNECTION*) calloc(1, sizeof(H2_CONNECTION));
+    found->origin = strdup(origin);
+    found->s = INVALID_SOCKET;
+    found->connecting = TRUE;
+    hpack_init(&found->table);
+    found->max_streams = H2_STREAMS_MAX;
+    found->next_id = 1;
+    found->idle_since = now;
+    found->refs = 2; // the pool and the caller
+    InitializeCriticalSection(&found->lock);
+    InitializeConditionVariable(&found->changed);
+    pool->connections[pool->count++] = found;
+    LeaveCriticalSection(&pool->lock);
+    
+    open_connection(pool, found, ip, port);
+    return found;
+}
+
+/*
+ * Appends a request field as a literal the server does not index
+ * Returns FALSE if the block is full
+ */
+static BOOL add_literal(unsigned char *block, u_int *len, u_int index, const char *name, 
+        const char *value, u_int value_len) {
+    u_int written = hpack_literal(block + *len, H2_FRAME_MAX - *len, index, name, value, 
+            value_len);
+    *len += written;
+    return written > 0;
+}
+
+/*
+ * Encodes the request of the template for path on authority
+ * Configured headers are sent with lowercase names, the ones tied to
+ * an HTTP/1.1 connection are left out
+ * Returns the length of the block, 0 if it does not fit in a frame
+ */
+static u_int encode_request(unsigned char *block, REQUEST_TEMPLATE *request, 
+        const char *authority, const char *path) {
+    u_int len = 0;
+    // start is the method and a space, static entries 2, 6 and 4 name the rest
+    BOOL ok = add_literal(block, &len, 2, NULL, request->start, request->start_len - 1) &&
+            add_literal(block, &len, 6, NULL, "http", 4) &&
+            add_literal(block, &len, 4, NULL, path, strlen(path)) &&
+            add_literal(block, &len, 1, NULL, authority, strlen(authority));
+    
+    // rest holds the end of the Host line and "Name: value" lines
+    const char *line = strstr(request->rest, "\r\n");
+    while (ok && line && (line += 2)[0] != '\r' && line[0]) {
+        const char *end = strstr(line, "\r\n"), *colon = strchr(line, ':');
+        char name[256];
+        u_int name_len = colon && colon < end ? colon - line : 0;
+        if (!end) break;
+        if (name_len && name_len < sizeof(name)) {
+            for (u_int i = 0; i < name_len; i++) name[i] = tolower((unsigned char) line[i]);
+            name[name_len] = '\0';
+            const char *value = colon + 1;
+            while (*value == ' ') value++;
+            if (strcmp(name, "connection") && strcmp(name, "keep-alive") && 
+                    strcmp(name, "proxy-connection") && strcmp(name, "transfer-encoding") &&
+                    strcmp(name, "upgrade") && strcmp(name, "host")) {
+                ok = add_literal(block, &len, 0, name, value, end - value);
+            }
+        }
+        line = end;
+    }
+    return ok ? len : 0;
+}
+
+/*
+ * Starts the pool, connections are opened as origins are first asked for
+ */
+H2_POOL *create_h2_pool(SOCKET_TUNING *tuning) {
+    H2_POOL *pool = (H2_POOL*) calloc(1, sizeof(H2_POOL));
+    pool->tuning = tuning;
+    InitializeCriticalSection(&pool->lock);
+    return pool;
+}
+
+/*
+ * Sends a request made from the template as a new stream on the
+ * origin's connection and waits for its reply
+ * authority is the host, with the port unless it is 80
+ * The stream waits for the server's settings, then for a free slot
+ * when its stream limit is reached; a request the server did not
+ * take, on a connection that closed or a refused stream, is sent
+ * once more
+ * Returns H2_DONE with reply->head set, H2_FAILED with reply->reason
+ * set, or H2_UNSUPPORTED if the request should go over HTTP/1.1
+ */
+int h2_request(H2_POOL *pool, const char *ip, int port, const char *authority, 
+        REQUEST_TEMPLATE *request, const char *path, H2_REPLY *reply) {
+    unsigned char block[H2_FRAME_MAX];
+    u_int block_len = encode_request(block, request, authority, path);
+    
+    memset(reply, 0, sizeof(H2_REPLY));
+    if (!block_len) {
+        InterlockedIncrement(&pool->fallbacks);
+        return H2_UNSUPPORTED;
+    }
+    for (int attempt = 0; attempt < 2; attempt++) {
+        H2_CONNECTION *connection = get_connection(pool, ip, port, authority);
+        if (!connection) {
+            InterlockedIncrement(&pool->fallbacks);
+            return H2_UNSUPPORTED;
+        }
+        H2_STREAM stream;
+        memset(&stream, 0, sizeof(H2_STREAM));
+        text_init(&stream.head, 512);
+        
+        EnterCriticalSection(&connection->lock);
+        // streams wait for the server's settings to know its limit
+        while (connection->connecting || (!connection->draining && (!connection->settled ||
+                connection->stream_count >= connection->max_streams))) {
+            SleepConditionVariableCS(&connection->changed, &connection->lock, INFINITE);
+        }
+        if (connection->closed && !connection->reader) {
+            stream.state = H2_FAILED;
+            stream.reason = "Connection error";
+        } else if (connection->draining) {
+            // closed or going away while waiting, try another connection
+            stream.state = connection->refused ? H2_UNSUPPORTED : H2_FAILED;
+            stream.reason = "Connection closed";
+            stream.retry = TRUE;
+        } else {
+            stream.id = connection->next_id;
+            connection->next_id += 2;
+            if (connection->next_id > 0x7fffffff) connection->draining = TRUE;
+            connection->streams[connection->stream_count++] = &stream;
+            QueryPerformanceCounter(&reply->sent);
+            InterlockedIncrement(&pool->streams);
+            // the reader ends every stream, if sending fails it is woken to fail them
+            if (!send_frame(connection, FRAME_HEADERS, FLAG_END_HEADERS | FLAG_END_STREAM, 
+                    stream.id, block, block_len)) {
+                shutdown(connection->s, SD_BOTH);
+            }
+            while (stream.state == H2_OPEN) {
+                SleepConditionVariableCS(&connection->changed, &connection->lock, INFINITE);
+            }
+            for (u_int i = 0; i < connection->stream_count; i++) {
+                if (connection->streams[i] == &stream) {
+                    connection->streams[i] = connection->streams[--connection->stream_count];
+                    break;
+                }
+            }
+            if (!connection->stream_count) connection->idle_since = GetTickCount64();
+            // a slot is free for a request waiting on the limit
+            WakeAllConditionVariable(&connection->changed);
+        }
+        strcpy(reply->client_ip, connection->client_ip);
+        reply->client_port = connection->client_port;
+        if (!connection->closed && !connection->connecting) {
+            read_tcp_stats(connection->s, &reply->tcp);
+        }
+        LeaveCriticalSection(&connection->lock);
+        release_connection(connection);
+        
+        reply->first_byte = stream.first_byte;
+        if (stream.state == H2_DONE) {
+            reply->head = stream.head.data;
+            return H2_DONE;
+        }
+        free(stream.head.data);
+        if (stream.state == H2_UNSUPPORTED) {
+            InterlockedIncrement(&pool->fallbacks);
+            return H2_UNSUPPORTED;
+        }
+        reply->reason = stream.reason;
+        if (!stream.retry) break;
+    }
+    return H2_FAILED;
+}
+
+/*
+ * Closes every connection, waits for the readers and frees the pool
+ */
+void free_h2_pool(H2_POOL *pool) {
+    printf("h2c connections made: %ld, requests sent: %ld, left to HTTP/1.1: %ld\n",
+            pool->opened, pool->streams, pool->fallbacks);
+    EnterCriticalSection(&pool->lock);
+    while (pool->count) {
+        H2_CONNECTION *connection = pool->connections[0];
+        InterlockedIncrement(&connection->refs);
+        drop_connection(pool, 0);
+        if (connection->reader) WaitForSingleObject(connection->reader, INFINITE);
+        release_connection(connection);
+    }
+    LeaveCriticalSection(&pool->lock);
+    DeleteCriticalSection(&pool->lock);
+    free(pool);
+}
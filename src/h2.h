@@ -0,0 +1,133 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   h2.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * HTTP/2 over cleartext TCP with prior knowledge, RFC 9113
+ * Every origin gets one connection carrying the requests of all
+ * workers as concurrent streams, a reader thread per connection
+ * hands each stream its reply as the HTTP/1.1 style head the rest
+ * of the analyser reads
+ * Origins that do not answer in HTTP/2 are remembered and left to
+ * HTTP/1.1
+ * 
+ * Created on October 27, 2026, 11:30 AM
+ */
+
+#ifndef H2_H
+#define H2_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+#include "sockopt.h"
+#include "request.h"
+#include "url.h"
+#include "hpack.h"
+
+#define H2_CONNECTIONS_MAX 64 // origins with a connection open at once
+#define H2_STREAMS_MAX 100 // streams a connection carries at once, fewer if the server says
+#define H2_FRAME_MAX 16384 // largest frame payload, the default we keep
+#define H2_BLOCK_MAX (256 << 10) // largest header block taken
+#define H2_IDLE_MS 15000 // connections without streams for this long are closed
+#define H2_REFUSED_MS 600000 // origins without h2c are left to HTTP/1.1 for this long
+
+// How a stream ended
+enum {
+    H2_OPEN, // still waiting for its reply
+    H2_DONE, // the reply arrived
+    H2_FAILED, // the connection or the stream failed, see reason
+    H2_UNSUPPORTED // the origin does not speak h2c, HTTP/1.1 is up to the caller
+};
+
+// A request on a connection and its reply
+typedef struct {
+    u_int id;
+    int state;
+    TEXT_BUFFER head; // status line and headers of the final reply
+    BOOL final; // the final status arrived, informational ones are dropped
+    BOOL retry; // nothing came back, the request may be sent again
+    const char *reason; // why it failed
+    LARGE_INTEGER first_byte;
+}H2_STREAM;
+
+// Connection to one origin, shared by the workers probing it
+typedef struct {
+    char *origin; // "authority ip:port"
+    SOCKET s;
+    char client_ip[100];
+    int client_port;
+    HPACK_TABLE table; // reader thread only
+    H2_STREAM *streams[H2_STREAMS_MAX]; // open streams
+    u_int stream_count;
+    u_int max_streams; // the server's limit, at most H2_STREAMS_MAX
+    u_int next_id;
+    BOOL connecting; // being opened, requests wait for it
+    BOOL settled; // the server's SETTINGS arrived, it speaks HTTP/2
+    BOOL draining; // takes no new streams, GOAWAY came or ids ran out
+    BOOL closed; // the reader ended, the socket is closed
+    BOOL refused; // closed before any SETTINGS, the origin has no h2c
+    ULONGLONG idle_since; // GetTickCount64() when the last stream ended
+    volatile LONG refs; // the pool, the reader and every request using it
+    HANDLE reader;
+    CRITICAL_SECTION lock; // all of the above but table, and writes to s
+    CONDITION_VARIABLE changed; // a stream ended or the connection did
+}H2_CONNECTION;
+
+// Connections of a run, shared by all workers
+typedef struct {
+    H2_CONNECTION *connections[H2_CONNECTIONS_MAX];
+    u_int count;
+    SOCKET_TUNING *tuning;
+    CRITICAL_SECTION lock;
+    volatile LONG opened; // connections made
+    volatile LONG streams; // requests sent
+    volatile LONG fallbacks; // requests left to HTTP/1.1
+}H2_POOL;
+
+// What h2_request() got back
+typedef struct {
+    char *head; // status line and headers if H2_DONE, to be freed
+    const char *reason; // why it failed if H2_FAILED
+    char client_ip[100];
+    int client_port;
+    LARGE_INTEGER sent; // QueryPerformanceCounter() when the request went out
+    LARGE_INTEGER first_byte; // and when its reply started
+    TCP_STATS tcp; // of the connection when the stream ended
+}H2_REPLY;
+
+H2_POOL *create_h2_pool(SOCKET_TUNING *tuning);
+int h2_request(H2_POOL *pool, const char *ip, int port, const char *authority, 
+        REQUEST_TEMPLATE *request, const char *path, H2_REPLY *reply);
+void free_h2_pool(H2_POOL *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H2_H */
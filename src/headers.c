@@ -0,0 +1,114 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "headers.h"
+
+// Slot of the hash table
+typedef struct {
+    const char *name; // NULL if the slot is empty
+    u_int len;
+    int id;
+}HEADER_SLOT;
+
+/*
+ * Hash of a header name from its length and its first, middle and last
+ * characters, lower cased. The multipliers were searched for so that
+ * every name below lands in its own slot.
+ * Kept as a macro so the table is built by the compiler, a collision
+ * shows up as an overridden initializer warning (-Woverride-init)
+ */
+#define HEADER_HASH(len, first, mid, last) \
+        (((len) + 2 * (first) + 10 * (mid) + (last)) & (HEADER_SLOTS - 1))
+#define HEADER(id, name, first, mid, last) \
+        [HEADER_HASH(sizeof(name) - 1, first, mid, last)] = {name, sizeof(name) - 1, id}
+
+static const HEADER_SLOT header_table[HEADER_SLOTS] = {
+    HEADER(HDR_CODE, "code", 'c', 'd', 'e'),
+    HEADER(HDR_MEANING, "meaning", 'm', 'n', 'g'),
+    HEADER(HDR_DATE, "Date", 'd', 't', 'e'),
+    HEADER(HDR_LOCATION, "Location", 'l', 't', 'n'),
+    HEADER(HDR_LAST_MODIFIED, "Last-Modified", 'l', 'o', 'd'),
+    HEADER(HDR_CONTENT_ENCODING, "Content-Encoding", 'c', 'e', 'g'),
+    HEADER(HDR_CONTENT_TYPE, "Content-Type", 'c', 't', 'e'),
+    HEADER(HDR_CONTENT_LENGTH, "Content-Length", 'c', '-', 'h'),
+    HEADER(HDR_TRANSFER_ENCODING, "Transfer-Encoding", 't', '-', 'g'),
+    HEADER(HDR_CONNECTION, "Connection", 'c', 'c', 'n'),
+    HEADER(HDR_SERVER, "Server", 's', 'v', 'r'),
+    HEADER(HDR_CACHE_CONTROL, "Cache-Control", 'c', 'c', 'l'),
+    HEADER(HDR_EXPIRES, "Expires", 'e', 'i', 's'),
+    HEADER(HDR_ETAG, "ETag", 'e', 'a', 'g'),
+    HEADER(HDR_SET_COOKIE, "Set-Cookie", 's', 'o', 'e'),
+    HEADER(HDR_VARY, "Vary", 'v', 'r', 'y'),
+    HEADER(HDR_AGE, "Age", 'a', 'g', 'e'),
+    HEADER(HDR_ACCEPT_RANGES, "Accept-Ranges", 'a', '-', 's'),
+    HEADER(HDR_CONTENT_LANGUAGE, "Content-Language", 'c', 'l', 'e'),
+    HEADER(HDR_CONTENT_LOCATION, "Content-Location", 'c', 'l', 'n'),
+    HEADER(HDR_CONTENT_RANGE, "Content-Range", 'c', 't', 'e'),
+    HEADER(HDR_CONTENT_DISPOSITION, "Content-Disposition", 'c', 'i', 'n'),
+    HEADER(HDR_KEEP_ALIVE, "Keep-Alive", 'k', 'a', 'e'),
+    HEADER(HDR_PRAGMA, "Pragma", 'p', 'g', 'a'),
+    HEADER(HDR_RETRY_AFTER, "Retry-After", 'r', '-', 'r'),
+    HEADER(HDR_STRICT_TRANSPORT_SECURITY, "Strict-Transport-Security", 's', 'p', 'y'),
+    HEADER(HDR_WWW_AUTHENTICATE, "WWW-Authenticate", 'w', 'e', 'e'),
+    HEADER(HDR_PROXY_AUTHENTICATE, "Proxy-Authenticate", 'p', 'h', 'e'),
+    HEADER(HDR_X_FRAME_OPTIONS, "X-Frame-Options", 'x', '-', 's'),
+    HEADER(HDR_X_CONTENT_TYPE_OPTIONS, "X-Content-Type-Options", 'x', 'y', 's'),
+    HEADER(HDR_X_XSS_PROTECTION, "X-XSS-Protection", 'x', 'o', 'n'),
+    HEADER(HDR_ACCESS_CONTROL_ALLOW_ORIGIN, "Access-Control-Allow-Origin", 'a', 'l', 'n'),
+    HEADER(HDR_LINK, "Link", 'l', 'n', 'k'),
+    HEADER(HDR_VIA, "Via", 'v', 'i', 'a'),
+    HEADER(HDR_ALT_SVC, "Alt-Svc", 'a', '-', 'c'),
+    HEADER(HDR_UPGRADE, "Upgrade", 'u', 'r', 'e'),
+    HEADER(HDR_TRAILER, "Trailer", 't', 'i', 'r'),
+    HEADER(HDR_ALLOW, "Allow", 'a', 'l', 'w'),
+    HEADER(HDR_CONTENT_SECURITY_POLICY, "Content-Security-Policy", 'c', 'u', 'y'),
+    HEADER(HDR_REFRESH, "Refresh", 'r', 'r', 'h'),
+    HEADER(HDR_WARNING, "Warning", 'w', 'n', 'g'),
+    HEADER(HDR_X_POWERED_BY, "X-Powered-By", 'x', 'r', 'y'),
+    HEADER(HDR_REFERRER_POLICY, "Referrer-Policy", 'r', 'r', 'y'),
+    HEADER(HDR_PROXY_CONNECTION, "Proxy-Connection", 'p', 'n', 'n'),
+};
+
+/*
+ * Lower cases an ASCII letter
+ */
+static int lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + 'a' - 'A' : c;
+}
+
+/*
+ * Returns the id of the header name, compared without case
+ * Returns HDR_UNKNOWN if it is not a well known header
+ */
+int header_id(const char *name, u_int len) {
+    if (!len) return HDR_UNKNOWN;
+    const HEADER_SLOT *slot = &header_table[HEADER_HASH(len, lower(name[0]), 
+            lower(name[len / 2]), lower(name[len - 1]))];
+    if (!slot->name || slot->len != len) return HDR_UNKNOWN;
+    for (u_int i = 0; i < len; i++) {
+        if (lower(name[i]) != lower(slot->name[i])) return HDR_UNKNOWN;
+    }
+    return slot->id;
+}
@@ -0,0 +1,102 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   headers.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Well known header names mapped to small ids with a perfect hash
+ * The hash table is filled in at compile time, see headers.c
+ * 
+ * Created on October 21, 2026, 4:50 PM
+ */
+
+#ifndef HEADERS_H
+#define HEADERS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+
+#define HEADER_SLOTS 128 // size of the hash table, power of 2
+
+// Well known header ids, code and meaning hold the status line
+enum {
+    HDR_UNKNOWN = -1,
+    HDR_CODE,
+    HDR_MEANING,
+    HDR_DATE,
+    HDR_LOCATION,
+    HDR_LAST_MODIFIED,
+    HDR_CONTENT_ENCODING,
+    HDR_CONTENT_TYPE,
+    HDR_CONTENT_LENGTH,
+    HDR_TRANSFER_ENCODING,
+    HDR_CONNECTION,
+    HDR_SERVER,
+    HDR_CACHE_CONTROL,
+    HDR_EXPIRES,
+    HDR_ETAG,
+    HDR_SET_COOKIE,
+    HDR_VARY,
+    HDR_AGE,
+    HDR_ACCEPT_RANGES,
+    HDR_CONTENT_LANGUAGE,
+    HDR_CONTENT_LOCATION,
+    HDR_CONTENT_RANGE,
+    HDR_CONTENT_DISPOSITION,
+    HDR_KEEP_ALIVE,
+    HDR_PRAGMA,
+    HDR_RETRY_AFTER,
+    HDR_STRICT_TRANSPORT_SECURITY,
+    HDR_WWW_AUTHENTICATE,
+    HDR_PROXY_AUTHENTICATE,
+    HDR_X_FRAME_OPTIONS,
+    HDR_X_CONTENT_TYPE_OPTIONS,
+    HDR_X_XSS_PROTECTION,
+    HDR_ACCESS_CONTROL_ALLOW_ORIGIN,
+    HDR_LINK,
+    HDR_VIA,
+    HDR_ALT_SVC,
+    HDR_UPGRADE,
+    HDR_TRAILER,
+    HDR_ALLOW,
+    HDR_CONTENT_SECURITY_POLICY,
+    HDR_REFRESH,
+    HDR_WARNING,
+    HDR_X_POWERED_BY,
+    HDR_REFERRER_POLICY,
+    HDR_PROXY_CONNECTION,
+    HEADER_COUNT
+};
+
+int header_id(const char *name, u_int len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HEADERS_H */
@@ -0,0 +1,336 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "hpack.h"
+
+// Static table of RFC 7541 appendix A, index 1 first
+static const char *static_table[HPACK_STATIC_COUNT][2] = {
+    {":authority", ""}, {":method", "GET"}, {":method", "POST"}, {":path", "/"},
+    {":path", "/index.html"}, {":scheme", "http"}, {":scheme", "https"}, 
+    {":status", "200"}, {":status", "204"}, {":status", "206"}, {":status", "304"}, 
+    {":status", "400"}, {":status", "404"}, {":status", "500"}, {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"}, {"accept-language", ""}, {"accept-ranges", ""},
+    {"accept", ""}, {"access-control-allow-origin", ""}, {"age", ""}, {"allow", ""},
+    {"authorization", ""}, {"cache-control", ""}, {"content-disposition", ""},
+    {"content-encoding", ""}, {"content-language", ""}, {"content-length", ""},
+    {"content-location", ""}, {"content-range", ""}, {"content-type", ""}, {"cookie", ""},
+    {"date", ""}, {"etag", ""}, {"expect", ""}, {"expires", ""}, {"from", ""}, {"host", ""},
+    {"if-match", ""}, {"if-modified-since", ""}, {"if-none-match", ""}, {"if-range", ""},
+    {"if-unmodified-since", ""}, {"last-modified", ""}, {"link", ""}, {"location", ""},
+    {"max-forwards", ""}, {"proxy-authenticate", ""}, {"proxy-authorization", ""},
+    {"range", ""}, {"referer", ""}, {"refresh", ""}, {"retry-after", ""}, {"server", ""},
+    {"set-cookie", ""}, {"strict-transport-security", ""}, {"transfer-encoding", ""},
+    {"user-agent", ""}, {"vary", ""}, {"via", ""}, {"www-authenticate", ""}
+};
+
+// The Huffman code is canonical, codes of each length and the symbols
+// in code order are all it takes to decode it
+static const unsigned char huffman_counts[HUFFMAN_BITS_MAX + 1] = {
+    0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+    0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4
+};
+static const unsigned short huffman_symbols[257] = {
+    48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37, 45, 46,
+    47, 51, 52, 53, 54, 55, 56, 57, 61, 65, 95, 98, 100, 102,
+    103, 104, 108, 109, 110, 112, 114, 117, 58, 66, 67, 68, 69, 70,
+    71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83, 84,
+    85, 86, 87, 89, 106, 107, 113, 118, 119, 120, 121, 122, 38, 42,
+    44, 59, 88, 90, 33, 34, 40, 41, 63, 39, 43, 124, 35, 62,
+    0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92, 195, 208,
+    128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+    179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154,
+    156, 160, 163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190,
+    196, 198, 228, 232, 233, 1, 135, 137, 138, 139, 140, 141, 143, 147,
+    149, 150, 151, 152, 155, 157, 158, 165, 166, 168, 174, 175, 180, 182,
+    183, 188, 191, 197, 231, 239, 9, 142, 144, 145, 148, 159, 171, 206,
+    215, 225, 236, 237, 199, 207, 234, 235, 192, 193, 200, 201, 202, 205,
+    210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211, 212, 214,
+    221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+    2, 3, 4, 5, 6, 7, 8, 11, 12, 14, 15, 16, 17, 18,
+    19, 20, 21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220,
+    249, 10, 13, 22, 256
+};
+
+/*
+ * Reads an integer with an n bit prefix at *pos
+ * Returns FALSE if the block ends first or the value does not fit
+ */
+static BOOL read_integer(const unsigned char *block, u_int len, u_int *pos, u_int n, 
+        u_int *value) {
+    u_int limit = (1u << n) - 1, shift = 0;
+    if (*pos >= len) return FALSE;
+    *value = block[(*pos)++] & limit;
+    if (*value < limit) return TRUE;
+    while (*pos < len && shift <= 21) {
+        unsigned char byte = block[(*pos)++];
+        *value += (u_int) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return TRUE;
+        shift += 7;
+    }
+    return FALSE;
+}
+
+/*
+ * Decodes len bytes of Huffman code into out, which takes len * 8 / 5
+ * bytes at most
+ * The code ends in fewer than 8 bits of padding that are all ones
+ * Returns the decoded length, -1 if the code is invalid
+ */
+static int huffman_decode(const unsigned char *in, u_int len, char *out) {
+    int code = 0, first = 0, index = 0, bits = 0, ones = TRUE, written = 0;
+    
+    for (u_int i = 0; i < len; i++) {
+        for (int b = 7; b >= 0; b--) {
+            int bit = (in[i] >> b) & 1;
+            code |= bit;
+            ones &= bit;
+            bits++;
+            int count = huffman_counts[bits];
+            if (code - count < first) {
+                int symbol = huffman_symbols[index + code - first];
+                if (symbol == 256) return -1;
+                out[written++] = (char) symbol;
+                code = first = index = bits = 0;
+                ones = TRUE;
+                continue;
+            }
+            if (bits == HUFFMAN_BITS_MAX) return -1;
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+    }
+    return bits < 8 && ones ? written : -1;
+}
+
+/*
+ * Reads a string literal at *pos into scratch, decoding it if it is
+ * Huffman coded, and points text at it
+ * scratch must take 8 / 5 of the rest of the block
+ * Returns FALSE if the literal is invalid
+ */
+static BOOL read_string(const unsigned char *block, u_int len, u_int *pos, char *scratch, 
+        const char **text, u_int *text_len) {
+    if (*pos >= len) return FALSE;
+    BOOL huffman = (block[*pos] & 0x80) != 0;
+    u_int size;
+    if (!read_integer(block, len, pos, 7, &size) || size > len - *pos) return FALSE;
+    if (huffman) {
+        int decoded = huffman_decode(block + *pos, size, scratch);
+        if (decoded < 0) return FALSE;
+        *text = scratch;
+        *text_len = decoded;
+    } else {
+        *text = (const char*) block + *pos;
+        *text_len = size;
+    }
+    *pos += size;
+    return TRUE;
+}
+
+/*
+ * Drops the oldest entries until the table fits in size bytes
+ */
+static void evict(HPACK_TABLE *table, u_int size) {
+    while (table->count && table->size > size) {
+        HPACK_ENTRY *oldest = &table->entries[(table->first + table->count - 1) % 
+                HPACK_ENTRIES_MAX];
+        table->size -= oldest->name_len + oldest->value_len + 32;
+        free(oldest->name);
+        table->count--;
+    }
+}
+
+/*
+ * Adds a field as the newest entry, evicting what no longer fits
+ * A field larger than the whole table leaves it empty
+ * The field is copied first, its name may be an entry being evicted
+ */
+static void add_entry(HPACK_TABLE *table, const char *name, u_int name_len, 
+        const char *value, u_int value_len) {
+    u_int size = name_len + value_len + 32;
+    if (size > table->max_size) {
+        evict(table, 0);
+        return;
+    }
+    char *copy = (char*) malloc(name_len + value_len + 1);
+    memcpy(copy, name, name_len);
+    memcpy(copy + name_len, value, value_len);
+    copy[name_len + value_len] = '\0';
+    
+    evict(table, table->max_size - size);
+    table->first = (table->first + HPACK_ENTRIES_MAX - 1) % HPACK_ENTRIES_MAX;
+    HPACK_ENTRY *entry = &table->entries[table->first];
+    entry->name = copy;
+    entry->value = copy + name_len;
+    entry->name_len = name_len;
+    entry->value_len = value_len;
+    table->size += size;
+    table->count++;
+}
+
+/*
+ * Finds the field at index, static entries first, then the dynamic
+ * table newest first
+ * Returns FALSE if there is no such entry
+ */
+static BOOL lookup(HPACK_TABLE *table, u_int index, const char **name, u_int *name_len, 
+        const char **value, u_int *value_len) {
+    if (!index) return FALSE;
+    if (index <= HPACK_STATIC_COUNT) {
+        *name = static_table[index - 1][0];
+        *value = static_table[index - 1][1];
+        *name_len = strlen(*name);
+        *value_len = strlen(*value);
+        return TRUE;
+    }
+    index -= HPACK_STATIC_COUNT + 1;
+    if (index >= table->count) return FALSE;
+    HPACK_ENTRY *entry = &table->entries[(table->first + index) % HPACK_ENTRIES_MAX];
+    *name = entry->name;
+    *value = entry->value;
+    *name_len = entry->name_len;
+    *value_len = entry->value_len;
+    return TRUE;
+}
+
+/*
+ * Prepares an empty dynamic table
+ */
+void hpack_init(HPACK_TABLE *table) {
+    memset(table, 0, sizeof(HPACK_TABLE));
+    table->max_size = HPACK_TABLE_SIZE;
+}
+
+/*
+ * Decodes a complete header block, handing every field to field in
+ * order, and updates the dynamic table as the block says
+ * Returns FALSE if the block is invalid, the connection can not go
+ * on then as its table is out of step with the server's
+ */
+BOOL hpack_decode(HPACK_TABLE *table, const unsigned char *block, u_int len, 
+        HPACK_FIELD field, void *context) {
+    // literals expand by 8 / 5 at most when Huffman coded
+    char *scratch = (char*) malloc(len * 4 + 16);
+    char *name_scratch = scratch, *value_scratch = scratch + len * 2 + 8;
+    u_int pos = 0;
+    BOOL ok = TRUE;
+    
+    while (ok && pos < len) {
+        unsigned char byte = block[pos];
+        const char *name, *value;
+        u_int name_len, value_len, index;
+        
+        if (byte & 0x80) {
+            // indexed field
+            ok = read_integer(block, len, &pos, 7, &index) && 
+                    lookup(table, index, &name, &name_len, &value, &value_len) &&
+                    field(context, name, name_len, value, value_len);
+            continue;
+        }
+        if ((byte & 0xe0) == 0x20) {
+            // dynamic table size update
+            ok = read_integer(block, len, &pos, 5, &index) && index <= HPACK_TABLE_SIZE;
+            if (ok) {
+                table->max_size = index;
+                evict(table, index);
+            }
+            continue;
+        }
+        // literal, with incremental indexing or without, or never indexed
+        BOOL indexing = (byte & 0xc0) == 0x40;
+        ok = read_integer(block, len, &pos, indexing ? 6 : 4, &index);
+        if (ok && index) {
+            ok = lookup(table, index, &name, &name_len, &value, &value_len);
+        } else if (ok) {
+            ok = read_string(block, len, &pos, name_scratch, &name, &name_len);
+        }
+        ok = ok && read_string(block, len, &pos, value_scratch, &value, &value_len) &&
+                field(context, name, name_len, value, value_len);
+        if (ok && indexing) add_entry(table, name, name_len, value, value_len);
+    }
+    free(scratch);
+    return ok;
+}
+
+/*
+ * Writes an integer with an n bit prefix, flags go in the bits above
+ * Returns the bytes written, 0 if out has no room
+ */
+static u_int write_integer(unsigned char *out, u_int size, u_int n, unsigned char flags, 
+        u_int value) {
+    u_int limit = (1u << n) - 1, len = 0;
+    if (!size) return 0;
+    if (value < limit) {
+        out[0] = flags | (unsigned char) value;
+        return 1;
+    }
+    out[len++] = flags | (unsigned char) limit;
+    value -= limit;
+    while (len < size) {
+        if (value < 0x80) {
+            out[len++] = (unsigned char) value;
+            return len;
+        }
+        out[len++] = (unsigned char) (0x80 | (value & 0x7f));
+        value >>= 7;
+    }
+    return 0;
+}
+
+/*
+ * Writes a plain string literal
+ * Returns the bytes written, 0 if out has no room
+ */
+static u_int write_string(unsigned char *out, u_int size, const char *text, u_int len) {
+    u_int head = write_integer(out, size, 7, 0, len);
+    if (!head || size - head < len) return 0;
+    memcpy(out + head, text, len);
+    return head + len;
+}
+
+/*
+ * Encodes a field as a literal without indexing, its name taken from
+ * the static table at index, or given as name when index is 0
+ * Returns the bytes written, 0 if out has no room
+ */
+u_int hpack_literal(unsigned char *out, u_int size, u_int index, const char *name, 
+        const char *value, u_int value_len) {
+    u_int len = write_integer(out, size, 4, 0, index), part;
+    if (!len) return 0;
+    if (!index) {
+        if (!(part = write_string(out + len, size - len, name, strlen(name)))) return 0;
+        len += part;
+    }
+    if (!(part = write_string(out + len, size - len, value, value_len))) return 0;
+    return len + part;
+}
+
+/*
+ * Frees the entries of the dynamic table
+ */
+void hpack_free(HPACK_TABLE *table) {
+    evict(table, 0);
+}
@@ -0,0 +1,83 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   hpack.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * HPACK header compression of HTTP/2, RFC 7541
+ * Header blocks of a connection are decoded in the order they arrive
+ * against its dynamic table, requests are encoded as literals that
+ * never touch the server's table
+ * 
+ * Created on October 27, 2026, 10:05 AM
+ */
+
+#ifndef HPACK_H
+#define HPACK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+
+#define HPACK_TABLE_SIZE 4096 // dynamic table bytes, the HTTP/2 default we keep
+#define HPACK_ENTRIES_MAX (HPACK_TABLE_SIZE / 32) // every entry counts 32 bytes extra
+#define HPACK_STATIC_COUNT 61 // entries of the static table
+#define HUFFMAN_BITS_MAX 30 // longest Huffman code
+
+// Header field held by the dynamic table, value follows name in one block
+typedef struct {
+    char *name;
+    char *value;
+    u_int name_len;
+    u_int value_len;
+}HPACK_ENTRY;
+
+// Dynamic table of a decoder, a ring with the newest entry at first
+typedef struct {
+    HPACK_ENTRY entries[HPACK_ENTRIES_MAX];
+    u_int first;
+    u_int count;
+    u_int size; // bytes as RFC 7541 counts them
+    u_int max_size; // chosen by the encoder, at most HPACK_TABLE_SIZE
+}HPACK_TABLE;
+
+// Receives a decoded field, returns FALSE to stop decoding
+typedef BOOL (*HPACK_FIELD)(void *context, const char *name, u_int name_len, 
+        const char *value, u_int value_len);
+
+void hpack_init(HPACK_TABLE *table);
+BOOL hpack_decode(HPACK_TABLE *table, const unsigned char *block, u_int len, 
+        HPACK_FIELD field, void *context);
+u_int hpack_literal(unsigned char *out, u_int size, u_int index, const char *name, 
+        const char *value, u_int value_len);
+void hpack_free(HPACK_TABLE *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HPACK_H */
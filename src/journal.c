@@ -0,0 +1,164 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "journal.h"
+
+/*
+ * Counts the set bits of a byte
+ */
+static u_int bits_set(unsigned char byte) {
+    u_int count = 0;
+    for (; byte; byte &= byte - 1) count++;
+    return count;
+}
+
+/*
+ * Makes room in the bitmap for the given line
+ */
+static void journal_grow(JOURNAL *journal, u_int line) {
+    u_int need = line / 8 + 1;
+    if (need <= journal->size) return;
+    u_int size = journal->size ? journal->size : 4096;
+    while (size < need) size *= 2;
+    journal->bits = (unsigned char*) realloc(journal->bits, size);
+    memset(journal->bits + journal->size, 0, size - journal->size);
+    journal->size = size;
+}
+
+/*
+ * Opens the journal of a run over a list of the given size, creating it
+ * if needed, results is the writer of the run's output
+ * A journal written for a list of another size is started over
+ * Returns NULL if the file can not be opened
+ */
+JOURNAL *open_journal(const char *name, ULONGLONG list_size, RESULT_WRITER *results) {
+    JOURNAL *journal = (JOURNAL*) calloc(1, sizeof(JOURNAL));
+    JOURNAL_HEADER header;
+    MAPPED_FILE map;
+    
+    journal->results = results;
+    journal->flushed_at = GetTickCount();
+    journal->dirty_low = (u_int) -1;
+    if (map_file(name, &map)) {
+        const JOURNAL_HEADER *old = (const JOURNAL_HEADER*) map.data;
+        if (map.size >= sizeof(JOURNAL_HEADER) && memcmp(old->magic, JOURNAL_MAGIC, 8) == 0 &&
+                old->list_size == list_size) {
+            u_int size = (u_int) (map.size - sizeof(JOURNAL_HEADER));
+            journal_grow(journal, size * 8);
+            memcpy(journal->bits, map.data + sizeof(JOURNAL_HEADER), size);
+            for (u_int i = 0; i < size; i++) journal->resumed += bits_set(journal->bits[i]);
+        } else if (map.size) {
+            printf("Journal %s is for another list, starting over\n", name);
+        }
+        unmap_file(&map);
+    }
+    
+    journal->file = CreateFileA(name, GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, 
+            FILE_ATTRIBUTE_NORMAL, NULL);
+    if (journal->file == INVALID_HANDLE_VALUE) {
+        printf("unable to open journal file: %s\n", name);
+        free(journal->bits);
+        free(journal);
+        return NULL;
+    }
+    if (!journal->resumed) {
+        DWORD written;
+        memset(&header, 0, sizeof(JOURNAL_HEADER));
+        memcpy(header.magic, JOURNAL_MAGIC, 8);
+        header.list_size = list_size;
+        if (!WriteFile(journal->file, &header, sizeof(JOURNAL_HEADER), &written, NULL) ||
+                !SetEndOfFile(journal->file)) {
+            printf("unable to write journal file: %s\n", name);
+        }
+    }
+    return journal;
+}
+
+/*
+ * Checks whether the line was finished by this or an earlier run
+ */
+BOOL journal_done(JOURNAL *journal, u_int line) {
+    return line / 8 < journal->size && (journal->bits[line / 8] >> (line % 8)) & 1;
+}
+
+/*
+ * Records the line as finished
+ * Writes the journal out once a batch of lines is finished
+ * or the last write is old enough
+ */
+void journal_mark(JOURNAL *journal, u_int line) {
+    journal_grow(journal, line);
+    journal->bits[line / 8] |= (unsigned char) (1 << (line % 8));
+    if (line / 8 < journal->dirty_low) journal->dirty_low = line / 8;
+    if (line / 8 >= journal->dirty_high) journal->dirty_high = line / 8 + 1;
+    journal->pending++;
+    if (journal->pending >= JOURNAL_BATCH) journal_flush(journal);
+    else journal_tick(journal);
+}
+
+/*
+ * Writes the journal out if finished lines have waited long enough
+ */
+void journal_tick(JOURNAL *journal) {
+    if (journal->pending && GetTickCount() - journal->flushed_at >= JOURNAL_FLUSH_MS) {
+        journal_flush(journal);
+    }
+}
+
+/*
+ * Writes the changed part of the bitmap and forces it to disk
+ * The results are forced to disk first, so a line is never
+ * recorded as finished before its results are safe
+ * Returns FALSE if the write fails
+ */
+BOOL journal_flush(JOURNAL *journal) {
+    LARGE_INTEGER offset;
+    DWORD written;
+    BOOL ok = TRUE;
+    
+    journal->flushed_at = GetTickCount();
+    if (!journal->pending) return TRUE;
+    if (journal->results) writer_sync(journal->results);
+    offset.QuadPart = sizeof(JOURNAL_HEADER) + journal->dirty_low;
+    ok = SetFilePointerEx(journal->file, offset, NULL, FILE_BEGIN) &&
+            WriteFile(journal->file, journal->bits + journal->dirty_low, 
+            journal->dirty_high - journal->dirty_low, &written, NULL) &&
+            FlushFileBuffers(journal->file);
+    if (!ok) printf("unable to write journal: %d\n", (int) GetLastError());
+    journal->pending = 0;
+    journal->dirty_low = (u_int) -1;
+    journal->dirty_high = 0;
+    return ok;
+}
+
+/*
+ * Writes out what is left and closes the journal
+ */
+void close_journal(JOURNAL *journal) {
+    journal_flush(journal);
+    CloseHandle(journal->file);
+    free(journal->bits);
+    free(journal);
+}
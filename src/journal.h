@@ -0,0 +1,82 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   journal.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Progress journal of a batch run
+ * One bit per line of the url list, set once the line is probed,
+ * so a run that was stopped can carry on where it left off
+ * Bits only ever go from 0 to 1, so a write cut short by a crash
+ * leaves every byte either old or new and the journal still valid
+ * 
+ * Created on October 24, 2026, 11:00 AM
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+#include "resultq.h"
+
+#define JOURNAL_MAGIC "ARCJRN1"
+#define JOURNAL_BATCH 256 // finished lines written out together
+#define JOURNAL_FLUSH_MS 2000 // longest time a finished line stays unwritten
+
+// Start of the journal file, the bitmap follows
+typedef struct {
+    char magic[8];
+    ULONGLONG list_size; // size of the url list the journal belongs to
+}JOURNAL_HEADER;
+
+// Journal opened by a batch run
+typedef struct {
+    HANDLE file;
+    unsigned char *bits;
+    u_int size; // bytes of bits
+    u_int dirty_low; // byte range changed since the last flush
+    u_int dirty_high;
+    u_int pending; // lines finished since the last flush
+    DWORD flushed_at; // GetTickCount() of the last flush
+    RESULT_WRITER *results; // written and forced to disk before the journal
+    u_int resumed; // lines already done when the journal was opened
+}JOURNAL;
+
+JOURNAL *open_journal(const char *name, ULONGLONG list_size, RESULT_WRITER *results);
+BOOL journal_done(JOURNAL *journal, u_int line);
+void journal_mark(JOURNAL *journal, u_int line);
+void journal_tick(JOURNAL *journal);
+BOOL journal_flush(JOURNAL *journal);
+void close_journal(JOURNAL *journal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JOURNAL_H */
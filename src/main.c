@@ -1,757 +1,2701 @@
-/*
- * The MIT License
- *
- * Copyright 2018 Arda 'Arc' Akgur.
- *
- * Permission is hereby granted, free of charge, to any person obtaining a copy
- * of this software and associated documentation files (the "Software"), to deal
- * in the Software without restriction, including without limitation the rights
- * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
- * copies of the Software, and to permit persons to whom the Software is
- * furnished to do so, subject to the following conditions:
- *
- * The above copyright notice and this permission notice shall be included in
- * all copies or substantial portions of the Software.
- *
- * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
- * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
- * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
- * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
- * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
- * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
- * THE SOFTWARE.
- */
-
-/* 
- * File:   main.c
- * Author: Arda 'Arc' Akgur
- * 
- * Program meant to compile on x64 based windows systems
- * 
- * Known issues:
- *      * There is a slight bug that crashes to program if requested https
- *          and then if user re-runs the program without exiting
- *      * Running program more than several times without exiting could cause
- *          memory issues that result program to crash unexpectedly
- * 
- * How to compile and run:
- *      * Program can compile with either MinGW or CyWin basic Gcc
- *      * Link ws2_32.a library when compiling
- * 
- * Created on March 12, 2018, 3:02 PM AST
- */
-
-
-#include "utilities.h" // utilities for this program
-#include "datetime.h" // time convert
-
-// use Winsocket library
-#pragma comment(lib,"ws2_32.lib")
-
-
-// pointer to hostent struct in Winsock dll
-struct hostent *he; 
-
-char *missing; // reference if new location missing url
-
-// Struct that holds address data
-typedef struct {
-    char *hostname;
-    char *file;
-    BOOL protocol;
-    char ip[100];
-    int port;
-}ADDRESS;
-
-// Map for storing HTTP response package data
-typedef struct {
-    char **key;
-    char **value;
-    u_int len;
-    u_int max_size;
-}ARCMAP;
-
-// Struct that holds pointer to address and response map
-typedef struct {
-    ADDRESS *server;
-    ADDRESS *client;
-    ARCMAP *arcmap;
-    int code;
-    char *code_meaning;
-}ANALYSER;
-
-
-/*
- * Creates and returns pointer to a ARCMAP
- * map size given as param
- */
-ARCMAP *get_blank_map(u_int size) {
-    if (!size) return NULL;
-    
-    ARCMAP *res = (ARCMAP*) malloc(sizeof(ARCMAP));
-    res->key = (char**) malloc(sizeof(char*) * size);
-    res->value = (char**) malloc(sizeof(char*) * size);
-    res->len = 0;
-    for (int i = 0; i < size; i++) {
-        res->key[i] = (char*) malloc(sizeof(char) * 1024);
-        res->value[i] = (char*) malloc(sizeof(char) * 1024);
-    }
-    res->max_size = size;
-    return res;
-}
-
-/*
- * Attempts to free the memory usage of
- * given ARCMAP
- */
-void free_map(ARCMAP *map) {
-    for (u_int i = 0; i < map->max_size; i++) {
-        free(map->key[i]);
-        free(map->value[i]);
-    }
-    free(map->key);
-    free(map->value);
-    free(map);
-}
-
-/*
- * Return corresponding value from the map
- * depending on the given key
- * returns NULL if map is NULL
- * returns NULL if key is not in map
- * returns corresponding value if successful
- */
-char *get_from_map(ARCMAP *map, char *key) {
-    if (map == NULL) return NULL;
-    
-    for (int i = 0; i < map->len; i++) {
-        if (strcmp(key, map->key[i]) == 0) {
-            return map->value[i];
-        }
-    }
-    return NULL;
-}
-
-/*
- * Attempts to put given key-value
- * pairing into the given map
- * on success returns True
- * returns False if map is NULL
- * returns False if map is full
- */
-BOOL put_to_map(ARCMAP *map, char *key, char*value) {
-    if (map == NULL) return FALSE;
-    if (map->len == map->max_size) return FALSE;
-    int i;
-    for (i = 0; i < strlen(key); i++) {
-        map->key[map->len][i] = key[i];
-    }
-    map->key[map->len][i] = '\0';
-    
-    for (i = 0; i < strlen(value); i++) {
-        map->value[map->len][i] = value[i];
-    }
-    map->value[map->len][i] = '\0';
-    
-    
-    map->len++;
-    return TRUE;
-}
-
-/*
- * Initializes windows socket library
- * Exits program if fails
- */
-void initialise_winsock(WSADATA *wsa) {
-    printf("Attempting to initialize Winsock...");
-    if (WSAStartup(MAKEWORD(2,2), wsa) != 0) {
-        printf("Failed. Error Code : %d",WSAGetLastError());
-        exit(1);
-    }
-    printf("Successfully initialized\n");
-}
-
-/*
- * Creates Socket and returns it
- * Exits program if fails to create socket
- */
-SOCKET create_sock(void) {
-    SOCKET s;
-    printf("Creating Socket...");
-    if ((s = socket(AF_INET , SOCK_STREAM , 0 )) == INVALID_SOCKET) {
-        printf("Could not create socket : %d" , WSAGetLastError());
-        exit(2);
-    }
-    printf("Successfully created\n");
-    return s;
-}
-
-/*
- * Prompts user for hostname and returns as string pointer
- * Exits program if end of input from user
- */
-char *get_hostname(void) {
-    char *hostname = (char*) malloc(sizeof(char) * 1024);
-    
-    while (TRUE) {
-        printf("Please Enter website address: ");
-        if (!fgets(hostname, 1024, stdin)) {
-            printf("End of input from user\n");
-            exit(3);
-        }
-        if (hostname[0] != '\n') break;
-    }
-    
-    hostname[strlen(hostname) - 1] = '\0';
-    return hostname;
-}
-
-/*
- * Populates server struct with given ip address
- * param server - OUT - pointer to sockaddr_in
- * param ip - IN - String representation of IP to store
- * param port - IN - Port to use for connection
- */
-void populate_server_info(struct sockaddr_in *server, char *ip, int port) {
-    server->sin_addr.s_addr = inet_addr(ip);
-    server->sin_family = AF_INET;
-    server->sin_port = htons(port);
-}
-
-/*
- * Analyzes hostname
- * checks protocol
- * splits hostname from path
- * Param IN/OUT address that holds web address
- */
-void analyze_hostname_input(ADDRESS *address) {
-    printf("Analyzing: %s\n", address->hostname);
-    char *temp = address->hostname;
-    
-    if (strncmp(address->hostname, "https://", 8) == 0) address->protocol = TRUE;
-    else address->protocol = FALSE;
-        
-    
-    char *protocol;
-    int size;
-    
-    if (address->protocol) {
-        protocol = strdup(HTTPS);
-        size = 8;
-    } else {
-        protocol = strdup(HTTP);
-        size = 7;
-    }
-    
-    //printf("%s %d\n", protocol, size);
-    // double check free call of this function, there might be memory leak
-    if (strncmp(address->hostname, protocol, size) == 0) {
-        // http://www.example.com/about
-        // 01234567
-        address->hostname = (char*)&address->hostname[size];
-    }
-    //puts(address->hostname);
-    BOOL yes = FALSE;
-    int i;
-    char host[((int)strlen(address->hostname)) + 1];
-    for (i = 0; i < strlen(address->hostname); i++) {
-        if (address->hostname[i] == '/') {
-            yes = TRUE;
-            break;
-        }
-        host[i] = address->hostname[i];
-    }
-    host[i] = '\0';
-    if (yes) address->file = strdup((char*)&address->hostname[i]);
-    else address->file = strdup("/");
-    
-    free(temp);
-    address->hostname = strdup((char*) &host[0]);
-    
-    free(protocol);
-    
-}
-
-/*
- * Prompt user for hostname via get_hostname()
- * Populates pointer to a ADDRESS struct
- * with hostname and ip address
- * Exits program if user inputs 5 invalid hostname
- * Returns ADDRESS struct if successful
- */
-ADDRESS *get_host_ip(void) {
-    ADDRESS *res = (ADDRESS*) malloc(sizeof(ADDRESS));
-    res->hostname = get_hostname();
-    puts(res->hostname);
-    analyze_hostname_input(res);
-    
-    printf("User Input: %s%s\n", res->hostname, res->file);
-    int tries = 0;
-    
-    while ((he = gethostbyname(res->hostname)) == NULL) {
-        printf("gethostbyname() failed : %d\n" , WSAGetLastError());
-        free(res->hostname);
-        res->hostname = get_hostname();
-        analyze_hostname_input(res);
-        printf("User Input: %s%s\n", res->hostname, res->file);
-        tries++;
-        if (tries == 5) {
-            printf("Too many invalid hostname tries.. Exiting.\n");
-            exit(5);
-        }
-    }
-    return res;
-}
-
-/*
- * Attempts to get the host and ip of next address Location
- * This function should run if the initial website request 
- * moved to a different location with code 301 or similar
- * Returns the new pointer to a Address struct if successful
- * Returns NULL on fail
- */
-ADDRESS *get_ip_from_prev(ANALYSER *prev) {
-    ADDRESS *res = (ADDRESS*) malloc(sizeof(ADDRESS));
-    char *host = get_from_map(prev->arcmap, "Location");
-    char **splitted = split_url(host);
-    
-    if (strlen(splitted[0]) == 0 || strlen(splitted[0]) == 1) {
-        char temp[200];
-        strcpy(temp, missing);
-        strcat(temp, "/");
-        strcat(temp, splitted[1]);
-        host = strdup((char*)&temp[0]);
-    }
-    for (int i = 0; i < 2; i++) {
-        free(splitted[i]);
-    }
-    free(splitted);
-    if (host) {
-        res->hostname = strdup(host);
-    } else {
-        puts("Can not locate new Location");
-        return NULL;
-    }
-    analyze_hostname_input(res);
-    printf("New Host: %s # New Path: %s\n", res->hostname, res->file);
-    if ((he = gethostbyname(res->hostname)) == NULL) {
-        printf("gethostbyname() failed : %d\n" , WSAGetLastError());
-        return NULL;
-    }
-    return res;
-}
-
-/*
- * Resolves hostname into IP address
- * param address - IN/OUT 
- * param addr_list - IN/OUT
- */
-void resolve_ip(ADDRESS *address) {
-    //Cast the h_addr_list to in_addr , since h_addr_list also has the ip address in long format only
-    struct in_addr **addr_list = (struct in_addr **) he->h_addr_list;
-
-    for(int i = 0; addr_list[i] != NULL; i++) {
-        //Return the first one;
-        strcpy(address->ip, inet_ntoa(*addr_list[i]));
-        //address->ip = strdup(inet_ntoa(*addr_list[i]));
-    }
-     
-    printf("%s resolved to : %s\n" , address->hostname , address->ip);
-}
-
-/*
- * Sends HTTP HEAD request to given SOCKET
- * param s - SOCKET to send request to
- * param file - Requested file default '/'
- * param hostname - website hostname
- */
-void send_HTTP_request(SOCKET s, char *file, char *hostname) {
-    char *request = (char*) malloc(strlen(file) + strlen(hostname) + 26);
-    int done = sprintf(request, "HEAD %s HTTP/1.1\r\nHost: %s\r\n\r\n", 
-            file, hostname);
-    if (!done) {
-        printf("Error writing to request string\n");
-        exit(8);
-    }
-    printf("Sending: %s", request);
-    if (send(s, request, strlen(request), 0) < 0) {
-        printf("Send() failed\n");
-        exit(6);
-    }
-    printf("HTTP Request Send to server\n");
-}
-
-/*
- * Attempts to get this client's ip and port
- * stores and returns in ADDRESS struct if successful
- * if fails returns NULL
- */
-ADDRESS *get_client_info(SOCKET s) {
-    struct sockaddr_in client;
-    ADDRESS *ret = (ADDRESS*) malloc(sizeof(ADDRESS));
-    int client_len = (int) sizeof(client);
-    if (getsockname(s, (struct sockaddr*)&client, &client_len) == SOCKET_ERROR) {
-        printf("Can't get client ip\n");
-        return NULL;
-    }
-    printf("Client IP/PORT: %s/%d\n", inet_ntoa(client.sin_addr), (int)ntohs(client.sin_port));
-    
-    sprintf(ret->ip, "%s", inet_ntoa(client.sin_addr));
-    ret->port = (int)ntohs(client.sin_port);
-    return ret;
-}
-
-
-/*
- * Splits the given data properly
- * Adds the data to analyser->arcmap
- */
-void split_and_add(ANALYSER *analyser, char *data) {
-    // Encoding: blah blah
-    // Location: http:
-    char key[1024];
-    char value[1024];
-    int control = 0, k = 0, v = 0;
-    
-    for (int i = 0; i < strlen(data); i++) {
-        if (data[i] == ':' && !control) {
-            control++;
-            continue;
-        }
-        if (data[i] == ' ' && control == 1) {
-            control++;
-            continue;
-        }
-        if (!control) {
-            key[k++] = data[i];
-        }
-        if (control == 2) {
-            value[v++] = data[i];
-        }
-    }
-    key[k] = '\0';
-    value[v] = '\0';
-    if (!put_to_map(analyser->arcmap, (char*)&key[0], (char*)&value[0])) {
-        printf("Unable to update arcmap.. Exiting\n");
-        exit(21);
-    }
-    
-}
-
-/*
- * Populates the given analyser depending on the response
- */
-void populate_analyser(ANALYSER *analyser, char *response) {
-
-    u_int lines = how_many_lines(response, '\n');
-    analyser->arcmap = get_blank_map((lines + 3));
-    char **split = split_string(response, '\n'); 
-    analyser->code_meaning = (char*) malloc(strlen(split[0]));
-    change_carriage_return(split[0]);   
-    char *code_n_mean = strdup((char*)&split[0][9]);   
-    char *code = get_code(code_n_mean);
-    char *meaning = strdup((char*)&code_n_mean[4]);
-    
-    if (!put_to_map(analyser->arcmap, "code", code) ||
-            !put_to_map(analyser->arcmap, "meaning", meaning)) {
-        printf("Unable to update arcmap.. Exiting\n");
-        exit(21);
-    }
-
-    free(meaning);
-    free(code);
-    free(code_n_mean);
-    
-    for (u_int i = 1; i < lines; i++) {
-        if (i != lines - 1) {
-            change_carriage_return(split[i]);
-            split_and_add(analyser, split[i]);
-        }
-        free(split[i]);
-    }
-    free(split[0]);
-    free(split);
-}
-
-/*
- * Main Interact loop for connecting webserver
- * Recursively continues if requested page moved to new location
- * Returns number of times it jumps
- */
-int interact(ANALYSER **analysers, BOOL mode, int jump) {
-    SOCKET s = create_sock();
-    struct sockaddr_in server;
-    char *response;
-    analysers[jump] = (ANALYSER*) malloc(sizeof(ANALYSER));
-    
-   
-    
-    if (mode) analysers[jump]->server = get_host_ip();
-    else analysers[jump]->server = get_ip_from_prev(analysers[jump - 1]);
-    
-    if (analysers[jump]->server == NULL && !mode) {
-        puts("can not continue jumping");
-        return jump;
-    }
-    
-    missing = analysers[jump]->server->hostname;
-    resolve_ip(analysers[jump]->server);
-    analysers[jump]->server->port = 80;
-    if (analysers[jump]->server->protocol) {
-        printf("SSL connection not implemented yet, cannot connect to: %s%s%s\n",
-                HTTPS,
-                analysers[jump]->server->hostname,
-                analysers[jump]->server->file);
-        
-        analysers[jump]->server->port = 443;
-        analysers[jump]->arcmap = get_blank_map(4);
-        analysers[jump]->code_meaning = (char*) malloc(sizeof(char) * 100);
-        strcpy(analysers[jump]->code_meaning, "SSL not implemented");
-        put_to_map(analysers[jump]->arcmap, "code", "999");
-        put_to_map(analysers[jump]->arcmap, "meaning", "SSL not implemented");
-        strcpy(analysers[jump]->client->ip, "Did not connected to socket");
-        analysers[jump]->client->port = 0;
-        return jump; //remove this after implementing SSL
-    }
-    
-    populate_server_info(&server, analysers[jump]->server->ip, 
-            analysers[jump]->server->port);
-    
-    printf("Trying to connect to %s... ", analysers[jump]->server->ip);
-    if (connect(s, (struct sockaddr *)&server, sizeof(server)) < 0) {
-        puts("Connection error");
-        return jump;
-    }
-    puts("Connected.");
-    
-    analysers[jump]->client = get_client_info(s);
-    send_HTTP_request(s, analysers[jump]->server->file, analysers[jump]->server->hostname);
-    response = (char*) malloc(9999);
-    int size;
-    if ((size = recv(s , response , 8192 , 0)) == SOCKET_ERROR) {
-        puts("recv() failed");
-        return jump;
-    }
-    printf("Response received from server\n\n"); 
-    response[size] = '\0';
-    //puts(response);
-    populate_analyser(analysers[jump], response);
-    free(response);
-    
-    char *location = get_from_map(analysers[jump]->arcmap, "Location");
-    closesocket(s);
-    if (location) return interact(analysers, FALSE, (jump + 1));
-    else return jump;
-}
-
-/*
- * Attempts to free the memory usage of the 
- * given address struct
- */
-void free_address(ADDRESS *address) {
-    if (address) {
-        if (address->file) free(address->file);
-        if (address->hostname) free(address->hostname);
-        free(address);
-    }
-}
-
-/*
- * Attempts to free the memory usage of the
- * given Analyser array
- */
-void free_analysers(ANALYSER **analysers, int jump) {
-    while (analysers != NULL && jump >= 0) {
-        free_map(analysers[jump]->arcmap);
-
-        free_address(analysers[jump]->client);
-
-        free_address(analysers[jump]->server);
-        
-        if (analysers[jump]->code_meaning) free(analysers[jump]->code_meaning);
-        
-        free(analysers[jump]);
-        jump--;
-    }
-    if (analysers) free(analysers);
-    
-}
-
-/*
- * Generates and returns a Results string
- * using analyser array jump times
- */
-char *get_results(ANALYSER **analysers, int jump) {
-    char *results = (char*) malloc(sizeof(char) * 9999);
-    
-    strcpy(results, "HTTP Protocol Analyzer, Written by Arda Akgur, 43829114\n\n");
-   
-    
-    for (int i = 0; i <= jump; i++) {
-        strcat(results, "#####################################\n\n");
-        char url[200], server[200], client[200], code[200], reply[200];
-        
-        snprintf(url, 200, "Url requested: %s%s\n\n", analysers[i]->server->hostname,
-                analysers[i]->server->file);
-        strcat(results, url);
-  
-        snprintf(server, 200, "Ip address, # Port of the server: %s,%d\n\n", 
-                analysers[i]->server->ip,
-                analysers[i]->server->port);
-        
-        strcat(results, server);
-        
-        snprintf(client, 200, "Ip address, # Port of the client: %s,%d\n\n",
-                analysers[i]->client->ip,
-                analysers[i]->client->port);
-        
-        strcat(results, client);
-        
-        snprintf(code, 200, "Reply code: %s\n\n", 
-                get_from_map(analysers[i]->arcmap, "code"));
-        
-        strcat(results, code);
-        
-        snprintf(reply, 200, "Reply code meaning: %s\n\n", 
-                get_from_map(analysers[i]->arcmap, "meaning"));
-        
-        strcat(results, reply);
-        
-        char dat[200], la[200], con[200], loc[200];
-        
-        char *date = get_from_map(analysers[i]->arcmap, "Date");
-        if (date) {
-            date = convert_GMT_to_AEST(date);
-            snprintf(dat, 200, "Date: %s\n\n", date);
-        }
-        else snprintf(dat, 200, "Date: Not Included\n\n");
-        
-        strcat(results, dat);
-        
-        char *last = get_from_map(analysers[i]->arcmap, "Last-Modified");
-        if (last) {
-            last = convert_GMT_to_AEST(last);
-            snprintf(la, 200, "Last-Modified: %s\n\n", last);
-            
-        }
-        else snprintf(la, 200, "Last-Modified: Not Included\n\n");
-        
-        strcat(results, la);
-        
-        char *content = get_from_map(analysers[i]->arcmap, "Content-Encoding");
-        if (content) snprintf(con, 200, "Content-Encoding: %s\n\n", content);
-        else snprintf(con, 200, "Content-Encoding: Not Included\n\n");
-        
-        strcat(results, con);
-        
-        char *location = get_from_map(analysers[i]->arcmap, "Location");
-        if (location) {
-            snprintf(loc, 200, "Moved to: %s\n\n", location);
-            strcat(results, loc);
-        }
-    }
-    return results;
-}
-
-/*
- * Main loop
- */
-int main(int argc, char **argv) {
-    if (argc > 1) {
-        printf("Usage: %s\n", argv[0]);
-        return 1;
-    }
-    printf("COMS3200 - Assignment I - HTTP Protocol Analyser\n");
-    printf("by Arda 'Arc' Akgur\n\n\n");
-   
-    WSADATA wsa;
-    int jump = 0;
-    initialise_winsock(&wsa);
-    ANALYSER **analysers; 
-    
-    while (TRUE) {
-        analysers = (ANALYSER**) malloc(sizeof(ANALYSER*) * 10);
-        jump = interact(analysers, TRUE, jump);
-        char *results = get_results(analysers, jump);
-        
-        if (!results) {
-            printf("Something went wrong, can not display results\n");
-            free_analysers(analysers, jump);
-            goto Cleanup;
-        }
-        
-        char *response = (char*) malloc(sizeof(char) * 124);
-        BOOL done = FALSE;
-        while (!done) {
-            printf("Enter q/Q for quit..");
-            printf("p/P for print results..");
-            printf("s/S for save results to a file.\n");              
-            printf("Please enter response key to continue: ");
-            
-        
-            if (!fgets(response, 120, stdin)) {
-                puts("End of input from user");
-                goto Cleanup;
-            }
-            if (response[0] == '\n') continue;
-            
-            else if (response[0] == 'q' || response[0] == 'Q') {
-                free(results);
-                free_analysers(analysers, jump);
-                goto Cleanup;
-            } 
-            
-            else if (response[0] == 'p' || response[0] == 'P') {
-                puts("Printing results:\n");
-                puts(results);
-                done = TRUE;
-            }
-            
-            else if (response[0] == 's' || response[0] == 'S') {
-                save_results(results);
-                done = TRUE;
-            } 
-            
-            else {
-                printf("Unrecognized input: %s", response);
-                continue;
-            }
-        }
-        while (TRUE) {
-            printf("Want to run the program again? Y/N ");
-            if (!fgets(response, 100, stdin)) {
-                puts("End of input from user");
-                goto Cleanup;
-            }
-            if (response[0] == '\n') continue;
-            
-            if (response[0] == 'Y' || response[0] == 'y') {
-                free_analysers(analysers, jump);
-                free(response);
-                jump = 0;
-                break;
-                
-            } else if (response[0] == 'N' || response[0] == 'n') {
-                printf("attempts to free analyzers..");
-                free_analysers(analysers, jump);
-                puts("done");
-                printf("attempts to free response..");
-                free(response);
-                puts("done");
-                goto Cleanup;
-            } else {
-                printf("Unrecognized input: %s", response);
-                continue;
-            }
-        }
-        
-    }
-    
-    Cleanup:
-        puts("Unloading Winsock library..");
-        WSACleanup();
-        puts("Thank you for using Arc's HTTP protocol analyzer");
-        
-    return (EXIT_SUCCESS);
-}
-
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   main.c
+ * Author: Arda 'Arc' Akgur
+ * 
+ * Program meant to compile on x64 based windows systems
+ * 
+ * Known issues:
+ *      * There is a slight bug that crashes to program if requested https
+ *          and then if user re-runs the program without exiting
+ *      * Running program more than several times without exiting could cause
+ *          memory issues that result program to crash unexpectedly
+ * 
+ * How to compile and run:
+ *      * Program can compile with either MinGW or CyWin basic Gcc
+ *      * Link ws2_32.a library when compiling
+ * 
+ * Created on March 12, 2018, 3:02 PM AST
+ */
+
+
+#include "utilities.h" // utilities for this program
+#include "datetime.h" // time convert
+#include "url.h" // url parsing and Location resolving
+#include "scheduler.h" // timing wheel for monitor mode
+#include "ratelimit.h" // per host politeness limits
+#include "singleflight.h" // sharing identical hops in flight
+#include "urllist.h" // memory mapped url lists
+#include "probelog.h" // binary history of probed hops
+#include "headers.h" // well known header ids
+#include "reply.h" // reading replies and streaming bodies
+#include "request.h" // request templates
+#include "sockopt.h" // socket tuning and source addresses
+#include "shard.h" // splitting lists between processes
+#include "journal.h" // resuming batch runs
+#include "capture.h" // recording and replaying raw hops
+#include "resultq.h" // writing results from one thread
+#include "stats.h" // summary tables of a run
+#include "proxy.h" // sending hops through a forward proxy
+#include "service.h" // answering probe requests of local tools
+#include "budget.h" // memory budget of a run
+#include "h2.h" // multiplexing HEAD requests over h2c connections
+#include "preconnect.h" // resolving and connecting to redirect targets ahead
+#include <time.h>
+#include <ctype.h>
+
+// use Winsocket library
+#pragma comment(lib,"ws2_32.lib")
+
+
+// pointer to hostent struct in Winsock dll
+THREAD_LOCAL struct hostent *he; 
+
+FLIGHT_GROUP *flights = NULL; // hops in flight, shared between monitor workers
+
+PROBE_LOG *probe_log = NULL; // history of every probed hop, NULL if not kept
+
+PROXY *proxy = NULL; // every hop goes through it, NULL to connect directly
+REQUEST_TEMPLATE *tunnel_template = NULL; // CONNECT sent to the proxy for https urls
+
+H2_POOL *h2_pool = NULL; // h2c connections HEAD hops share, NULL to use HTTP/1.1 only
+
+WARM_POOL *warm_pool = NULL; // redirect targets prepared ahead, NULL with a proxy
+
+SOCKET_TUNING tuning; // applied to every probe socket
+
+SHARD_RING *shard_ring = NULL; // hosts to shards, NULL if not sharded
+u_int shard_index = 0; // shard of this process
+
+CAPTURE *recording = NULL; // raw bytes of every hop, NULL if not recorded
+
+RUN_STATS *run_stats = NULL; // summary of every chain, NULL if not kept
+
+#define MAX_HOPS 20 // hops made for a url if -m is not given
+#define RESULTS_HOP_MAX 2400 // longest results text of one hop
+#define INVALID_URL "Url requested: %s\n\nInvalid url\n\n" // results of a bad url
+
+// How the hops of a chain are requested and read
+typedef struct {
+    BOOL get; // send GET instead of HEAD and digest the bodies
+    BOOL decode; // ask for compressed bodies and decode them
+    REQUEST_TEMPLATE *request; // fixed parts of every request
+    u_int max_hops; // redirects followed are one fewer
+}HOP_MODE;
+
+HOP_MODE run_mode; // set from the command line, service requests may differ
+
+// Struct that holds address data
+typedef struct {
+    char *hostname;
+    char *file;
+    BOOL protocol;
+    char ip[100];
+    int port;
+}ADDRESS;
+
+// Map for storing HTTP response package data
+// Well known headers are kept by id, others by name
+typedef struct {
+    char *known[HEADER_COUNT];
+    char **key;
+    char **value;
+    u_int len;
+    u_int max_size;
+    u_int bytes; // counted against the memory budget as MEM_HEADERS
+}ARCMAP;
+
+// Outcome of a single hop, may be shared by several chains
+typedef struct {
+    char server_ip[100];
+    int server_port;
+    char client_ip[100];
+    int client_port;
+    char *fail_code; // NULL if response holds the reply
+    char *fail_reason;
+    char *response; // status line and headers
+    BODY_INFO body;
+    HOP_CAPTURE capture; // raw bytes when recording
+    u_int charged; // counted against the memory budget as MEM_HOPS
+}HOP_RESULT;
+
+// Hop whose reply is being read, for preparing the one it redirects to
+typedef struct {
+    ADDRESS *address;
+    const HOP_MODE *mode;
+}REDIRECT_SOURCE;
+
+// Struct that holds pointer to address and response map
+typedef struct {
+    ADDRESS *server;
+    ADDRESS *client;
+    ARCMAP *arcmap;
+    int code;
+    char *code_meaning;
+    BODY_INFO body;
+    HOP_CAPTURE capture; // raw bytes when recording
+    u_int charged; // capture bytes counted against the memory budget
+}ANALYSER;
+
+// How following the redirects of a url ended
+enum {
+    CHAIN_DONE, // the last hop did not redirect
+    CHAIN_LOOP, // the last hop redirected to a url already requested
+    CHAIN_TOO_LONG // the last hop redirected but max_hops were made
+};
+
+// Hops made for one url, grows with every redirect followed
+typedef struct {
+    ANALYSER **analysers;
+    u_int size;
+    int jump; // last hop, -1 if there is none
+    int outcome;
+}HOP_CHAIN;
+
+
+/*
+ * Creates and returns pointer to a ARCMAP
+ * map size given as param
+ */
+ARCMAP *get_blank_map(u_int size) {
+    if (!size) return NULL;
+    
+    ARCMAP *res = (ARCMAP*) calloc(1, sizeof(ARCMAP));
+    // entries are copied in as they are put, at their own length
+    res->key = (char**) malloc(sizeof(char*) * size);
+    res->value = (char**) malloc(sizeof(char*) * size);
+    res->len = 0;
+    res->max_size = size;
+    res->bytes = sizeof(ARCMAP) + sizeof(char*) * size * 2;
+    budget_charge(MEM_HEADERS, res->bytes);
+    return res;
+}
+
+/*
+ * Attempts to free the memory usage of
+ * given ARCMAP
+ */
+void free_map(ARCMAP *map) {
+    for (u_int i = 0; i < HEADER_COUNT; i++) {
+        if (map->known[i]) free(map->known[i]);
+    }
+    for (u_int i = 0; i < map->len; i++) {
+        free(map->key[i]);
+        free(map->value[i]);
+    }
+    free(map->key);
+    free(map->value);
+    budget_release(MEM_HEADERS, map->bytes);
+    free(map);
+}
+
+/*
+ * Return corresponding value from the map
+ * depending on the given key
+ * returns NULL if map is NULL
+ * returns NULL if key is not in map
+ * returns corresponding value if successful
+ */
+char *get_from_map(ARCMAP *map, char *key) {
+    if (map == NULL) return NULL;
+    
+    int id = header_id(key, strlen(key));
+    if (id != HDR_UNKNOWN) return map->known[id];
+    for (int i = 0; i < map->len; i++) {
+        if (strcmp(key, map->key[i]) == 0) {
+            return map->value[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Returns the value of a well known header
+ * returns NULL if map is NULL or the header is not in map
+ */
+char *get_header(ARCMAP *map, int id) {
+    return map ? map->known[id] : NULL;
+}
+
+/*
+ * Stores the value of a well known header
+ * The first value of a repeated header is kept
+ * returns False if map is NULL
+ */
+BOOL put_header(ARCMAP *map, int id, char *value) {
+    if (map == NULL) return FALSE;
+    if (!map->known[id]) {
+        map->known[id] = strdup(value);
+        map->bytes += strlen(value) + 1;
+        budget_charge(MEM_HEADERS, strlen(value) + 1);
+    }
+    return TRUE;
+}
+
+/*
+ * Attempts to put given key-value
+ * pairing into the given map
+ * on success returns True
+ * returns False if map is NULL
+ * returns False if map is full
+ */
+BOOL put_to_map(ARCMAP *map, char *key, char*value) {
+    if (map == NULL) return FALSE;
+    int id = header_id(key, strlen(key));
+    if (id != HDR_UNKNOWN) return put_header(map, id, value);
+    if (map->len == map->max_size) return FALSE;
+    map->key[map->len] = strdup(key);
+    map->value[map->len] = strdup(value);
+    u_int bytes = strlen(key) + strlen(value) + 2;
+    map->bytes += bytes;
+    budget_charge(MEM_HEADERS, bytes);
+    
+    map->len++;
+    return TRUE;
+}
+
+/*
+ * Initializes windows socket library
+ * Exits program if fails
+ */
+void initialise_winsock(WSADATA *wsa) {
+    printf("Attempting to initialize Winsock...");
+    if (WSAStartup(MAKEWORD(2,2), wsa) != 0) {
+        printf("Failed. Error Code : %d",WSAGetLastError());
+        exit(1);
+    }
+    printf("Successfully initialized\n");
+}
+
+/*
+ * Creates Socket and returns it
+ * Returns INVALID_SOCKET if fails to create socket
+ */
+SOCKET create_sock(void) {
+    SOCKET s;
+    printf("Creating Socket...");
+    if ((s = socket(AF_INET , SOCK_STREAM , 0 )) == INVALID_SOCKET) {
+        printf("Could not create socket : %d\n" , WSAGetLastError());
+        return INVALID_SOCKET;
+    }
+    printf("Successfully created\n");
+    return s;
+}
+
+/*
+ * Prompts user for hostname and returns as string pointer
+ * Exits program if end of input from user
+ */
+char *get_hostname(void) {
+    char *hostname = (char*) malloc(sizeof(char) * 1024);
+    
+    while (TRUE) {
+        printf("Please Enter website address: ");
+        if (!fgets(hostname, 1024, stdin)) {
+            printf("End of input from user\n");
+            exit(3);
+        }
+        if (hostname[0] != '\n') break;
+    }
+    
+    hostname[strlen(hostname) - 1] = '\0';
+    return hostname;
+}
+
+/*
+ * Populates server struct with given ip address
+ * param server - OUT - pointer to sockaddr_in
+ * param ip - IN - String representation of IP to store
+ * param port - IN - Port to use for connection
+ */
+void populate_server_info(struct sockaddr_in *server, char *ip, int port) {
+    server->sin_addr.s_addr = inet_addr(ip);
+    server->sin_family = AF_INET;
+    server->sin_port = htons(port);
+}
+
+/*
+ * Analyzes hostname
+ * checks protocol and port
+ * splits hostname from path and query
+ * Param IN/OUT address that holds web address
+ * Returns FALSE if it is not a http or https address,
+ * hostname is left untouched and file is NULL in that case
+ */
+BOOL analyze_hostname_input(ADDRESS *address) {
+    printf("Analyzing: %s\n", address->hostname);
+    char *input = address->hostname;
+    char host[URL_MAX];
+    URL url;
+    
+    address->file = NULL;
+    if (!url_parse_input(input, strlen(input), &url)) return FALSE;
+    
+    address->protocol = url_is_https(&url);
+    address->port = url_port(&url);
+    
+    // request target is the path and the query, '/' if empty
+    u_int len = url.path.len + (url.query.ptr ? url.query.len + 1 : 0);
+    address->file = (char*) malloc(len + 2);
+    url_copy_part(url.path, address->file, len + 2);
+    if (!url.path.len) strcpy(address->file, "/");
+    if (url.query.ptr) {
+        strcat(address->file, "?");
+        strncat(address->file, url.query.ptr, url.query.len);
+    }
+    
+    address->hostname = strdup(url_copy_part(url.host, host, URL_MAX));
+    free(input);
+    return TRUE;
+}
+
+/*
+ * Writes the address back as a full url
+ */
+void get_address_url(ADDRESS *address, char *out, u_int size) {
+    snprintf(out, size, "%s%s:%d%s", address->protocol ? HTTPS : HTTP,
+            address->hostname, address->port, address->file);
+}
+
+/*
+ * Attempts to free the memory usage of the 
+ * given address struct
+ */
+void free_address(ADDRESS *address) {
+    if (address) {
+        if (address->file) free(address->file);
+        if (address->hostname) free(address->hostname);
+        free(address);
+    }
+}
+
+/*
+ * Prompt user for hostname via get_hostname()
+ * Populates pointer to a ADDRESS struct
+ * with hostname and ip address
+ * Exits program if user inputs 5 invalid hostname
+ * Returns ADDRESS struct if successful
+ */
+ADDRESS *get_host_ip(void) {
+    ADDRESS *res = (ADDRESS*) malloc(sizeof(ADDRESS));
+    int tries = 0;
+    
+    while (TRUE) {
+        res->hostname = get_hostname();
+        puts(res->hostname);
+        if (analyze_hostname_input(res)) {
+            printf("User Input: %s%s\n", res->hostname, res->file);
+            if ((he = gethostbyname(res->hostname)) != NULL) break;
+            printf("gethostbyname() failed : %d\n" , WSAGetLastError());
+        } else {
+            printf("Invalid website address\n");
+        }
+        free(res->hostname);
+        if (res->file) free(res->file);
+        tries++;
+        if (tries == 5) {
+            printf("Too many invalid hostname tries.. Exiting.\n");
+            exit(5);
+        }
+    }
+    return res;
+}
+
+/*
+ * Populates pointer to a ADDRESS struct from the given url
+ * without prompting the user, used by the non interactive modes
+ * Hostname is resolved later by resolve_ip()
+ * Returns NULL if the url is invalid
+ */
+ADDRESS *get_host_ip_from(char *url) {
+    ADDRESS *res = (ADDRESS*) malloc(sizeof(ADDRESS));
+    res->hostname = strdup(url);
+    if (!analyze_hostname_input(res)) {
+        printf("Invalid url: %s\n", url);
+        free_address(res);
+        return NULL;
+    }
+    return res;
+}
+
+/*
+ * Attempts to get the host and ip of next address Location
+ * This function should run if the initial website request 
+ * moved to a different location with code 301 or similar
+ * Relative Location values are resolved against the previous hop
+ * Returns the new pointer to a Address struct if successful
+ * Returns NULL on fail
+ */
+ADDRESS *get_ip_from_prev(ANALYSER *prev) {
+    char *location = get_header(prev->arcmap, HDR_LOCATION);
+    char base_url[URL_MAX], target[URL_MAX];
+    URL base, ref;
+    
+    if (!location) {
+        puts("Can not locate new Location");
+        return NULL;
+    }
+    get_address_url(prev->server, base_url, URL_MAX);
+    if (!url_parse(base_url, strlen(base_url), &base) ||
+            !url_parse(location, strlen(location), &ref) ||
+            !url_resolve(&base, &ref, target, URL_MAX)) {
+        printf("Invalid Location: %s\n", location);
+        return NULL;
+    }
+    
+    ADDRESS *res = (ADDRESS*) malloc(sizeof(ADDRESS));
+    res->hostname = strdup(target);
+    if (!analyze_hostname_input(res)) {
+        printf("Unsupported Location: %s\n", target);
+        free_address(res);
+        return NULL;
+    }
+    printf("New Host: %s # New Path: %s\n", res->hostname, res->file);
+    return res;
+}
+
+/*
+ * Resolves hostname into IP address
+ * param address - IN/OUT 
+ * Returns FALSE if gethostbyname() fails
+ */
+BOOL resolve_ip(ADDRESS *address) {
+    if ((he = gethostbyname(address->hostname)) == NULL) {
+        printf("gethostbyname() failed : %d\n" , WSAGetLastError());
+        return FALSE;
+    }
+    //Cast the h_addr_list to in_addr , since h_addr_list also has the ip address in long format only
+    struct in_addr **addr_list = (struct in_addr **) he->h_addr_list;
+
+    for(int i = 0; addr_list[i] != NULL; i++) {
+        //Return the first one;
+        strcpy(address->ip, inet_ntoa(*addr_list[i]));
+        //address->ip = strdup(inet_ntoa(*addr_list[i]));
+    }
+     
+    printf("%s resolved to : %s\n" , address->hostname , address->ip);
+    return TRUE;
+}
+
+/*
+ * Resolves a hostname for the preconnect pool, as resolve_ip() does
+ */
+BOOL resolve_host(const char *host, char *ip) {
+    ADDRESS address;
+    memset(&address, 0, sizeof(ADDRESS));
+    address.hostname = (char*) host;
+    if (!resolve_ip(&address)) return FALSE;
+    strcpy(ip, address.ip);
+    return TRUE;
+}
+
+/*
+ * Attempts to get this client's ip and port
+ * stores and returns in ADDRESS struct if successful
+ * if fails returns NULL
+ */
+ADDRESS *get_client_info(SOCKET s) {
+    struct sockaddr_in client;
+    ADDRESS *ret = (ADDRESS*) malloc(sizeof(ADDRESS));
+    ret->hostname = NULL;
+    ret->file = NULL;
+    int client_len = (int) sizeof(client);
+    if (getsockname(s, (struct sockaddr*)&client, &client_len) == SOCKET_ERROR) {
+        printf("Can't get client ip\n");
+        return NULL;
+    }
+    printf("Client IP/PORT: %s/%d\n", inet_ntoa(client.sin_addr), (int)ntohs(client.sin_port));
+    
+    sprintf(ret->ip, "%s", inet_ntoa(client.sin_addr));
+    ret->port = (int)ntohs(client.sin_port);
+    return ret;
+}
+
+
+/*
+ * Splits the given data properly
+ * Adds the data to analyser->arcmap
+ */
+void split_and_add(ANALYSER *analyser, char *data) {
+    // Encoding: blah blah
+    // Location: http:
+    char key[1024];
+    char value[1024];
+    int control = 0, k = 0, v = 0;
+    
+    for (int i = 0; i < strlen(data); i++) {
+        if (data[i] == ':' && !control) {
+            control++;
+            continue;
+        }
+        if (data[i] == ' ' && control == 1) {
+            control++;
+            continue;
+        }
+        if (!control && k < 1023) {
+            key[k++] = data[i];
+        }
+        if (control == 2 && v < 1023) {
+            value[v++] = data[i];
+        }
+    }
+    key[k] = '\0';
+    value[v] = '\0';
+    int id = header_id(key, k);
+    BOOL added = id != HDR_UNKNOWN ? put_header(analyser->arcmap, id, value) :
+            put_to_map(analyser->arcmap, (char*)&key[0], (char*)&value[0]);
+    if (!added) printf("Unable to update arcmap, header %s dropped\n", key);
+    
+}
+
+/*
+ * Populates the given analyser depending on the response
+ */
+void populate_analyser(ANALYSER *analyser, char *response) {
+
+    u_int lines = how_many_lines(response, '\n');
+    analyser->arcmap = get_blank_map((lines + 3));
+    char **split = split_string(response, '\n'); 
+    analyser->code_meaning = (char*) malloc(strlen(split[0]));
+    change_carriage_return(split[0]);   
+    char *code_n_mean = strdup(strlen(split[0]) >= 12 ? (char*)&split[0][9] : 
+            "000 Malformed status line");   
+    char *code = get_code(code_n_mean);
+    char *meaning = strdup(strlen(code_n_mean) > 4 ? (char*)&code_n_mean[4] : "");
+    
+    put_header(analyser->arcmap, HDR_CODE, code);
+    put_header(analyser->arcmap, HDR_MEANING, meaning);
+
+    free(meaning);
+    free(code);
+    free(code_n_mean);
+    
+    for (u_int i = 1; i < lines; i++) {
+        if (i != lines - 1) {
+            change_carriage_return(split[i]);
+            split_and_add(analyser, split[i]);
+        }
+        free(split[i]);
+    }
+    free(split[0]);
+    free(split);
+}
+
+/*
+ * Fills the analyser with a pseudo reply for a hop that
+ * could not be completed, so results can still be generated
+ */
+void mark_failed(ANALYSER *analyser, char *code, char *reason) {
+    analyser->arcmap = get_blank_map(1);
+    analyser->code_meaning = strdup(reason);
+    put_header(analyser->arcmap, HDR_CODE, code);
+    put_header(analyser->arcmap, HDR_MEANING, reason);
+    if (!analyser->client) {
+        analyser->client = (ADDRESS*) malloc(sizeof(ADDRESS));
+        analyser->client->hostname = NULL;
+        analyser->client->file = NULL;
+    }
+    strcpy(analyser->client->ip, "Did not connected to socket");
+    analyser->client->port = 0;
+}
+
+/*
+ * Builds the key identifying a hop for in flight sharing
+ * the normalized url of the address
+ */
+void get_hop_key(ADDRESS *address, char *key, u_int size) {
+    char full[URL_MAX];
+    URL url;
+    get_address_url(address, full, URL_MAX);
+    if (!url_parse(full, strlen(full), &url) || !url_normalize(&url, key, size)) {
+        snprintf(key, size, "%s", full);
+    }
+}
+
+/*
+ * Frees a hop result once no analyser shares it
+ */
+void free_hop_result(void *data) {
+    HOP_RESULT *result = (HOP_RESULT*) data;
+    budget_release(MEM_HOPS, result->charged);
+    if (result->response) free(result->response);
+    free_hop_capture(&result->capture);
+    free(result);
+}
+
+/*
+ * Called once the head of a hop's reply is read
+ * A Location in it is resolved against the hop and its host looked
+ * up and connected to in the background, while this hop reads its
+ * body and is analysed, so the next hop finds both ready
+ * https targets are left alone as the hop would not connect to them,
+ * HEAD hops going over h2c only have the host looked up
+ */
+void start_preconnect(void *context, const char *head) {
+    REDIRECT_SOURCE *source = (REDIRECT_SOURCE*) context;
+    char location[URL_MAX], base_url[URL_MAX], target[URL_MAX], host[URL_MAX];
+    const char *line = strchr(head, '\n');
+    URL base, ref, url;
+    
+    location[0] = '\0';
+    while (line && *++line && *line != '\r' && *line != '\n') {
+        const char *end = strchr(line, '\n'), *colon = strchr(line, ':');
+        if (!end) break;
+        if (colon && colon < end && header_id(line, colon - line) == HDR_LOCATION) {
+            const char *value = colon + 1;
+            int len;
+            while (*value == ' ' || *value == '\t') value++;
+            for (len = (int) (end - value); len > 0 && isspace((unsigned char) value[len - 1]); 
+                    len--);
+            snprintf(location, URL_MAX, "%.*s", len, value);
+        }
+        line = end;
+    }
+    if (!location[0]) return;
+    
+    get_address_url(source->address, base_url, URL_MAX);
+    if (!url_parse(base_url, strlen(base_url), &base) ||
+            !url_parse(location, strlen(location), &ref) ||
+            !url_resolve(&base, &ref, target, URL_MAX) ||
+            !url_parse_input(target, strlen(target), &url) || url_is_https(&url)) return;
+    url_copy_part(url.host, host, URL_MAX);
+    preconnect(warm_pool, host, url_port(&url), !h2_pool || source->mode->get);
+}
+
+/*
+ * Sends a request of the mode on a connected socket and reads the
+ * reply into result, or a CONNECT request if tunnel is TRUE
+ * target goes on the request line: the path, or for a proxy the
+ * whole url, or host:port to open a tunnel
+ * port is given in the Host line unless it is 0
+ * The redirect target of address is prepared ahead while the reply
+ * is read, unless address is NULL
+ * Returns FALSE with the failure set in result if either fails,
+ * reusable is set if the connection is left at the end of the reply
+ */
+BOOL exchange_hop(SOCKET s, const HOP_MODE *mode, BOOL tunnel, char *target, char *host, 
+        int port, ADDRESS *address, HOP_RESULT *result, LARGE_INTEGER *started, 
+        BOOL *reusable) {
+    HOP_CAPTURE *capture = &result->capture;
+    REDIRECT_SOURCE redirect;
+    REQUEST_TEMPLATE *request = tunnel ? tunnel_template : mode->request;
+    *reusable = FALSE;
+    
+    ADDRESS *client = get_client_info(s);
+    if (client) {
+        strcpy(result->client_ip, client->ip);
+        result->client_port = client->port;
+        free_address(client);
+    }
+    printf("Sending: %s%s\n", request->start, target);
+    if (recording) {
+        capture->request = format_request(request, target, host, port, &capture->request_len);
+    }
+    if (!send_request(s, request, target, host, port)) {
+        puts("send() failed");
+        result->fail_code = "000";
+        result->fail_reason = "send() failed";
+        return FALSE;
+    }
+    HTTP_REPLY reply;
+    REPLY_SOURCE source;
+    socket_source(&source, s, recording != NULL);
+    if (address && warm_pool) {
+        redirect.address = address;
+        redirect.mode = mode;
+        source.head_read = start_preconnect;
+        source.context = &redirect;
+    }
+    // replies to CONNECT have no body
+    BOOL replied = read_reply(&source, mode->get && !tunnel, mode->decode, &reply);
+    capture->times[CT_DONE] = capture_micros(started, NULL);
+    read_tcp_stats(s, &capture->tcp);
+    if (source.first_byte.QuadPart) {
+        capture->times[CT_FIRST_BYTE] = capture_micros(started, &source.first_byte);
+    }
+    capture->reply = source.tape;
+    capture->reply_len = source.tape_len;
+    if (source.truncated) {
+        printf("Reply longer than %u bytes, capture is cut short\n", CAPTURE_TAPE_MAX);
+        capture->flags |= CAPTURE_TRUNCATED;
+    }
+    if (!replied) {
+        puts("recv() failed");
+        result->fail_code = "000";
+        result->fail_reason = "recv() failed";
+        return FALSE;
+    }
+    result->response = reply.head;
+    result->body = reply.body;
+    *reusable = reply.reusable;
+    return TRUE;
+}
+
+/*
+ * Sends the hop through the proxy, which resolves the host itself
+ * http urls go in absolute form on a kept alive connection if there
+ * is one, https urls get a CONNECT tunnel, which is as far as they
+ * go without SSL
+ * A kept alive connection the proxy closed in the meantime gets
+ * nothing back, the request is then sent once more on a new one
+ */
+void fetch_proxied(ADDRESS *address, const HOP_MODE *mode, HOP_RESULT *result, 
+        LARGE_INTEGER *started) {
+    HOP_CAPTURE *capture = &result->capture;
+    BOOL tunnel = address->protocol;
+    char target[URL_MAX + 20];
+    int port = address->port == (address->protocol ? 443 : 80) ? 0 : address->port;
+    
+    strcpy(result->server_ip, proxy->ip);
+    result->server_port = address->port;
+    capture->times[CT_RESOLVED] = capture_micros(started, NULL);
+    if (tunnel) {
+        port = address->port;
+        snprintf(target, sizeof(target), "%s:%d", address->hostname, port);
+        capture->flags &= ~(CAPTURE_GET | CAPTURE_DECODE);
+    } else if (port) {
+        snprintf(target, sizeof(target), "%s%s:%d%s", HTTP, address->hostname, port, 
+                address->file);
+    } else {
+        snprintf(target, sizeof(target), "%s%s%s", HTTP, address->hostname, address->file);
+    }
+    
+    for (int attempt = 0; attempt < 2; attempt++) {
+        BOOL reused, reusable;
+        printf("Trying proxy %s:%d... ", proxy->ip, proxy->port);
+        SOCKET s = proxy_connect(proxy, &tuning, attempt > 0, &reused);
+        if (s == INVALID_SOCKET) {
+            puts("Connection error");
+            result->fail_code = "000";
+            result->fail_reason = "Connection error";
+            return;
+        }
+        puts(reused ? "Reusing kept alive connection." : "Connected.");
+        capture->times[CT_CONNECTED] = capture_micros(started, NULL);
+        
+        BOOL replied = exchange_hop(s, mode, tunnel, target, address->hostname, port, NULL,
+                result, started, &reusable);
+        if (!replied && reused && !attempt && !capture->times[CT_FIRST_BYTE]) {
+            proxy_release(proxy, s, FALSE);
+            free_hop_capture(capture);
+            result->fail_code = result->fail_reason = NULL;
+            continue;
+        }
+        if (replied && tunnel && result->response[9] == '2') {
+            printf("Tunnel to %s established, SSL not implemented yet\n", target);
+            free(result->response);
+            result->response = NULL;
+            // replays take the failure as it is
+            if (capture->reply) free(capture->reply);
+            capture->reply = NULL;
+            capture->reply_len = 0;
+            result->fail_code = "999";
+            result->fail_reason = "SSL not implemented";
+            replied = reusable = FALSE;
+        }
+        if (replied) printf("Response received from proxy\n\n");
+        proxy_release(proxy, s, replied && reusable);
+        return;
+    }
+}
+
+/*
+ * Sends the hop as a stream on the origin's h2c connection
+ * The decoded reply head is written out as text, so it is analysed,
+ * logged and captured like one read over HTTP/1.1
+ * Returns FALSE if the origin has no h2c, the hop is then up to
+ * HTTP/1.1
+ */
+BOOL fetch_h2(ADDRESS *address, const HOP_MODE *mode, HOP_RESULT *result, 
+        LARGE_INTEGER *started) {
+    HOP_CAPTURE *capture = &result->capture;
+    char authority[URL_MAX + 8];
+    H2_REPLY reply;
+    int port = address->port == 80 ? 0 : address->port;
+    
+    if (port) snprintf(authority, sizeof(authority), "%s:%d", address->hostname, port);
+    else snprintf(authority, sizeof(authority), "%s", address->hostname);
+    printf("Sending over h2c: %s%s\n", mode->request->start, address->file);
+    int state = h2_request(h2_pool, result->server_ip, result->server_port, authority, 
+            mode->request, address->file, &reply);
+    if (state == H2_UNSUPPORTED) {
+        printf("No h2c for %s, using HTTP/1.1\n", authority);
+        return FALSE;
+    }
+    capture->times[CT_DONE] = capture_micros(started, NULL);
+    if (reply.sent.QuadPart) capture->times[CT_CONNECTED] = capture_micros(started, &reply.sent);
+    if (reply.first_byte.QuadPart) {
+        capture->times[CT_FIRST_BYTE] = capture_micros(started, &reply.first_byte);
+    }
+    strcpy(result->client_ip, reply.client_ip);
+    result->client_port = reply.client_port;
+    capture->tcp = reply.tcp;
+    if (recording) {
+        capture->request = format_request(mode->request, address->file, address->hostname, 
+                port, &capture->request_len);
+    }
+    if (state == H2_FAILED) {
+        puts(reply.reason);
+        result->fail_code = "000";
+        result->fail_reason = (char*) reply.reason;
+        return TRUE;
+    }
+    if (recording) {
+        capture->reply = strdup(reply.head);
+        capture->reply_len = strlen(reply.head);
+    }
+    if (warm_pool) {
+        REDIRECT_SOURCE redirect;
+        redirect.address = address;
+        redirect.mode = mode;
+        start_preconnect(&redirect, reply.head);
+    }
+    result->response = reply.head;
+    printf("Response received from server\n\n");
+    return TRUE;
+}
+
+/*
+ * Resolves, connects and sends the request of the mode for a single hop
+ * HEAD hops go over h2c when it is turned on and the origin has it
+ * A lookup and connection the previous hop started for this one are
+ * taken instead, the request is sent once more on a new connection
+ * if the server closed the one made ahead without replying
+ * Returns what the server replied, or why the hop failed
+ */
+HOP_RESULT *fetch_hop(ADDRESS *address, const HOP_MODE *mode) {
+    HOP_RESULT *result = (HOP_RESULT*) calloc(1, sizeof(HOP_RESULT));
+    HOP_CAPTURE *capture = &result->capture;
+    struct sockaddr_in server;
+    LARGE_INTEGER started;
+    BOOL reusable;
+    
+    QueryPerformanceCounter(&started);
+    capture->flags = (mode->get ? CAPTURE_GET : 0) | (mode->decode ? CAPTURE_DECODE : 0);
+    if (proxy) {
+        fetch_proxied(address, mode, result, &started);
+        return result;
+    }
+    result->server_port = address->port;
+    // the previous hop may have looked the host up and connected already
+    SOCKET s = INVALID_SOCKET;
+    int warm = warm_pool ? take_preconnect(warm_pool, address->hostname, address->port, 
+            address->ip, &s) : WARM_NONE;
+    BOOL resolved = warm == WARM_NONE ? resolve_ip(address) : warm != WARM_FAILED;
+    capture->times[CT_RESOLVED] = capture_micros(&started, NULL);
+    if (!resolved) {
+        strcpy(result->server_ip, "Unable to resolve");
+        result->fail_code = "000";
+        result->fail_reason = "Unable to resolve hostname";
+        return result;
+    }
+    if (warm != WARM_NONE) printf("%s resolved ahead to : %s\n", address->hostname, address->ip);
+    strcpy(result->server_ip, address->ip);
+    if (address->protocol) {
+        printf("SSL connection not implemented yet, cannot connect to: %s%s%s\n",
+                HTTPS, address->hostname, address->file);
+        
+        if (s != INVALID_SOCKET) closesocket(s);
+        result->fail_code = "999";
+        result->fail_reason = "SSL not implemented";
+        return result; //remove this after implementing SSL
+    }
+    if (h2_pool && !mode->get && fetch_h2(address, mode, result, &started)) {
+        if (s != INVALID_SOCKET) closesocket(s);
+        return result;
+    }
+    
+    int port = address->port == (address->protocol ? 443 : 80) ? 0 : address->port;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        BOOL ahead = s != INVALID_SOCKET;
+        if (ahead) {
+            printf("Trying to connect to %s... Connected ahead.\n", result->server_ip);
+        } else {
+            if ((s = create_sock()) == INVALID_SOCKET) {
+                result->fail_code = "000";
+                result->fail_reason = "Could not create socket";
+                return result;
+            }
+            if (!tune_socket(s, &tuning)) {
+                closesocket(s);
+                result->fail_code = "000";
+                result->fail_reason = "Unable to bind source address";
+                return result;
+            }
+            populate_server_info(&server, result->server_ip, result->server_port);
+            
+            printf("Trying to connect to %s... ", result->server_ip);
+            if (connect(s, (struct sockaddr *)&server, sizeof(server)) < 0) {
+                puts("Connection error");
+                closesocket(s);
+                result->fail_code = "000";
+                result->fail_reason = "Connection error";
+                return result;
+            }
+            puts("Connected.");
+        }
+        capture->times[CT_CONNECTED] = capture_micros(&started, NULL);
+        
+        if (exchange_hop(s, mode, FALSE, address->file, address->hostname, port, address, 
+                result, &started, &reusable)) {
+            printf("Response received from server\n\n"); 
+        } else if (ahead && !capture->times[CT_FIRST_BYTE]) {
+            // the server closed the connection opened ahead while it waited
+            closesocket(s);
+            s = INVALID_SOCKET;
+            free_hop_capture(capture);
+            result->fail_code = result->fail_reason = NULL;
+            continue;
+        }
+        break;
+    }
+    closesocket(s);
+    return result;
+}
+
+/*
+ * Copies a hop result into the analyser of this chain
+ */
+void apply_hop_result(ANALYSER *analyser, HOP_RESULT *result) {
+    strcpy(analyser->server->ip, result->server_ip);
+    analyser->server->port = result->server_port;
+    // timing is always kept, the raw bytes only when recording
+    analyser->capture = result->capture;
+    analyser->capture.request = analyser->capture.reply = NULL;
+    if (recording) {
+        copy_hop_capture(&analyser->capture, &result->capture);
+        analyser->charged = analyser->capture.request_len + analyser->capture.reply_len;
+        budget_charge(MEM_CAPTURE, analyser->charged);
+        // failed before any reply, replays take the failure as it is
+        if (result->fail_code && !result->capture.reply_len) {
+            analyser->capture.flags |= CAPTURE_FAILED;
+        }
+    }
+    if (result->fail_code) {
+        mark_failed(analyser, result->fail_code, result->fail_reason);
+        return;
+    }
+    analyser->client = (ADDRESS*) malloc(sizeof(ADDRESS));
+    analyser->client->hostname = NULL;
+    analyser->client->file = NULL;
+    strcpy(analyser->client->ip, result->client_ip);
+    analyser->client->port = result->client_port;
+    analyser->body = result->body;
+    populate_analyser(analyser, result->response);
+}
+
+/*
+ * Main Interact loop for connecting webserver
+ * Prompts user for the first address if url is NULL
+ * Hops already in flight for another chain of the same mode are
+ * waited on and shared
+ * Follows Location headers until a hop does not redirect, a redirect
+ * leads back to a url of the chain or the mode's max_hops were made
+ * Returns number of times it jumps, -1 if there is no first address
+ */
+int interact(HOP_CHAIN *chain, char *url, const HOP_MODE *mode) {
+    URL_SET visited;
+    u_int max_hops = mode->max_hops;
+    
+    chain->size = 4;
+    chain->analysers = (ANALYSER**) malloc(sizeof(ANALYSER*) * chain->size);
+    chain->jump = -1;
+    chain->outcome = CHAIN_DONE;
+    url_set_init(&visited, max_hops * 2);
+    
+    while (TRUE) {
+        int jump = chain->jump + 1;
+        ADDRESS *server;
+        if (!jump) server = url ? get_host_ip_from(url) : get_host_ip();
+        else server = get_ip_from_prev(chain->analysers[jump - 1]);
+        if (server == NULL) {
+            if (jump) puts("can not continue jumping");
+            break;
+        }
+        
+        char key[URL_MAX];
+        get_hop_key(server, key, URL_MAX);
+        if (!url_set_add(&visited, key)) {
+            printf("Redirect loop, %s was already requested\n", key);
+            chain->outcome = CHAIN_LOOP;
+            free_address(server);
+            break;
+        }
+        if (jump == (int) max_hops) {
+            printf("Stopped after %u hops\n", max_hops);
+            chain->outcome = CHAIN_TOO_LONG;
+            free_address(server);
+            break;
+        }
+        if (jump == (int) chain->size) {
+            chain->size *= 2;
+            chain->analysers = (ANALYSER**) realloc(chain->analysers, 
+                    sizeof(ANALYSER*) * chain->size);
+        }
+        ANALYSER *analyser = (ANALYSER*) calloc(1, sizeof(ANALYSER));
+        analyser->server = server;
+        chain->analysers[jump] = analyser;
+        chain->jump = jump;
+        
+        // replies to another method are not the same, nor are their results
+        char flight_key[URL_MAX + 4];
+        snprintf(flight_key, URL_MAX + 4, "%s%s", mode->decode ? "z " : mode->get ? "g " : "", 
+                key);
+        
+        HOP_RESULT *result;
+        FLIGHT *flight = NULL;
+        BOOL leader = TRUE;
+        if (flights) flight = flight_join(flights, flight_key, &leader);
+        if (leader) {
+            result = fetch_hop(server, mode);
+            result->charged = sizeof(HOP_RESULT) + result->capture.request_len + 
+                    result->capture.reply_len;
+            if (result->response) result->charged += strlen(result->response) + 1;
+            budget_charge(MEM_HOPS, result->charged);
+            if (flight) flight_finish(flights, flight, result);
+        } else {
+            printf("Sharing in flight request for %s%s\n", server->hostname, server->file);
+            result = (HOP_RESULT*) flight_wait(flights, flight);
+        }
+        apply_hop_result(analyser, result);
+        if (flight) flight_leave(flights, flight);
+        else free_hop_result(result);
+        
+        if (!get_header(analyser->arcmap, HDR_LOCATION)) break;
+    }
+    url_set_free(&visited);
+    return chain->jump;
+}
+
+/*
+ * Attempts to free the memory usage of the
+ * given Analyser array
+ */
+void free_analysers(ANALYSER **analysers, int jump) {
+    while (analysers != NULL && jump >= 0) {
+        free_map(analysers[jump]->arcmap);
+
+        free_address(analysers[jump]->client);
+
+        free_address(analysers[jump]->server);
+        
+        if (analysers[jump]->code_meaning) free(analysers[jump]->code_meaning);
+        
+        budget_release(MEM_CAPTURE, analysers[jump]->charged);
+        free_hop_capture(&analysers[jump]->capture);
+        
+        free(analysers[jump]);
+        jump--;
+    }
+    if (analysers) free(analysers);
+    
+}
+
+/*
+ * Generates and returns a Results string
+ * using analyser array jump times
+ * outcome tells how following the redirects ended
+ */
+char *get_results(ANALYSER **analysers, int jump, int outcome) {
+    // every line of a hop is at most 200 characters
+    char *results = (char*) malloc(sizeof(char) * (RESULTS_HOP_MAX * (jump + 1) + 400));
+    
+    strcpy(results, "HTTP Protocol Analyzer, Written by Arda Akgur, 43829114\n\n");
+   
+    
+    for (int i = 0; i <= jump; i++) {
+        strcat(results, "#####################################\n\n");
+        char url[200], server[200], client[200], code[200], reply[200];
+        
+        snprintf(url, 200, "Url requested: %s%s\n\n", analysers[i]->server->hostname,
+                analysers[i]->server->file);
+        strcat(results, url);
+  
+        snprintf(server, 200, "Ip address, # Port of the server: %s,%d\n\n", 
+                analysers[i]->server->ip,
+                analysers[i]->server->port);
+        
+        strcat(results, server);
+        
+        snprintf(client, 200, "Ip address, # Port of the client: %s,%d\n\n",
+                analysers[i]->client->ip,
+                analysers[i]->client->port);
+        
+        strcat(results, client);
+        
+        // the kernel's view of the connection, apart from the server's
+        TCP_STATS *tcp = &analysers[i]->capture.tcp;
+        if (tcp->rtt) {
+            char network[200];
+            snprintf(network, 200, "TCP round trip: %.3f ms, lowest %.3f ms, "
+                    "retransmits: %u, congestion window: %u bytes\n\n", 
+                    tcp->rtt / 1000.0, tcp->rtt_min / 1000.0, tcp->retransmits, tcp->cwnd);
+            strcat(results, network);
+        }
+        
+        snprintf(code, 200, "Reply code: %s\n\n", 
+                get_header(analysers[i]->arcmap, HDR_CODE));
+        
+        strcat(results, code);
+        
+        snprintf(reply, 200, "Reply code meaning: %s\n\n", 
+                get_header(analysers[i]->arcmap, HDR_MEANING));
+        
+        strcat(results, reply);
+        
+        char dat[200], la[200], con[200], loc[200];
+        
+        char *date = get_header(analysers[i]->arcmap, HDR_DATE);
+        if (date) {
+            date = convert_GMT_to_AEST(date);
+            snprintf(dat, 200, "Date: %s\n\n", date);
+            free(date);
+        }
+        else snprintf(dat, 200, "Date: Not Included\n\n");
+        
+        strcat(results, dat);
+        
+        char *last = get_header(analysers[i]->arcmap, HDR_LAST_MODIFIED);
+        if (last) {
+            last = convert_GMT_to_AEST(last);
+            snprintf(la, 200, "Last-Modified: %s\n\n", last);
+            free(last);
+        }
+        else snprintf(la, 200, "Last-Modified: Not Included\n\n");
+        
+        strcat(results, la);
+        
+        char *content = get_header(analysers[i]->arcmap, HDR_CONTENT_ENCODING);
+        if (content) snprintf(con, 200, "Content-Encoding: %s\n\n", content);
+        else snprintf(con, 200, "Content-Encoding: Not Included\n\n");
+        
+        strcat(results, con);
+        
+        char *location = get_header(analysers[i]->arcmap, HDR_LOCATION);
+        if (location) {
+            snprintf(loc, 200, "Moved to: %s\n\n", location);
+            strcat(results, loc);
+        }
+        
+        BODY_INFO *body = &analysers[i]->body;
+        if (body->read) {
+            char size[200];
+            snprintf(size, 200, "Body size: %llu bytes\n\nBody hash: %016llx\n\n",
+                    (unsigned long long) body->size, (unsigned long long) body->hash);
+            strcat(results, size);
+        }
+        if (body->read && body->decoded) {
+            char decoded[200];
+            if (body->coding == CODING_IDENTITY) {
+                snprintf(decoded, 200, "Uncompressed size: %llu bytes, "
+                        "served without compression\n\n", 
+                        (unsigned long long) body->size);
+            } else if (body->decode_failed) {
+                snprintf(decoded, 200, "Uncompressed size: unknown, "
+                        "unable to decode %s\n\n", coding_name(body->coding));
+            } else {
+                double seconds = body->decode_seconds > 0 ? body->decode_seconds : 1e-9;
+                snprintf(decoded, 200, "Uncompressed size: %llu bytes, ratio %.2f, "
+                        "decoded %s at %.1f MB/s\n\n",
+                        (unsigned long long) body->decoded_size,
+                        body->size ? (double) body->decoded_size / body->size : 0.0,
+                        coding_name(body->coding), 
+                        body->decoded_size / seconds / 1000000.0);
+            }
+            strcat(results, decoded);
+        }
+    }
+    if (outcome == CHAIN_LOOP) {
+        strcat(results, "Redirect loop: Location leads back to a url already requested\n\n");
+    } else if (outcome == CHAIN_TOO_LONG) {
+        char limit[200];
+        snprintf(limit, 200, "Redirects not followed after %d hops\n\n", jump + 1);
+        strcat(results, limit);
+    }
+    return results;
+}
+
+#define MAX_HEADERS 16 // -H given at most this many times
+
+// Command line options
+typedef struct {
+    char *monitor_file;
+    char *batch_file;
+    char *output_file;
+    char *log_base;
+    u_int interval; // seconds
+    u_int jitter; // percent
+    u_int workers;
+    u_int host_max;
+    BOOL adaptive; // per host concurrency found by probing, host_max is its ceiling
+    double host_rps;
+    BOOL get; // GET instead of HEAD
+    BOOL decode; // analyse Content-Encoding, implies get
+    char *agent; // User-Agent, none if NULL
+    char *headers[MAX_HEADERS]; // extra header lines
+    u_int header_count;
+    SOCKET_TUNING tuning;
+    u_int shard_index;
+    u_int shard_count; // 0 if not sharded
+    char *journal_file; // batch progress, NULL if not kept
+    char *capture_file; // raw hops are recorded here, NULL if not recorded
+    u_int max_hops;
+    char *stats_file; // summary of the run is written here, NULL if not kept
+    char *proxy; // host[:port] of the forward proxy, NULL to connect directly
+    int service_port; // loopback port of the service, 0 if not a service
+    u_int memory_mb; // memory budget of urls in progress, 0 for none
+    BOOL h2c; // HEAD hops over h2c where origins have it
+}OPTIONS;
+
+// One url probed by the monitor and batch modes
+typedef struct {
+    TIMER timer;
+    char *url;
+    TICK interval; // in wheel ticks
+    u_int line; // line of the url in the list file
+    HOST_LIMIT *limit; // politeness limits of the url's host
+    TICK delay; // set by the worker, ticks to defer the url by
+}PROBE;
+
+// Fixed size queue passing probes between threads
+typedef struct {
+    PROBE **items;
+    u_int size;
+    u_int head;
+    u_int len;
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE ready;
+}PROBE_QUEUE;
+
+// State shared by the monitor or batch loop and its workers
+typedef struct {
+    PROBE_QUEUE todo; // due urls waiting for a worker
+    PROBE_QUEUE done; // probed or deferred urls
+    RATE_LIMITER *limiter;
+    RESULT_WRITER *results;
+    HANDLE *threads;
+    u_int workers;
+    u_int handed; // urls given to the workers and not back yet, loop thread only
+}PROBE_POOL;
+
+/*
+ * Prepares an empty queue able to hold size probes
+ */
+void init_queue(PROBE_QUEUE *queue, u_int size) {
+    queue->items = (PROBE**) malloc(sizeof(PROBE*) * size);
+    queue->size = size;
+    queue->head = 0;
+    queue->len = 0;
+    InitializeCriticalSection(&queue->lock);
+    InitializeConditionVariable(&queue->ready);
+}
+
+/*
+ * Releases a queue no thread waits on any more
+ */
+void free_queue(PROBE_QUEUE *queue) {
+    free(queue->items);
+    DeleteCriticalSection(&queue->lock);
+}
+
+/*
+ * Adds the probe to the queue and wakes up one waiting thread
+ * Queues are sized so that they never fill up
+ */
+void queue_push(PROBE_QUEUE *queue, PROBE *probe) {
+    EnterCriticalSection(&queue->lock);
+    queue->items[(queue->head + queue->len) % queue->size] = probe;
+    queue->len++;
+    LeaveCriticalSection(&queue->lock);
+    WakeConditionVariable(&queue->ready);
+}
+
+/*
+ * Takes the oldest probe from the queue
+ * Waits up to ms milliseconds for one to arrive
+ * Returns NULL if the queue is still empty
+ */
+PROBE *queue_pop(PROBE_QUEUE *queue, DWORD ms) {
+    PROBE *probe = NULL;
+    EnterCriticalSection(&queue->lock);
+    if (!queue->len && ms) SleepConditionVariableCS(&queue->ready, &queue->lock, ms);
+    while (!queue->len && ms == INFINITE) {
+        SleepConditionVariableCS(&queue->ready, &queue->lock, ms);
+    }
+    if (queue->len) {
+        probe = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->size;
+        queue->len--;
+    }
+    LeaveCriticalSection(&queue->lock);
+    return probe;
+}
+
+/*
+ * Returns the IPv4 address in network order, 0 if ip is not one
+ */
+u_int log_ip(char *ip) {
+    u_long addr = inet_addr(ip);
+    return addr == INADDR_NONE ? 0 : (u_int) addr;
+}
+
+/*
+ * Appends every hop of the chain to the probe log
+ */
+void log_chain(ANALYSER **analysers, int jump) {
+    u_int chain = log_begin_chain(probe_log);
+    ULONGLONG now = (ULONGLONG) time(NULL);
+    
+    for (int i = 0; i <= jump; i++) {
+        ANALYSER *analyser = analysers[i];
+        const char *strings[LOG_STRINGS];
+        char host[URL_MAX];
+        HOP_RECORD record;
+        u_int k;
+        
+        // hosts are stored lower case so the index finds them in any case
+        for (k = 0; analyser->server->hostname[k] && k < URL_MAX - 1; k++) {
+            host[k] = tolower((unsigned char) analyser->server->hostname[k]);
+        }
+        host[k] = '\0';
+        
+        memset(&record, 0, sizeof(HOP_RECORD));
+        record.time = now;
+        record.chain = chain;
+        record.hop = (u_short) i;
+        record.code = (u_short) atoi(get_header(analyser->arcmap, HDR_CODE));
+        record.server_ip = log_ip(analyser->server->ip);
+        record.server_port = (u_short) analyser->server->port;
+        record.client_ip = log_ip(analyser->client->ip);
+        record.client_port = (u_short) analyser->client->port;
+        if (analyser->body.read) {
+            record.body_size = analyser->body.size;
+            record.body_hash = analyser->body.hash;
+        }
+        record.tcp = analyser->capture.tcp;
+        
+        strings[LS_HOST] = host;
+        strings[LS_PATH] = analyser->server->file;
+        strings[LS_MEANING] = get_header(analyser->arcmap, HDR_MEANING);
+        strings[LS_LOCATION] = get_header(analyser->arcmap, HDR_LOCATION);
+        strings[LS_DATE] = get_header(analyser->arcmap, HDR_DATE);
+        strings[LS_LAST_MODIFIED] = get_header(analyser->arcmap, HDR_LAST_MODIFIED);
+        strings[LS_ENCODING] = get_header(analyser->arcmap, HDR_CONTENT_ENCODING);
+        log_hop(probe_log, &record, strings);
+    }
+    log_flush(probe_log);
+}
+
+/*
+ * Appends the raw bytes and timing of every hop of the chain to the capture
+ * How the chain ended is kept in the flags of its last hop
+ */
+void capture_analysers(ANALYSER **analysers, int jump, int outcome) {
+    CAPTURE_RECORD *records = (CAPTURE_RECORD*) calloc(jump + 1, sizeof(CAPTURE_RECORD));
+    const char *(*fields)[CAPTURE_FIELDS] = calloc(jump + 1, sizeof(*fields));
+    char (*urls)[URL_MAX] = malloc((jump + 1) * URL_MAX);
+    ULONGLONG now = (ULONGLONG) time(NULL);
+    
+    for (int i = 0; i <= jump; i++) {
+        ANALYSER *analyser = analysers[i];
+        HOP_CAPTURE *capture = &analyser->capture;
+        CAPTURE_RECORD *record = &records[i];
+        
+        get_address_url(analyser->server, urls[i], URL_MAX);
+        record->time = now;
+        record->hop = (u_short) i;
+        record->flags = (u_short) capture->flags;
+        record->server_port = (u_short) analyser->server->port;
+        record->client_port = (u_short) analyser->client->port;
+        memcpy(record->times, capture->times, sizeof(record->times));
+        record->tcp = capture->tcp;
+        
+        fields[i][CF_URL] = urls[i];
+        fields[i][CF_SERVER_IP] = analyser->server->ip;
+        fields[i][CF_CLIENT_IP] = analyser->client->ip;
+        if (capture->flags & CAPTURE_FAILED) {
+            fields[i][CF_FAIL_CODE] = get_header(analyser->arcmap, HDR_CODE);
+            fields[i][CF_FAIL_REASON] = get_header(analyser->arcmap, HDR_MEANING);
+        }
+        fields[i][CF_REQUEST] = capture->request;
+        fields[i][CF_REPLY] = capture->reply;
+        for (int k = 0; k < CF_REQUEST; k++) {
+            record->lengths[k] = fields[i][k] ? strlen(fields[i][k]) : 0;
+        }
+        record->lengths[CF_REQUEST] = capture->request_len;
+        record->lengths[CF_REPLY] = capture->reply_len;
+    }
+    if (outcome == CHAIN_LOOP) records[jump].flags |= CAPTURE_LOOP;
+    if (outcome == CHAIN_TOO_LONG) records[jump].flags |= CAPTURE_TOO_LONG;
+    capture_chain(recording, records, fields, jump + 1);
+    free(urls);
+    free(fields);
+    free(records);
+}
+
+/*
+ * Writes the line that starts the results of a chain probed at the given time
+ */
+void probe_stamp(char *out, u_int size, time_t when) {
+    char stamp[30];
+    strftime(stamp, 30, "%a %b %d %H:%M:%S %Y", localtime(&when));
+    snprintf(out, size, "Probed at: %s\n\n", stamp);
+}
+
+/*
+ * Writes the results of a chain probed at the given time
+ * Invalid urls have no results
+ */
+void print_probe(FILE *out, time_t when, char *url, char *results) {
+    char stamp[100];
+    probe_stamp(stamp, 100, when);
+    fputs(stamp, out);
+    if (results) fputs(results, out);
+    else fprintf(out, INVALID_URL, url);
+}
+
+/*
+ * Tells how the first hop of a chain went for its host's limits
+ * Connection errors and 429 or 503 replies mean the host is overloaded
+ */
+void sample_host(ANALYSER **analysers, int jump, HOST_SAMPLE *sample) {
+    memset(sample, 0, sizeof(HOST_SAMPLE));
+    if (jump < 0) return;
+    
+    ANALYSER *first = analysers[0];
+    u_int *times = first->capture.times;
+    int code = atoi(get_header(first->arcmap, HDR_CODE));
+    char *meaning = get_header(first->arcmap, HDR_MEANING);
+    if (code == 429 || code == 503) sample->overloaded = TRUE;
+    else if (!code) {
+        // the host was reached but did not take or answer the request
+        sample->overloaded = strcmp(meaning, "Connection error") == 0 || 
+                strcmp(meaning, "send() failed") == 0 || strcmp(meaning, "recv() failed") == 0;
+    } else if (times[CT_FIRST_BYTE] > times[CT_RESOLVED]) {
+        sample->latency = times[CT_FIRST_BYTE] - times[CT_RESOLVED];
+    }
+}
+
+/*
+ * Adds the hops of a chain to the run summary
+ * A chain with no hops is a url that could not be parsed
+ */
+void tally_chain(ANALYSER **analysers, int jump, int outcome) {
+    char target[URL_MAX];
+    
+    for (int i = 0; i <= jump; i++) {
+        ARCMAP *map = analysers[i]->arcmap;
+        stats_hop(run_stats, atoi(get_header(map, HDR_CODE)), analysers[i]->server->hostname, 
+                get_header(map, HDR_SERVER), get_header(map, HDR_CONTENT_ENCODING));
+    }
+    if (jump >= 0) get_hop_key(analysers[jump]->server, target, URL_MAX);
+    stats_chain(run_stats, jump + 1, target, outcome == CHAIN_LOOP, outcome == CHAIN_TOO_LONG);
+}
+
+/*
+ * Probes the url in the mode, and adds the chain to the probe log,
+ * the capture and the run summary when they are kept
+ * sample is set to what the probe learnt about the url's host
+ * Returns the last hop of the chain, -1 if the url is invalid
+ */
+int probe_chain(HOP_CHAIN *chain, char *url, const HOP_MODE *mode, HOST_SAMPLE *sample) {
+    int jump = interact(chain, url, mode);
+    if (jump >= 0 && probe_log) log_chain(chain->analysers, jump);
+    if (jump >= 0 && recording) capture_analysers(chain->analysers, jump, chain->outcome);
+    if (run_stats) tally_chain(chain->analysers, jump, chain->outcome);
+    sample_host(chain->analysers, jump, sample);
+    return jump;
+}
+
+/*
+ * Probes a single url and queues its results for the pool writer
+ * Sharded results start with the list line of the url for merging
+ * sample is set to what the probe learnt about the url's host
+ */
+void probe_url(PROBE *probe, PROBE_POOL *pool, HOST_SAMPLE *sample) {
+    char *url = probe->url;
+    HOP_CHAIN chain;
+    int jump = probe_chain(&chain, url, &run_mode, sample);
+    ANALYSER **analysers = chain.analysers;
+    char *results = jump < 0 ? NULL : get_results(analysers, jump, chain.outcome);
+    
+    char head[100], invalid[URL_MAX + 100];
+    u_int len = shard_ring ? sprintf(head, "%s%u\n", SHARD_MARK, probe->line) : 0;
+    probe_stamp(head + len, 100 - len, time(NULL));
+    if (!results) snprintf(invalid, URL_MAX + 100, INVALID_URL, url);
+    writer_push(pool->results, head, results ? results : invalid);
+    
+    if (results) free(results);
+    free_analysers(analysers, jump);
+}
+
+/*
+ * Worker thread of the monitor and batch modes
+ * Probes due urls unless their host is over its limits,
+ * in which case the url is handed back to be deferred
+ * Stops when it receives a NULL probe
+ */
+DWORD WINAPI probe_worker(LPVOID param) {
+    PROBE_POOL *pool = (PROBE_POOL*) param;
+    PROBE *probe;
+    
+    while ((probe = queue_pop(&pool->todo, INFINITE)) != NULL) {
+        u_int wait;
+        if (host_acquire(pool->limiter, probe->limit, &wait)) {
+            HOST_SAMPLE sample;
+            budget_enter();
+            probe_url(probe, pool, &sample);
+            budget_leave();
+            host_release(pool->limiter, probe->limit, &sample);
+            probe->delay = 0;
+        } else {
+            probe->delay = wait / WHEEL_TICK_MS + 1;
+        }
+        queue_push(&pool->done, probe);
+    }
+    return 0;
+}
+
+/*
+ * Stops the workers and waits for them to exit
+ * The pool must outlive its workers, it usually lives on the caller's stack
+ */
+void stop_pool(PROBE_POOL *pool) {
+    for (u_int i = 0; i < pool->workers; i++) queue_push(&pool->todo, NULL);
+    for (u_int i = 0; i < pool->workers; i++) {
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+    }
+    free(pool->threads);
+    free_queue(&pool->todo);
+    free_queue(&pool->done);
+}
+
+/*
+ * Sets up the pool queues and starts the workers
+ * Returns FALSE if a worker can not be created, the ones
+ * already started are stopped again and the pool released
+ */
+BOOL start_pool(PROBE_POOL *pool, u_int size, u_int workers, 
+        RATE_LIMITER *limiter, RESULT_WRITER *results) {
+    init_queue(&pool->todo, size + workers);
+    init_queue(&pool->done, size);
+    pool->limiter = limiter;
+    pool->results = results;
+    pool->threads = (HANDLE*) malloc(sizeof(HANDLE) * workers);
+    pool->workers = 0;
+    pool->handed = 0;
+    
+    for (u_int i = 0; i < workers; i++) {
+        pool->threads[i] = CreateThread(NULL, 0, probe_worker, pool, 0, NULL);
+        if (!pool->threads[i]) {
+            printf("Could not create worker thread\n");
+            stop_pool(pool);
+            return FALSE;
+        }
+        pool->workers++;
+    }
+    return TRUE;
+}
+
+/*
+ * Prepares a probe for the given list entry
+ */
+void init_probe(PROBE *probe, URL_ENTRY *entry, TICK interval, RATE_LIMITER *limiter) {
+    char host[URL_MAX];
+    URL url;
+    
+    probe->url = entry->url;
+    probe->line = entry->line;
+    probe->interval = interval;
+    probe->delay = 0;
+    probe->limit = NULL;
+    if (url_parse_input(probe->url, strlen(probe->url), &url)) {
+        url_copy_part(url.host, host, URL_MAX);
+        probe->limit = find_host_limit(limiter, host);
+    }
+    init_timer(&probe->timer, probe);
+}
+
+/*
+ * Requests a host may receive back to back under the rate limit
+ */
+u_int limiter_burst(OPTIONS *options) {
+    if (options->adaptive) return ADAPT_START;
+    return options->host_max ? options->host_max : 1;
+}
+
+/*
+ * Checks whether the url belongs to the shard of this process
+ * Urls that do not parse all go to shard 0 so they are reported once
+ */
+BOOL url_in_shard(char *url) {
+    char host[URL_MAX];
+    URL parsed;
+    if (!shard_ring) return TRUE;
+    if (!url_parse_input(url, strlen(url), &parsed)) return shard_index == 0;
+    url_copy_part(parsed.host, host, URL_MAX);
+    return ring_shard(shard_ring, host) == shard_index;
+}
+
+/*
+ * Gives a probe to the workers
+ */
+void hand_probe(PROBE_POOL *pool, PROBE *probe) {
+    pool->handed++;
+    queue_push(&pool->todo, probe);
+}
+
+/*
+ * Takes a probed or deferred url back from the workers
+ * Returns NULL if none came back within wait milliseconds
+ */
+PROBE *take_probe(PROBE_POOL *pool, DWORD wait) {
+    PROBE *probe = queue_pop(&pool->done, wait);
+    if (probe) pool->handed--;
+    return probe;
+}
+
+/*
+ * Returns TRUE if another url may be given to the workers, FALSE if
+ * it would take the ones in progress over the memory budget
+ */
+BOOL admit_probe(PROBE_POOL *pool) {
+    return budget_admit(pool->handed);
+}
+
+/*
+ * Hands every probe whose time has come to the workers
+ * Probes the memory budget holds back are due again next tick
+ */
+void dispatch_due(TIMING_WHEEL *wheel, PROBE_POOL *pool) {
+    TIMER *timer = wheel_advance(wheel, current_tick());
+    while (timer) {
+        TIMER *next = timer->next;
+        if (admit_probe(pool)) hand_probe(pool, (PROBE*) timer->data);
+        else wheel_schedule(wheel, timer, wheel->now + 1);
+        timer = next;
+    }
+}
+
+/*
+ * Monitor (daemon) mode
+ * Every url is probed again after its own interval, with jitter
+ * so that urls sharing an interval do not all fire together
+ * The wheel is only touched by this thread, workers do the probing
+ * Runs until the process is killed
+ */
+void run_monitor(URL_LIST *urls, OPTIONS *options, RESULT_WRITER *results) {
+    u_int count = 0, size = 1024;
+    PROBE *probes = (PROBE*) malloc(sizeof(PROBE) * size);
+    URL_ENTRY entry;
+    
+    RATE_LIMITER *limiter = create_limiter(1 << 16, options->host_max, 
+            options->host_rps, limiter_burst(options), options->adaptive);
+    while (next_url(urls, &entry)) {
+        if (!url_in_shard(entry.url)) continue;
+        if (count == size) {
+            size *= 2;
+            probes = (PROBE*) realloc(probes, sizeof(PROBE) * size);
+        }
+        u_int seconds = entry.interval ? entry.interval : options->interval;
+        init_probe(&probes[count++], &entry, (TICK) seconds * 1000 / WHEEL_TICK_MS, 
+                limiter);
+    }
+    if (!count) {
+        printf("monitor list is empty\n");
+        free(probes);
+        free_limiter(limiter);
+        return;
+    }
+    
+    TIMING_WHEEL *wheel = create_wheel(current_tick());
+    PROBE_POOL pool;
+    
+    // spread the first round over each url's interval, at least a tick away
+    for (u_int i = 0; i < count; i++) {
+        wheel_schedule(wheel, &probes[i].timer, 
+                wheel->now + jitter_ticks(wheel, probes[i].interval / 2, 100));
+    }
+    if (!start_pool(&pool, count, options->workers, limiter, results)) {
+        free_wheel(wheel);
+        free(probes);
+        free_limiter(limiter);
+        return;
+    }
+    printf("Monitoring %u urls with %u workers\n", count, options->workers);
+    
+    ULONGLONG summary_at = GetTickCount64() + STATS_PERIOD_MS;
+    while (TRUE) {
+        dispatch_due(wheel, &pool);
+        if (GetTickCount64() >= summary_at) {
+            if (run_stats) write_stats(run_stats, options->stats_file);
+            if (options->memory_mb) print_budget();
+            summary_at += STATS_PERIOD_MS;
+        }
+        
+        // waiting on finished urls doubles as the tick sleep
+        PROBE *probe;
+        DWORD wait = WHEEL_TICK_MS;
+        while ((probe = take_probe(&pool, wait)) != NULL) {
+            TICK delay = probe->delay;
+            if (!delay) delay = jitter_ticks(wheel, probe->interval, options->jitter);
+            wheel_schedule(wheel, &probe->timer, wheel->now + delay);
+            wait = 0;
+        }
+    }
+}
+
+/*
+ * Batch mode
+ * Probes every url of the list once, starting as soon as
+ * the first chunk of the list is parsed
+ * Only a fixed number of urls are in flight at any time
+ * With a journal, urls finished by an earlier run are skipped
+ */
+void run_batch(URL_LIST *urls, OPTIONS *options, RESULT_WRITER *results, 
+        JOURNAL *journal) {
+    u_int slots = options->workers * 4;
+    PROBE *probes = (PROBE*) malloc(sizeof(PROBE) * slots);
+    PROBE **free_probes = (PROBE**) malloc(sizeof(PROBE*) * slots);
+    u_int free_count = slots, in_flight = 0, total = 0;
+    BOOL more = TRUE;
+    PROBE_POOL pool;
+    
+    RATE_LIMITER *limiter = create_limiter(1 << 16, options->host_max, 
+            options->host_rps, limiter_burst(options), options->adaptive);
+    TIMING_WHEEL *wheel = create_wheel(current_tick());
+    for (u_int i = 0; i < slots; i++) free_probes[i] = &probes[i];
+    if (!start_pool(&pool, slots, options->workers, limiter, results)) {
+        free_wheel(wheel);
+        free(probes);
+        free(free_probes);
+        free_limiter(limiter);
+        return;
+    }
+    
+    while (more || in_flight) {
+        URL_ENTRY entry;
+        while (more && free_count && admit_probe(&pool)) {
+            if (!next_url(urls, &entry)) {
+                more = FALSE;
+                break;
+            }
+            if (!url_in_shard(entry.url)) continue;
+            if (journal && journal_done(journal, entry.line)) continue;
+            PROBE *probe = free_probes[--free_count];
+            init_probe(probe, &entry, 0, limiter);
+            in_flight++;
+            total++;
+            hand_probe(&pool, probe);
+        }
+        dispatch_due(wheel, &pool);
+        
+        PROBE *probe;
+        DWORD wait = WHEEL_TICK_MS;
+        while ((probe = take_probe(&pool, wait)) != NULL) {
+            if (probe->delay) {
+                wheel_schedule(wheel, &probe->timer, wheel->now + probe->delay);
+            } else {
+                if (journal) journal_mark(journal, probe->line);
+                free_probes[free_count++] = probe;
+                in_flight--;
+            }
+            wait = 0;
+        }
+        if (journal) journal_tick(journal);
+    }
+    stop_pool(&pool);
+    printf("Probed %u urls\n", total);
+    free_wheel(wheel);
+    free(probes);
+    free(free_probes);
+    free_limiter(limiter);
+}
+
+/*
+ * Prints command line usage
+ */
+void print_usage(char *name) {
+    printf("Usage: %s [-d listfile [-i seconds] [-j percent] | -f listfile]\n", name);
+    printf("          [-o outfile] [-l logname] [-w workers] [-c max] [-r rps] [-g] [-z]\n");
+    printf("          [-A agent] [-H \"Name: value\"]... [-t tuning] [-s addresses]\n");
+    printf("          [-S k/n] [-p journal] [-R capture] [-m hops] [-T summary]\n");
+    printf("          [-x proxy] [-L port] [-M megabytes] [-2]\n");
+    printf("    -d listfile   monitor every url in listfile (url [seconds] per line)\n");
+    printf("    -i seconds    default probe interval, 300 if not given\n");
+    printf("    -j percent    random jitter applied to each interval, 10 if not given\n");
+    printf("    -f listfile   probe every url in listfile once\n");
+    printf("    -o outfile    append results to outfile instead of stdout\n");
+    printf("    -l logname    also append every hop to logname.log, .str and .idx\n");
+    printf("    -w workers    probes running in parallel, 4 if not given\n");
+    printf("    -c max        probes in flight per host, 2 if not given, 0 no cap\n");
+    printf("                  auto[:max] starts at %d and adapts to each host's latency\n",
+            ADAPT_START);
+    printf("                  and overload, up to max or %d\n", ADAPT_CEILING);
+    printf("    -r rps        requests per second per host, 1 if not given, 0 no limit\n");
+    printf("    -g            send GET instead of HEAD, report body size and hash\n");
+    printf("    -z            GET with Accept-Encoding, report compression of each body\n");
+    printf("    -A agent      User-Agent sent with every request\n");
+    printf("    -H header     extra header line sent with every request, may be repeated\n");
+    printf("    -t tuning     comma separated socket options: nodelay, fastopen,\n");
+    printf("                  quickclose (reset instead of TIME_WAIT), noport (share\n");
+    printf("                  local ports between destinations, with -s)\n");
+    printf("    -s addresses  comma separated local addresses probes are bound to in turn\n");
+    printf("    -S k/n        probe only the hosts of shard k (from 0) of n, see merge\n");
+    printf("    -p journal    with -f, record finished urls in journal and skip them\n");
+    printf("                  when the same run is started again\n");
+    printf("    -m hops       requests made for a url following redirects, %d if not given\n",
+            MAX_HOPS);
+    printf("    -R capture    append the raw request, reply and timing of every hop\n");
+    printf("                  to capture, see replay\n");
+    printf("    -T summary    write status code, chain length, Server, Content-Encoding\n");
+    printf("                  and distinct host tables of the run to summary, at the end\n");
+    printf("                  of -f and every %d seconds with -d\n", STATS_PERIOD_MS / 1000);
+    printf("    -x proxy      send every request through the http proxy at host[:port],\n");
+    printf("                  8080 if no port is given, over kept alive connections\n");
+    printf("    -L port       serve probe requests of local tools on 127.0.0.1:port,\n");
+    printf("                  one \"url [head|get|decode] [hops=N]\" per line, each answered\n");
+    printf("                  with one line of JSON, until a client sends shutdown\n");
+    printf("    -M megabytes  start no new url while replies, results and capture data\n");
+    printf("                  in memory are over the budget, and report their use\n");
+    printf("    -2            send HEAD requests over h2c (HTTP/2 without SSL) to origins\n");
+    printf("                  that have it, many at once on one connection per origin\n");
+    printf("       %s query logname [filters]   search a probe log, see query usage\n", name);
+    printf("       %s merge outfile shardfile...   merge -S results in list order\n", name);
+    printf("       %s replay capture [-o outfile] [-n rounds] [-T summary]   report\n", name);
+    printf("                  captured hops again without the network, n times, and time it\n");
+}
+
+/*
+ * Reads the command line into options
+ * Returns FALSE if it is not valid
+ */
+BOOL parse_options(int argc, char **argv, OPTIONS *options) {
+    memset(options, 0, sizeof(OPTIONS));
+    options->interval = 300;
+    options->jitter = 10;
+    options->workers = 4;
+    options->host_max = 2;
+    options->host_rps = 1;
+    options->max_hops = MAX_HOPS;
+    
+    for (int i = 1; i < argc; i++) {
+        BOOL value = i + 1 < argc;
+        if (strcmp(argv[i], "-d") == 0 && value) options->monitor_file = argv[++i];
+        else if (strcmp(argv[i], "-f") == 0 && value) options->batch_file = argv[++i];
+        else if (strcmp(argv[i], "-i") == 0 && value) options->interval = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-j") == 0 && value) options->jitter = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && value) options->output_file = argv[++i];
+        else if (strcmp(argv[i], "-l") == 0 && value) options->log_base = argv[++i];
+        else if (strcmp(argv[i], "-w") == 0 && value) options->workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0 && value) {
+            // auto or auto:max, the cap of each host follows its latency and errors
+            if (_strnicmp(argv[++i], "auto", 4) == 0) {
+                options->adaptive = TRUE;
+                options->host_max = argv[i][4] == ':' ? atoi(argv[i] + 5) : 0;
+            } else options->host_max = atoi(argv[i]);
+        }
+        else if (strcmp(argv[i], "-r") == 0 && value) options->host_rps = atof(argv[++i]);
+        else if (strcmp(argv[i], "-g") == 0) options->get = TRUE;
+        else if (strcmp(argv[i], "-z") == 0) options->get = options->decode = TRUE;
+        else if (strcmp(argv[i], "-A") == 0 && value) options->agent = argv[++i];
+        else if (strcmp(argv[i], "-t") == 0 && value) {
+            if (!parse_tuning(argv[++i], &options->tuning)) return FALSE;
+        }
+        else if (strcmp(argv[i], "-s") == 0 && value) {
+            if (!parse_sources(argv[++i], &options->tuning)) return FALSE;
+        }
+        else if (strcmp(argv[i], "-p") == 0 && value) options->journal_file = argv[++i];
+        else if (strcmp(argv[i], "-R") == 0 && value) options->capture_file = argv[++i];
+        else if (strcmp(argv[i], "-m") == 0 && value) options->max_hops = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-T") == 0 && value) options->stats_file = argv[++i];
+        else if (strcmp(argv[i], "-x") == 0 && value) options->proxy = argv[++i];
+        else if (strcmp(argv[i], "-L") == 0 && value) options->service_port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-2") == 0) options->h2c = TRUE;
+        else if (strcmp(argv[i], "-M") == 0 && value) {
+            options->memory_mb = atoi(argv[++i]);
+            if (!options->memory_mb) return FALSE;
+        }
+        else if (strcmp(argv[i], "-S") == 0 && value) {
+            if (sscanf(argv[++i], "%u/%u", &options->shard_index, &options->shard_count) != 2 ||
+                    options->shard_index >= options->shard_count) return FALSE;
+        }
+        else if (strcmp(argv[i], "-H") == 0 && value && options->header_count < MAX_HEADERS &&
+                strchr(argv[i + 1], ':')) options->headers[options->header_count++] = argv[++i];
+        else return FALSE;
+    }
+    if (options->monitor_file && options->batch_file) return FALSE;
+    if (options->journal_file && !options->batch_file) return FALSE;
+    if (options->h2c && options->proxy) return FALSE;
+    if (options->service_port && (options->monitor_file || options->batch_file || 
+            options->service_port > 0xffff)) return FALSE;
+    return options->interval && options->jitter <= 100 && 
+            options->workers && options->host_rps >= 0 && 
+            options->max_hops && options->max_hops <= 0xffff;
+}
+
+/*
+ * Builds the request template from the options
+ * The tunnel template opens CONNECT tunnels through the proxy, it
+ * carries the same headers but the Accept-Encoding
+ */
+REQUEST_TEMPLATE *build_template(OPTIONS *options, BOOL tunnel) {
+    char *headers[MAX_HEADERS + 2];
+    char agent[1024], encodings[200];
+    u_int count = 0;
+    
+    if (options->agent) {
+        snprintf(agent, 1024, "User-Agent: %s", options->agent);
+        headers[count++] = agent;
+    }
+    if (options->decode && accepted_encodings() && !tunnel) {
+        snprintf(encodings, 200, "Accept-Encoding: %s", accepted_encodings());
+        headers[count++] = encodings;
+    }
+    for (u_int i = 0; i < options->header_count; i++) {
+        headers[count++] = options->headers[i];
+    }
+    if (tunnel) return create_template("CONNECT", headers, count);
+    return create_template(options->get ? "GET" : "HEAD", headers, count);
+}
+
+/*
+ * Runs the monitor or batch mode given in options
+ */
+void run_list_mode(OPTIONS *options) {
+    char *list_file = options->monitor_file ? options->monitor_file : options->batch_file;
+    URL_LIST *urls = open_url_list(list_file);
+    FILE *out = options->output_file ? fopen(options->output_file, "a") : stdout;
+    
+    if (!urls || !out) {
+        if (!out) printf("unable to open output file: %s\n", options->output_file);
+        return;
+    }
+    RESULT_WRITER *results = start_writer(out);
+    if (!results) {
+        close_url_list(urls);
+        if (out != stdout) fclose(out);
+        return;
+    }
+    flights = create_flight_group(options->workers * 2, free_hop_result);
+    if (options->shard_count) {
+        shard_ring = create_ring(options->shard_count);
+        shard_index = options->shard_index;
+        printf("Shard %u of %u\n", shard_index, options->shard_count);
+    }
+    JOURNAL *journal = NULL;
+    if (options->journal_file) {
+        journal = open_journal(options->journal_file, urls->map.size, results);
+        if (!journal) {
+            stop_writer(results);
+            close_url_list(urls);
+            if (out != stdout) fclose(out);
+            return;
+        }
+        if (journal->resumed) printf("Resuming, %u urls already probed\n", journal->resumed);
+    }
+    if (options->monitor_file) run_monitor(urls, options, results);
+    else run_batch(urls, options, results, journal);
+    
+    if (journal) close_journal(journal);
+    stop_writer(results);
+    if (run_stats) write_stats(run_stats, options->stats_file);
+    if (options->memory_mb) print_budget();
+    if (shard_ring) free_ring(shard_ring);
+    if (out != stdout) fclose(out);
+}
+
+// Modes a service request may ask for
+enum {
+    SERVICE_HEAD,
+    SERVICE_GET,
+    SERVICE_DECODE,
+    SERVICE_MODES
+};
+
+HOP_MODE service_modes[SERVICE_MODES]; // templates of the service, built once
+int service_default = SERVICE_HEAD; // mode of requests that do not name one
+RATE_LIMITER *service_limiter = NULL; // politeness limits shared by all clients
+char *service_summary = NULL; // -T of the service, NULL if not kept
+volatile LONG service_busy = 0; // requests being probed
+ULONGLONG service_summary_at = 0; // when the summary is written next
+
+/*
+ * Appends the chain as one line of JSON: the url, how the chain ended
+ * and every hop with its reply, body and timings in microseconds
+ */
+void chain_json(TEXT_BUFFER *text, char *url, ANALYSER **analysers, int jump, int outcome) {
+    const char *outcomes[] = {"done", "loop", "too_long"};
+    const int headers[] = {HDR_MEANING, HDR_DATE, HDR_LAST_MODIFIED, HDR_CONTENT_ENCODING, 
+            HDR_LOCATION, HDR_SERVER};
+    const char *names[] = {"meaning", "date", "last_modified", "encoding", "location", 
+            "server"};
+    
+    text_append(text, "{\"url\":");
+    text_json_string(text, url);
+    text_append(text, ",\"outcome\":\"%s\",\"hops\":[", jump < 0 ? "invalid" : outcomes[outcome]);
+    for (int i = 0; i <= jump; i++) {
+        ANALYSER *analyser = analysers[i];
+        ARCMAP *map = analyser->arcmap;
+        u_int *times = analyser->capture.times;
+        char hop_url[URL_MAX];
+        
+        get_address_url(analyser->server, hop_url, URL_MAX);
+        text_append(text, "%s{\"url\":", i ? "," : "");
+        text_json_string(text, hop_url);
+        text_append(text, ",\"code\":%d,\"server_ip\":", atoi(get_header(map, HDR_CODE)));
+        text_json_string(text, analyser->server->ip);
+        text_append(text, ",\"server_port\":%d,\"client_ip\":", analyser->server->port);
+        text_json_string(text, analyser->client->port ? analyser->client->ip : NULL);
+        text_append(text, ",\"client_port\":%d", analyser->client->port);
+        for (int h = 0; h < 6; h++) {
+            text_append(text, ",\"%s\":", names[h]);
+            text_json_string(text, get_header(map, headers[h]));
+        }
+        BODY_INFO *body = &analyser->body;
+        if (body->read) {
+            text_append(text, ",\"body_size\":%llu,\"body_hash\":\"%016llx\"", 
+                    (unsigned long long) body->size, (unsigned long long) body->hash);
+        }
+        if (body->read && body->decoded && !body->decode_failed) {
+            text_append(text, ",\"decoded_size\":%llu", (unsigned long long) body->decoded_size);
+        }
+        text_append(text, ",\"times\":{\"resolved\":%u,\"connected\":%u,\"first_byte\":%u,"
+                "\"done\":%u}", times[CT_RESOLVED], times[CT_CONNECTED], 
+                times[CT_FIRST_BYTE], times[CT_DONE]);
+        TCP_STATS *tcp = &analyser->capture.tcp;
+        if (tcp->rtt) {
+            text_append(text, ",\"tcp\":{\"rtt\":%u,\"rtt_min\":%u,\"retransmits\":%u,"
+                    "\"cwnd\":%u}", tcp->rtt, tcp->rtt_min, tcp->retransmits, tcp->cwnd);
+        }
+        text_append(text, "}");
+    }
+    text_append(text, "]}\n");
+}
+
+/*
+ * Answers a service request: a url followed by any of head, get,
+ * decode and hops=N, separated by spaces
+ * The host's politeness limits are waited for, as the workers of
+ * the other modes do
+ * Returns the chain as one line of JSON, or an error object
+ */
+char *serve_probe(char *line) {
+    HOP_MODE mode = service_modes[service_default];
+    char *url = NULL, *word = line;
+    int hops = 0;
+    TEXT_BUFFER reply;
+    
+    text_init(&reply, 1024);
+    while (*word) {
+        char *end = strchr(word, ' ');
+        if (end) *end = '\0';
+        if (!*word);
+        else if (!url) url = word;
+        else if (strcmp(word, "head") == 0) mode = service_modes[SERVICE_HEAD];
+        else if (strcmp(word, "get") == 0) mode = service_modes[SERVICE_GET];
+        else if (strcmp(word, "decode") == 0) mode = service_modes[SERVICE_DECODE];
+        else if (strncmp(word, "hops=", 5) != 0 || (hops = atoi(word + 5)) <= 0 || 
+                hops > 0xffff) {
+            text_append(&reply, "{\"error\":\"unknown option\",\"option\":");
+            text_json_string(&reply, word);
+            text_append(&reply, "}\n");
+            return reply.data;
+        }
+        word = end ? end + 1 : word + strlen(word);
+    }
+    if (!url) {
+        text_append(&reply, "{\"error\":\"no url\"}\n");
+        return reply.data;
+    }
+    if (hops) mode.max_hops = hops;
+    
+    HOST_LIMIT *limit = NULL;
+    char host[URL_MAX];
+    URL parsed;
+    u_int wait;
+    if (url_parse_input(url, strlen(url), &parsed)) {
+        url_copy_part(parsed.host, host, URL_MAX);
+        limit = find_host_limit(service_limiter, host);
+    }
+    // over the memory budget requests wait for the others in progress,
+    // the slot is taken before asking so concurrent requests see each other
+    while (!budget_admit(InterlockedIncrement(&service_busy) - 1)) {
+        InterlockedDecrement(&service_busy);
+        Sleep(WHEEL_TICK_MS);
+    }
+    // adaptive hosts may suggest 0 ms, waiting a tick keeps this from spinning
+    while (!host_acquire(service_limiter, limit, &wait)) {
+        Sleep(wait > WHEEL_TICK_MS ? wait : WHEEL_TICK_MS);
+    }
+    budget_enter();
+    
+    HOP_CHAIN chain;
+    HOST_SAMPLE sample;
+    int jump = probe_chain(&chain, url, &mode, &sample);
+    host_release(service_limiter, limit, &sample);
+    chain_json(&reply, url, chain.analysers, jump, chain.outcome);
+    free_analysers(chain.analysers, jump);
+    budget_leave();
+    InterlockedDecrement(&service_busy);
+    return reply.data;
+}
+
+/*
+ * Rewrites the service's summary every STATS_PERIOD_MS
+ */
+void service_tick(void) {
+    if (!run_stats || GetTickCount64() < service_summary_at) return;
+    write_stats(run_stats, service_summary);
+    service_summary_at = GetTickCount64() + STATS_PERIOD_MS;
+}
+
+/*
+ * Service mode
+ * Answers probe requests of local tools on a loopback port until
+ * one of them asks for shutdown. All requests share the hops in
+ * flight, the proxy connections, the politeness limits, the probe
+ * log, the capture and the summary of this one process
+ */
+void run_service_mode(OPTIONS *options) {
+    OPTIONS variant = *options;
+    
+    for (int i = 0; i < SERVICE_MODES; i++) {
+        variant.get = i != SERVICE_HEAD;
+        variant.decode = i == SERVICE_DECODE;
+        service_modes[i].get = variant.get;
+        service_modes[i].decode = variant.decode;
+        service_modes[i].max_hops = options->max_hops;
+        service_modes[i].request = build_template(&variant, FALSE);
+    }
+    service_default = options->decode ? SERVICE_DECODE : options->get ? SERVICE_GET : 
+            SERVICE_HEAD;
+    service_limiter = create_limiter(1 << 16, options->host_max, options->host_rps, 
+            limiter_burst(options), options->adaptive);
+    flights = create_flight_group(SERVICE_CLIENTS_MAX * 2, free_hop_result);
+    service_summary = options->stats_file;
+    service_summary_at = GetTickCount64() + STATS_PERIOD_MS;
+    
+    run_service(options->service_port, serve_probe, service_tick);
+    
+    if (run_stats) write_stats(run_stats, service_summary);
+    if (options->memory_mb) print_budget();
+    for (int i = 0; i < SERVICE_MODES; i++) free_template(service_modes[i].request);
+}
+
+/*
+ * Reads a point in time for the query subcommand, either a local
+ * date YYYY-MM-DD[THH:MM[:SS]] or an age such as 30m, 12h or 7d
+ * Returns FALSE if it is neither
+ */
+BOOL parse_when(char *text, ULONGLONG *when) {
+    struct tm date;
+    u_int amount;
+    char unit, extra;
+    
+    memset(&date, 0, sizeof(struct tm));
+    if (sscanf(text, "%u%c%c", &amount, &unit, &extra) == 2 && text[0] != '-') {
+        u_int scale = unit == 's' ? 1 : unit == 'm' ? 60 : unit == 'h' ? 3600 : 
+                unit == 'd' ? 86400 : unit == 'w' ? 604800 : 0;
+        if (!scale) return FALSE;
+        *when = (ULONGLONG) time(NULL) - (ULONGLONG) amount * scale;
+        return TRUE;
+    }
+    int fields = sscanf(text, "%d-%d-%d%*c%d:%d:%d", &date.tm_year, &date.tm_mon, 
+            &date.tm_mday, &date.tm_hour, &date.tm_min, &date.tm_sec);
+    if (fields != 3 && fields < 5) return FALSE;
+    date.tm_year -= 1900;
+    date.tm_mon--;
+    date.tm_isdst = -1;
+    time_t local = mktime(&date);
+    if (local == (time_t) -1) return FALSE;
+    *when = (ULONGLONG) local;
+    return TRUE;
+}
+
+/*
+ * Reads a reply code filter, 301, 3xx or 300-399
+ * Failed hops are logged with code 0 and found with 0xx
+ * Returns FALSE if it is not valid
+ */
+BOOL parse_codes(char *text, HISTORY_QUERY *query) {
+    char extra;
+    if (strlen(text) == 3 && text[1] == 'x' && text[2] == 'x' && isdigit(text[0])) {
+        query->code_min = (text[0] - '0') * 100;
+        query->code_max = query->code_min + 99;
+        return TRUE;
+    }
+    if (sscanf(text, "%u-%u%c", &query->code_min, &query->code_max, &extra) == 2) {
+        return query->code_min <= query->code_max;
+    }
+    if (sscanf(text, "%u%c", &query->code_min, &extra) == 1) {
+        query->code_max = query->code_min ? query->code_min : 99;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Rebuilds the analyser of a logged hop so it can be
+ * printed with get_results()
+ */
+ANALYSER *analyser_from_record(PROBE_HISTORY *history, const HOP_RECORD *record) {
+    ANALYSER *analyser = (ANALYSER*) calloc(1, sizeof(ANALYSER));
+    const char *path = history_string(history, record->strings[LS_PATH]);
+    const char *host = history_string(history, record->strings[LS_HOST]);
+    const int ids[LOG_STRINGS] = {HDR_UNKNOWN, HDR_UNKNOWN, HDR_MEANING, HDR_LOCATION, 
+            HDR_DATE, HDR_LAST_MODIFIED, HDR_CONTENT_ENCODING};
+    struct in_addr addr;
+    char code[8];
+    
+    analyser->server = (ADDRESS*) calloc(1, sizeof(ADDRESS));
+    analyser->server->hostname = strdup(host ? host : "");
+    analyser->server->file = strdup(path ? path : "/");
+    addr.s_addr = record->server_ip;
+    strcpy(analyser->server->ip, inet_ntoa(addr));
+    analyser->server->port = record->server_port;
+    
+    analyser->client = (ADDRESS*) calloc(1, sizeof(ADDRESS));
+    addr.s_addr = record->client_ip;
+    if (record->client_ip) strcpy(analyser->client->ip, inet_ntoa(addr));
+    else strcpy(analyser->client->ip, "Did not connected to socket");
+    analyser->client->port = record->client_port;
+    analyser->body.read = record->body_hash != 0;
+    analyser->body.size = record->body_size;
+    analyser->body.hash = record->body_hash;
+    analyser->capture.tcp = record->tcp;
+    
+    analyser->arcmap = get_blank_map(1);
+    snprintf(code, 8, "%03u", record->code);
+    put_header(analyser->arcmap, HDR_CODE, code);
+    for (int i = LS_MEANING; i < LOG_STRINGS; i++) {
+        const char *value = history_string(history, record->strings[i]);
+        if (value) put_header(analyser->arcmap, ids[i], (char*) value);
+    }
+    return analyser;
+}
+
+/*
+ * Writes a logged hop as one line of JSON
+ */
+void print_json_record(FILE *out, PROBE_HISTORY *history, const HOP_RECORD *record) {
+    const char *names[LOG_STRINGS] = {"host", "path", "meaning", "location", "date", 
+            "last_modified", "encoding"};
+    struct in_addr addr;
+    TEXT_BUFFER line;
+    
+    text_init(&line, 512);
+    text_append(&line, "{\"time\":%llu,\"chain\":%u,\"hop\":%u,\"code\":%u", 
+            (unsigned long long) record->time, record->chain, record->hop, record->code);
+    addr.s_addr = record->server_ip;
+    text_append(&line, ",\"server_ip\":\"%s\",\"server_port\":%u", inet_ntoa(addr), 
+            record->server_port);
+    addr.s_addr = record->client_ip;
+    text_append(&line, ",\"client_ip\":\"%s\",\"client_port\":%u", inet_ntoa(addr), 
+            record->client_port);
+    if (record->body_hash) {
+        text_append(&line, ",\"body_size\":%llu,\"body_hash\":\"%016llx\"", 
+                (unsigned long long) record->body_size, 
+                (unsigned long long) record->body_hash);
+    }
+    if (record->tcp.rtt) {
+        text_append(&line, 
+                ",\"tcp\":{\"rtt\":%u,\"rtt_min\":%u,\"retransmits\":%u,\"cwnd\":%u}", 
+                record->tcp.rtt, record->tcp.rtt_min, record->tcp.retransmits, 
+                record->tcp.cwnd);
+    }
+    for (int i = 0; i < LOG_STRINGS; i++) {
+        text_append(&line, ",\"%s\":", names[i]);
+        text_json_string(&line, history_string(history, record->strings[i]));
+    }
+    text_append(&line, "}\n");
+    fputs(line.data, out);
+    free(line.data);
+}
+
+/*
+ * Prints query subcommand usage
+ */
+void print_query_usage(char *name) {
+    printf("Usage: %s query logname [-h host] [-s codes] [-L location]\n", name);
+    printf("          [-a since] [-b before] [-J]\n");
+    printf("    -h host       hops to host only, found through the index\n");
+    printf("    -s codes      reply codes, 301, 3xx or 300-399, failed hops are 0xx\n");
+    printf("    -L location   hops redirecting to exactly this url\n");
+    printf("    -a since      hops at or after since, YYYY-MM-DD[THH:MM[:SS]] or an age\n");
+    printf("                  such as 30m, 12h, 7d\n");
+    printf("    -b before     hops before, same forms as since\n");
+    printf("    -J            one JSON object per line instead of the results format\n");
+}
+
+/*
+ * Query subcommand
+ * Prints every logged hop matching the filters, oldest first
+ * Returns the process exit code
+ */
+int run_query(int argc, char **argv) {
+    HISTORY_QUERY query;
+    BOOL json = FALSE;
+    
+    memset(&query, 0, sizeof(HISTORY_QUERY));
+    if (argc < 3) {
+        print_query_usage(argv[0]);
+        return 1;
+    }
+    for (int i = 3; i < argc; i++) {
+        BOOL value = i + 1 < argc, ok = TRUE;
+        if (strcmp(argv[i], "-h") == 0 && value) query.host = argv[++i];
+        else if (strcmp(argv[i], "-s") == 0 && value) ok = parse_codes(argv[++i], &query);
+        else if (strcmp(argv[i], "-L") == 0 && value) query.location = argv[++i];
+        else if (strcmp(argv[i], "-a") == 0 && value) ok = parse_when(argv[++i], &query.since);
+        else if (strcmp(argv[i], "-b") == 0 && value) ok = parse_when(argv[++i], &query.until);
+        else if (strcmp(argv[i], "-J") == 0) json = TRUE;
+        else ok = FALSE;
+        if (!ok) {
+            print_query_usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    PROBE_HISTORY *history = open_history(argv[2]);
+    if (!history) return 1;
+    
+    const HOP_RECORD *record;
+    u_int matches = 0;
+    history_query(history, &query);
+    while ((record = history_next(history, &query)) != NULL) {
+        matches++;
+        if (json) {
+            print_json_record(stdout, history, record);
+            continue;
+        }
+        ANALYSER **analysers = (ANALYSER**) malloc(sizeof(ANALYSER*));
+        analysers[0] = analyser_from_record(history, record);
+        char *results = get_results(analysers, 0, CHAIN_DONE);
+        time_t when = (time_t) record->time;
+        char stamp[30];
+        strftime(stamp, 30, "%a %b %d %H:%M:%S %Y", localtime(&when));
+        printf("Probed at: %s (chain %u, hop %u)\n\n%s", stamp, record->chain, 
+                record->hop, results);
+        free(results);
+        free_analysers(analysers, 0);
+    }
+    if (!json) printf("%u matching hops\n", matches);
+    close_history(history);
+    return 0;
+}
+
+/*
+ * Rebuilds the analyser of a captured hop
+ * The reply bytes go through read_reply() and populate_analyser()
+ * just as they did when they came off the socket
+ * Returns NULL if the captured url is not valid
+ */
+ANALYSER *analyser_from_capture(const CAPTURE_RECORD *record, 
+        const char *fields[CAPTURE_FIELDS]) {
+    ANALYSER *analyser = (ANALYSER*) calloc(1, sizeof(ANALYSER));
+    HOP_RESULT result;
+    
+    analyser->server = get_host_ip_from((char*) fields[CF_URL]);
+    if (!analyser->server) {
+        free(analyser);
+        return NULL;
+    }
+    memset(&result, 0, sizeof(HOP_RESULT));
+    snprintf(result.server_ip, 100, "%s", fields[CF_SERVER_IP]);
+    result.server_port = record->server_port;
+    snprintf(result.client_ip, 100, "%s", fields[CF_CLIENT_IP]);
+    result.client_port = record->client_port;
+    result.capture.tcp = record->tcp;
+    
+    if (record->flags & CAPTURE_FAILED) {
+        result.fail_code = (char*) fields[CF_FAIL_CODE];
+        result.fail_reason = (char*) fields[CF_FAIL_REASON];
+    } else {
+        HTTP_REPLY reply;
+        REPLY_SOURCE source;
+        bytes_source(&source, fields[CF_REPLY], record->lengths[CF_REPLY]);
+        if (read_reply(&source, record->flags & CAPTURE_GET, 
+                record->flags & CAPTURE_DECODE, &reply)) {
+            result.response = reply.head;
+            result.body = reply.body;
+        } else {
+            result.fail_code = "000";
+            result.fail_reason = "recv() failed";
+        }
+    }
+    apply_hop_result(analyser, &result);
+    if (result.response) free(result.response);
+    return analyser;
+}
+
+/*
+ * Replay subcommand
+ * Runs every captured chain through the reply parser and the report
+ * as fast as it can, rounds times over, then prints the throughput
+ * Results carry the time the chain was recorded, so replays of
+ * the same capture give the same output
+ * Returns the process exit code
+ */
+int run_replay(int argc, char **argv) {
+    CAPTURE_READER reader;
+    char *output = NULL, *summary = NULL;
+    int rounds = 1;
+    
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    for (int i = 3; i < argc; i++) {
+        BOOL value = i + 1 < argc, ok = TRUE;
+        if (strcmp(argv[i], "-o") == 0 && value) output = argv[++i];
+        else if (strcmp(argv[i], "-n") == 0 && value) ok = (rounds = atoi(argv[++i])) > 0;
+        else if (strcmp(argv[i], "-T") == 0 && value) summary = argv[++i];
+        else ok = FALSE;
+        if (!ok) {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!open_replay(argv[2], &reader)) return 1;
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        printf("unable to open output file: %s\n", output);
+        close_replay(&reader);
+        return 1;
+    }
+    if (summary) run_stats = create_stats();
+    
+    ULONGLONG chains = 0, hops = 0, bytes = 0, live = 0;
+    LARGE_INTEGER start, end, frequency;
+    QueryPerformanceCounter(&start);
+    for (int round = 0; round < rounds; round++) {
+        const char *fields[CAPTURE_FIELDS];
+        const CAPTURE_RECORD *record;
+        
+        replay_rewind(&reader);
+        record = replay_next(&reader, fields);
+        while (record) {
+            u_int chain = record->chain, size = 10;
+            ANALYSER **analysers = (ANALYSER**) malloc(sizeof(ANALYSER*) * size);
+            time_t when = (time_t) record->time;
+            char url[URL_MAX];
+            int jump = -1, outcome = CHAIN_DONE;
+            
+            snprintf(url, URL_MAX, "%s", fields[CF_URL]);
+            do {
+                if (record->flags & CAPTURE_LOOP) outcome = CHAIN_LOOP;
+                if (record->flags & CAPTURE_TOO_LONG) outcome = CHAIN_TOO_LONG;
+                ANALYSER *analyser = analyser_from_capture(record, fields);
+                if (analyser) {
+                    if (jump + 1 == (int) size) {
+                        size *= 2;
+                        analysers = (ANALYSER**) realloc(analysers, sizeof(ANALYSER*) * size);
+                    }
+                    analysers[++jump] = analyser;
+                }
+                hops++;
+                bytes += record->lengths[CF_REPLY];
+                live += record->times[CT_DONE];
+                record = replay_next(&reader, fields);
+            } while (record && record->chain == chain);
+            
+            char *results = jump < 0 ? NULL : get_results(analysers, jump, outcome);
+            print_probe(out, when, url, results);
+            if (run_stats && !round) tally_chain(analysers, jump, outcome);
+            if (results) free(results);
+            free_analysers(analysers, jump);
+            chains++;
+        }
+    }
+    QueryPerformanceCounter(&end);
+    QueryPerformanceFrequency(&frequency);
+    
+    double seconds = (double) (end.QuadPart - start.QuadPart) / frequency.QuadPart;
+    if (seconds <= 0) seconds = 1e-9;
+    printf("Replayed %llu chains, %llu hops, %llu reply bytes in %.3f s\n",
+            (unsigned long long) chains, (unsigned long long) hops, 
+            (unsigned long long) bytes, seconds);
+    printf("%.0f hops/s, %.1f MB/s, %.3f s when recorded\n", hops / seconds, 
+            bytes / seconds / 1000000.0, live / 1000000.0);
+    if (run_stats) {
+        write_stats(run_stats, summary);
+        free_stats(run_stats);
+    }
+    if (out != stdout) fclose(out);
+    close_replay(&reader);
+    return 0;
+}
+
+/*
+ * Main loop
+ */
+int main(int argc, char **argv) {
+    OPTIONS options;
+    if (argc > 1 && strcmp(argv[1], "query") == 0) return run_query(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "merge") == 0) {
+        if (argc < 4) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        return merge_shards(argv[2], &argv[3], argc - 3) ? 0 : 1;
+    }
+    if (argc > 1 && strcmp(argv[1], "replay") == 0) return run_replay(argc, argv);
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    printf("COMS3200 - Assignment I - HTTP Protocol Analyser\n");
+    printf("by Arda 'Arc' Akgur\n\n\n");
+   
+    WSADATA wsa;
+    initialise_winsock(&wsa);
+    run_mode.get = options.get;
+    run_mode.decode = options.decode;
+    run_mode.max_hops = options.max_hops;
+    if (run_mode.decode && !accepted_encodings()) {
+        printf("Built without decoders, bodies will only be checked for compression\n");
+    }
+    run_mode.request = build_template(&options, FALSE);
+    tuning = options.tuning;
+    set_budget((LONGLONG) options.memory_mb << 20);
+    
+    if (options.log_base && !(probe_log = open_probe_log(options.log_base))) goto Cleanup;
+    if (options.capture_file && !(recording = open_capture(options.capture_file))) goto Cleanup;
+    if (options.stats_file && !(run_stats = create_stats())) goto Cleanup;
+    if (options.proxy) {
+        if (!(proxy = create_proxy(options.proxy))) goto Cleanup;
+        tunnel_template = build_template(&options, TRUE);
+    }
+    if (options.h2c) h2_pool = create_h2_pool(&tuning);
+    if (!proxy) warm_pool = create_warm_pool(&tuning, resolve_host);
+    
+    if (options.monitor_file || options.batch_file) {
+        run_list_mode(&options);
+        goto Cleanup;
+    }
+    if (options.service_port) {
+        run_service_mode(&options);
+        goto Cleanup;
+    }
+    
+    while (TRUE) {
+        HOP_CHAIN chain;
+        int jump = interact(&chain, NULL, &run_mode);
+        ANALYSER **analysers = chain.analysers;
+        char *results = get_results(analysers, jump, chain.outcome);
+        if (results && probe_log) log_chain(analysers, jump);
+        if (results && recording) capture_analysers(analysers, jump, chain.outcome);
+        
+        if (!results) {
+            printf("Something went wrong, can not display results\n");
+            free_analysers(analysers, jump);
+            goto Cleanup;
+        }
+        
+        char *response = (char*) malloc(sizeof(char) * 124);
+        BOOL done = FALSE;
+        while (!done) {
+            printf("Enter q/Q for quit..");
+            printf("p/P for print results..");
+            printf("s/S for save results to a file.\n");              
+            printf("Please enter response key to continue: ");
+            
+        
+            if (!fgets(response, 120, stdin)) {
+                puts("End of input from user");
+                goto Cleanup;
+            }
+            if (response[0] == '\n') continue;
+            
+            else if (response[0] == 'q' || response[0] == 'Q') {
+                free(results);
+                free_analysers(analysers, jump);
+                goto Cleanup;
+            } 
+            
+            else if (response[0] == 'p' || response[0] == 'P') {
+                puts("Printing results:\n");
+                puts(results);
+                done = TRUE;
+            }
+            
+            else if (response[0] == 's' || response[0] == 'S') {
+                save_results(results);
+                done = TRUE;
+            } 
+            
+            else {
+                printf("Unrecognized input: %s", response);
+                continue;
+            }
+        }
+        while (TRUE) {
+            printf("Want to run the program again? Y/N ");
+            if (!fgets(response, 100, stdin)) {
+                puts("End of input from user");
+                goto Cleanup;
+            }
+            if (response[0] == '\n') continue;
+            
+            if (response[0] == 'Y' || response[0] == 'y') {
+                free_analysers(analysers, jump);
+                free(response);
+                break;
+                
+            } else if (response[0] == 'N' || response[0] == 'n') {
+                printf("attempts to free analyzers..");
+                free_analysers(analysers, jump);
+                puts("done");
+                printf("attempts to free response..");
+                free(response);
+                puts("done");
+                goto Cleanup;
+            } else {
+                printf("Unrecognized input: %s", response);
+                continue;
+            }
+        }
+        
+    }
+    
+    Cleanup:
+        if (probe_log) close_probe_log(probe_log);
+        if (recording) close_capture(recording);
+        if (run_stats) free_stats(run_stats);
+        if (proxy) free_proxy(proxy);
+        if (h2_pool) free_h2_pool(h2_pool);
+        if (warm_pool) free_warm_pool(warm_pool);
+        if (tunnel_template) free_template(tunnel_template);
+        if (run_mode.request) free_template(run_mode.request);
+        puts("Unloading Winsock library..");
+        WSACleanup();
+        puts("Thank you for using Arc's HTTP protocol analyzer");
+        
+    return (EXIT_SUCCESS);
+}
+
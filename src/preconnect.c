@@ -0,0 +1,211 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "preconnect.h"
+
+/*
+ * Closes and frees an entry
+ */
+static void drop_entry(WARM_ENTRY *entry) {
+    if (entry->s != INVALID_SOCKET) closesocket(entry->s);
+    free(entry->host);
+    free(entry);
+}
+
+/*
+ * Takes the entry at index out of the pool, the pool's lock must be held
+ */
+static WARM_ENTRY *remove_entry(WARM_POOL *pool, u_int index) {
+    WARM_ENTRY *entry = pool->entries[index];
+    pool->entries[index] = pool->entries[--pool->count];
+    return entry;
+}
+
+/*
+ * Finds an entry for host:port, a finished one if there is any
+ * The pool's lock must be held
+ * Returns its index, -1 if there is none
+ */
+static int find_entry(WARM_POOL *pool, const char *host, int port) {
+    int found = -1;
+    for (u_int i = 0; i < pool->count; i++) {
+        WARM_ENTRY *entry = pool->entries[i];
+        if (entry->port != port || _stricmp(entry->host, host) != 0) continue;
+        if (entry->state != WARM_PENDING) return i;
+        found = i;
+    }
+    return found;
+}
+
+/*
+ * Closes the finished entries no hop took in time, a redirect that
+ * was not followed or went to another worker's hop
+ * The pool's lock must be held
+ */
+static void sweep(WARM_POOL *pool) {
+    ULONGLONG now = GetTickCount64();
+    for (u_int i = 0; i < pool->count; i++) {
+        WARM_ENTRY *entry = pool->entries[i];
+        if (entry->state != WARM_PENDING && now - entry->since > PRECONNECT_IDLE_MS) {
+            drop_entry(remove_entry(pool, i--));
+        }
+    }
+}
+
+/*
+ * Thread of one speculation, resolves the host and connects to it
+ * The entry is not touched once it is marked finished, a hop may
+ * take and free it from then on
+ */
+static DWORD WINAPI warm_thread(LPVOID param) {
+    WARM_ENTRY *entry = (WARM_ENTRY*) param;
+    WARM_POOL *pool = entry->pool;
+    SOCKET s = INVALID_SOCKET;
+    int state = WARM_FAILED;
+    char ip[100];
+    
+    if (pool->resolve(entry->host, ip)) {
+        state = WARM_RESOLVED;
+        if (entry->connect) s = socket(AF_INET, SOCK_STREAM, 0);
+    }
+    if (s != INVALID_SOCKET) {
+        struct sockaddr_in server;
+        memset(&server, 0, sizeof(server));
+        server.sin_family = AF_INET;
+        server.sin_addr.s_addr = inet_addr(ip);
+        server.sin_port = htons(entry->port);
+        // a failed connect is left to the hop, which reports it as usual
+        if (tune_socket(s, pool->tuning) && 
+                connect(s, (struct sockaddr*) &server, sizeof(server)) == 0) {
+            state = WARM_CONNECTED;
+        } else {
+            closesocket(s);
+            s = INVALID_SOCKET;
+        }
+    }
+    
+    EnterCriticalSection(&pool->lock);
+    if (state != WARM_FAILED) strcpy(entry->ip, ip);
+    entry->s = s;
+    entry->state = state;
+    entry->since = GetTickCount64();
+    pool->pending--;
+    WakeAllConditionVariable(&pool->changed);
+    LeaveCriticalSection(&pool->lock);
+    return 0;
+}
+
+/*
+ * Starts the pool, resolve is called from its threads
+ */
+WARM_POOL *create_warm_pool(SOCKET_TUNING *tuning, WARM_RESOLVER resolve) {
+    WARM_POOL *pool = (WARM_POOL*) calloc(1, sizeof(WARM_POOL));
+    pool->tuning = tuning;
+    pool->resolve = resolve;
+    InitializeCriticalSection(&pool->lock);
+    InitializeConditionVariable(&pool->changed);
+    return pool;
+}
+
+/*
+ * Starts resolving host and, if connect is set, connecting to it on
+ * port in the background
+ * A host may have several, one for each hop redirected to it, any
+ * hop to the host takes the first one ready
+ * Nothing is started if the pool is full
+ */
+void preconnect(WARM_POOL *pool, const char *host, int port, BOOL connect) {
+    EnterCriticalSection(&pool->lock);
+    sweep(pool);
+    if (pool->count == PRECONNECT_MAX) {
+        LeaveCriticalSection(&pool->lock);
+        return;
+    }
+    WARM_ENTRY *entry = (WARM_ENTRY*) calloc(1, sizeof(WARM_ENTRY));
+    entry->host = strdup(host);
+    entry->port = port;
+    entry->connect = connect;
+    entry->state = WARM_PENDING;
+    entry->s = INVALID_SOCKET;
+    entry->pool = pool;
+    // the thread waits for the lock before it can finish
+    HANDLE thread = CreateThread(NULL, 0, warm_thread, entry, 0, NULL);
+    if (!thread) {
+        drop_entry(entry);
+        LeaveCriticalSection(&pool->lock);
+        return;
+    }
+    CloseHandle(thread);
+    pool->entries[pool->count++] = entry;
+    pool->pending++;
+    LeaveCriticalSection(&pool->lock);
+    InterlockedIncrement(&pool->started);
+}
+
+/*
+ * Takes the speculation for host:port, waiting for it if it is still
+ * running, a hop started before it finished has nothing to gain
+ * from starting over
+ * ip is set unless the host could not be resolved, s is the
+ * connection if one was made and INVALID_SOCKET otherwise
+ * Returns how far the speculation got, WARM_NONE if there was none
+ */
+int take_preconnect(WARM_POOL *pool, const char *host, int port, char *ip, SOCKET *s) {
+    WARM_ENTRY *entry = NULL;
+    int index;
+    
+    *s = INVALID_SOCKET;
+    EnterCriticalSection(&pool->lock);
+    while ((index = find_entry(pool, host, port)) >= 0 && 
+            pool->entries[index]->state == WARM_PENDING) {
+        SleepConditionVariableCS(&pool->changed, &pool->lock, INFINITE);
+    }
+    if (index >= 0) entry = remove_entry(pool, index);
+    LeaveCriticalSection(&pool->lock);
+    
+    if (!entry) return WARM_NONE;
+    int state = entry->state;
+    if (state != WARM_FAILED) strcpy(ip, entry->ip);
+    *s = entry->s;
+    entry->s = INVALID_SOCKET;
+    drop_entry(entry);
+    InterlockedIncrement(&pool->taken);
+    return state;
+}
+
+/*
+ * Waits for the running speculations, closes what was not taken and
+ * frees the pool
+ */
+void free_warm_pool(WARM_POOL *pool) {
+    printf("Redirect targets prepared ahead: %ld, taken by the next hop: %ld\n", 
+            pool->started, pool->taken);
+    EnterCriticalSection(&pool->lock);
+    while (pool->pending) SleepConditionVariableCS(&pool->changed, &pool->lock, INFINITE);
+    while (pool->count) drop_entry(remove_entry(pool, 0));
+    LeaveCriticalSection(&pool->lock);
+    DeleteCriticalSection(&pool->lock);
+    free(pool);
+}
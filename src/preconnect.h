@@ -0,0 +1,97 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   preconnect.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Speculative resolving and connecting to redirect targets
+ * A hop whose reply carries a Location starts the next hop's lookup
+ * and TCP handshake in the background while its own reply is still
+ * read, the next hop then takes the address and the connection
+ * instead of waiting for both
+ * 
+ * Created on October 27, 2026, 3:00 PM
+ */
+
+#ifndef PRECONNECT_H
+#define PRECONNECT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+#include "sockopt.h"
+
+#define PRECONNECT_MAX 64 // speculations waiting to be taken at once
+#define PRECONNECT_IDLE_MS 5000 // ones not taken by then are closed
+
+// How far a speculation got
+enum {
+    WARM_NONE, // none was started for the host
+    WARM_PENDING, // still resolving or connecting
+    WARM_RESOLVED, // address found, no connection asked for or made
+    WARM_CONNECTED, // address found and connected
+    WARM_FAILED // the host could not be resolved
+};
+
+// Resolves host into a dotted address, ip holds 100 bytes
+typedef BOOL (*WARM_RESOLVER)(const char *host, char *ip);
+
+// Lookup and connection started for a host:port
+typedef struct {
+    char *host;
+    int port;
+    BOOL connect; // FALSE to resolve only
+    int state;
+    char ip[100];
+    SOCKET s; // INVALID_SOCKET unless WARM_CONNECTED
+    ULONGLONG since; // GetTickCount64() when it finished
+    struct WARM_POOL *pool;
+}WARM_ENTRY;
+
+// Speculations of a run, shared by all workers
+typedef struct WARM_POOL {
+    WARM_ENTRY *entries[PRECONNECT_MAX];
+    u_int count;
+    u_int pending; // entries whose thread is still running
+    SOCKET_TUNING *tuning;
+    WARM_RESOLVER resolve;
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE changed; // an entry finished
+    volatile LONG started; // speculations started
+    volatile LONG taken; // speculations a hop took
+}WARM_POOL;
+
+WARM_POOL *create_warm_pool(SOCKET_TUNING *tuning, WARM_RESOLVER resolve);
+void preconnect(WARM_POOL *pool, const char *host, int port, BOOL connect);
+int take_preconnect(WARM_POOL *pool, const char *host, int port, char *ip, SOCKET *s);
+void free_warm_pool(WARM_POOL *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PRECONNECT_H */
@@ -0,0 +1,488 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "probelog.h"
+
+/*
+ * Builds the file name of one of the log files
+ */
+static void file_name(char *out, u_int size, const char *base, const char *ext) {
+    snprintf(out, size, "%s.%s", base, ext);
+}
+
+/*
+ * Checks the header at the start of a mapped file
+ */
+static BOOL valid_header(MAPPED_FILE *map, const char *magic, u_int record_size) {
+    const LOG_HEADER *header = (const LOG_HEADER*) map->data;
+    return map->size >= sizeof(LOG_HEADER) && memcmp(header->magic, magic, 8) == 0 &&
+            header->record_size == record_size;
+}
+
+/*
+ * Opens the file for appending and writes its header if it is new
+ * A record torn by a crash is cut off so appends stay aligned
+ * last is set to the last whole record, if there is one
+ * Returns NULL if the file can not be opened or is not ours
+ */
+static FILE *open_append(const char *name, const char *magic, u_int record_size,
+        ULONGLONG *size, char *last) {
+    MAPPED_FILE map;
+    *size = 0;
+    if (map_file(name, &map)) {
+        ULONGLONG found = map.size;
+        *size = map.size;
+        if (map.size && !valid_header(&map, magic, record_size)) {
+            printf("not a probe log file: %s\n", name);
+            unmap_file(&map);
+            return NULL;
+        }
+        if (record_size && map.size) {
+            ULONGLONG whole = (map.size - sizeof(LOG_HEADER)) / record_size;
+            if (whole) {
+                memcpy(last, map.data + sizeof(LOG_HEADER) + (whole - 1) * record_size, 
+                        record_size);
+            }
+            *size = sizeof(LOG_HEADER) + whole * record_size;
+        }
+        unmap_file(&map);
+        if (*size != found && !truncate_file(name, *size)) {
+            printf("unable to repair probe log file: %s\n", name);
+            return NULL;
+        }
+    }
+    
+    FILE *file = fopen(name, "ab");
+    if (!file) {
+        printf("unable to open probe log file: %s\n", name);
+        return NULL;
+    }
+    if (!*size) {
+        LOG_HEADER header;
+        memset(&header, 0, sizeof(LOG_HEADER));
+        memcpy(header.magic, magic, 8);
+        header.version = 1;
+        header.record_size = record_size;
+        fwrite(&header, sizeof(LOG_HEADER), 1, file);
+        *size = sizeof(LOG_HEADER);
+    }
+    return file;
+}
+
+/*
+ * FNV-1a hash of the string
+ */
+u_int hash_string(const char *str) {
+    u_int hash = 2166136261u;
+    for (; *str; str++) {
+        hash ^= (unsigned char) *str;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Opens the log with the given base name for appending
+ * Creates the files if they do not exist
+ * Returns NULL on fail
+ */
+PROBE_LOG *open_probe_log(const char *base) {
+    PROBE_LOG *log = (PROBE_LOG*) calloc(1, sizeof(PROBE_LOG));
+    char name[1024];
+    HOP_RECORD last;
+    ULONGLONG size;
+    
+    memset(&last, 0, sizeof(HOP_RECORD));
+    file_name(name, 1024, base, "str");
+    log->strings = open_append(name, STR_MAGIC, 0, &log->string_size, NULL);
+    file_name(name, 1024, base, "log");
+    log->log = open_append(name, LOG_MAGIC, sizeof(HOP_RECORD), &size, (char*) &last);
+    if (!log->strings || !log->log) {
+        if (log->strings) fclose(log->strings);
+        if (log->log) fclose(log->log);
+        free(log);
+        return NULL;
+    }
+    log->base = strdup(base);
+    log->chain = last.time ? last.chain + 1 : 0;
+    log->last_time = last.time;
+    log->interned = (INTERNED*) calloc(INTERN_SLOTS, sizeof(INTERNED));
+    InitializeCriticalSection(&log->lock);
+    return log;
+}
+
+/*
+ * Returns the id of the string, appending it to the string file
+ * if it is not in the intern cache
+ * The cache has a fixed size, a string that fell out of it
+ * is simply stored again
+ * Must be called with the log lock held
+ */
+static u_int intern(PROBE_LOG *log, const char *str) {
+    u_int hash = hash_string(str);
+    INTERNED *slot = &log->interned[hash & (INTERN_SLOTS - 1)];
+    if (slot->str && slot->hash == hash && strcmp(slot->str, str) == 0) return slot->id;
+    
+    u_int len = strlen(str);
+    u_int id = (u_int) log->string_size;
+    fwrite(&len, sizeof(u_int), 1, log->strings);
+    fwrite(str, 1, len + 1, log->strings);
+    log->string_size += sizeof(u_int) + len + 1;
+    
+    if (slot->str) free(slot->str);
+    slot->str = strdup(str);
+    slot->hash = hash;
+    slot->id = id;
+    return id;
+}
+
+/*
+ * Reserves a chain id, every hop of a chain is logged with it
+ */
+u_int log_begin_chain(PROBE_LOG *log) {
+    EnterCriticalSection(&log->lock);
+    u_int chain = log->chain++;
+    LeaveCriticalSection(&log->lock);
+    return chain;
+}
+
+/*
+ * Appends a hop to the log
+ * Strings are interned and their ids stored in the record,
+ * new ones are flushed before the record is written
+ * NULL strings are stored as not present
+ * A time behind the last record's, from a worker that lost the race
+ * for the lock, is moved up so readers can binary search the log by time
+ */
+void log_hop(PROBE_LOG *log, HOP_RECORD *record, const char *strings[LOG_STRINGS]) {
+    EnterCriticalSection(&log->lock);
+    ULONGLONG string_size = log->string_size;
+    if (record->time < log->last_time) record->time = log->last_time;
+    log->last_time = record->time;
+    for (int i = 0; i < LOG_STRINGS; i++) {
+        record->strings[i] = strings[i] ? intern(log, strings[i]) : 0;
+    }
+    // the record file may flush on its own, new strings must be out before it
+    if (log->string_size != string_size) fflush(log->strings);
+    fwrite(record, sizeof(HOP_RECORD), 1, log->log);
+    LeaveCriticalSection(&log->lock);
+}
+
+/*
+ * Writes out buffered records
+ * Their strings are already out, log_hop() flushes new ones first
+ */
+void log_flush(PROBE_LOG *log) {
+    EnterCriticalSection(&log->lock);
+    fflush(log->strings);
+    fflush(log->log);
+    LeaveCriticalSection(&log->lock);
+}
+
+/*
+ * Closes the log and brings its index up to date
+ * Returns FALSE if the index could not be built
+ */
+BOOL close_probe_log(PROBE_LOG *log) {
+    fclose(log->strings);
+    fclose(log->log);
+    for (u_int i = 0; i < INTERN_SLOTS; i++) {
+        if (log->interned[i].str) free(log->interned[i].str);
+    }
+    free(log->interned);
+    DeleteCriticalSection(&log->lock);
+    
+    BOOL ok = build_index(log->base);
+    free(log->base);
+    free(log);
+    return ok;
+}
+
+/*
+ * Returns the string with the given id in the mapped string file
+ * Returns NULL if the id is 0 or out of range
+ */
+static const char *mapped_string(MAPPED_FILE *strings, u_int id) {
+    u_int len;
+    if (!id || (ULONGLONG) id + sizeof(u_int) > strings->size) return NULL;
+    memcpy(&len, strings->data + id, sizeof(u_int));
+    if ((ULONGLONG) id + sizeof(u_int) + len + 1 > strings->size) return NULL;
+    return strings->data + id + sizeof(u_int);
+}
+
+/*
+ * Orders index entries by host hash, time and record
+ */
+static int compare_entries(const void *a, const void *b) {
+    const INDEX_ENTRY *x = (const INDEX_ENTRY*) a;
+    const INDEX_ENTRY *y = (const INDEX_ENTRY*) b;
+    if (x->host_hash != y->host_hash) return x->host_hash < y->host_hash ? -1 : 1;
+    if (x->time != y->time) return x->time < y->time ? -1 : 1;
+    if (x->record != y->record) return x->record < y->record ? -1 : 1;
+    return 0;
+}
+
+/*
+ * Brings the index of the log up to date
+ * Records appended since the last build are sorted and merged
+ * with the existing index into a new file that replaces it
+ * Returns FALSE on fail
+ */
+BOOL build_index(const char *base) {
+    char name[1024], temp[1024];
+    MAPPED_FILE log, strings, old;
+    
+    file_name(name, 1024, base, "log");
+    if (!map_file(name, &log)) return FALSE;
+    file_name(name, 1024, base, "str");
+    if (!map_file(name, &strings)) {
+        unmap_file(&log);
+        return FALSE;
+    }
+    ULONGLONG records = log.size > sizeof(LOG_HEADER) ?
+            (log.size - sizeof(LOG_HEADER)) / sizeof(HOP_RECORD) : 0;
+    
+    // keep the old index if it is ours and covers part of this log
+    file_name(name, 1024, base, "idx");
+    ULONGLONG covered = 0, old_count = 0;
+    const INDEX_ENTRY *old_entries = NULL;
+    if (map_file(name, &old)) {
+        if (valid_header(&old, IDX_MAGIC, sizeof(INDEX_ENTRY)) &&
+                ((const LOG_HEADER*) old.data)->records <= records) {
+            covered = ((const LOG_HEADER*) old.data)->records;
+            old_count = (old.size - sizeof(LOG_HEADER)) / sizeof(INDEX_ENTRY);
+            old_entries = (const INDEX_ENTRY*) (old.data + sizeof(LOG_HEADER));
+        }
+    }
+    
+    const HOP_RECORD *all = (const HOP_RECORD*) (log.data + sizeof(LOG_HEADER));
+    INDEX_ENTRY *fresh = (INDEX_ENTRY*) malloc(sizeof(INDEX_ENTRY) * (records - covered + 1));
+    ULONGLONG fresh_count = 0;
+    for (ULONGLONG r = covered; r < records; r++) {
+        const char *host = mapped_string(&strings, all[r].strings[LS_HOST]);
+        fresh[fresh_count].host_hash = host ? hash_string(host) : 0;
+        fresh[fresh_count].host = all[r].strings[LS_HOST];
+        fresh[fresh_count].time = all[r].time;
+        fresh[fresh_count].record = (u_int) r;
+        fresh[fresh_count].code = all[r].code;
+        fresh_count++;
+    }
+    qsort(fresh, fresh_count, sizeof(INDEX_ENTRY), compare_entries);
+    
+    file_name(temp, 1024, base, "idx.tmp");
+    FILE *out = fopen(temp, "wb");
+    BOOL ok = out != NULL;
+    if (ok) {
+        LOG_HEADER header;
+        memset(&header, 0, sizeof(LOG_HEADER));
+        memcpy(header.magic, IDX_MAGIC, 8);
+        header.version = 1;
+        header.record_size = sizeof(INDEX_ENTRY);
+        header.records = records;
+        fwrite(&header, sizeof(LOG_HEADER), 1, out);
+        
+        ULONGLONG i = 0, j = 0;
+        while (i < old_count || j < fresh_count) {
+            if (j == fresh_count || 
+                    (i < old_count && compare_entries(&old_entries[i], &fresh[j]) <= 0)) {
+                fwrite(&old_entries[i++], sizeof(INDEX_ENTRY), 1, out);
+            } else {
+                fwrite(&fresh[j++], sizeof(INDEX_ENTRY), 1, out);
+            }
+        }
+        ok = fclose(out) == 0;
+    }
+    free(fresh);
+    unmap_file(&old);
+    unmap_file(&strings);
+    unmap_file(&log);
+    
+    if (ok) ok = MoveFileExA(temp, name, MOVEFILE_REPLACE_EXISTING) != 0;
+    if (!ok) printf("unable to write probe log index: %s\n", name);
+    return ok;
+}
+
+/*
+ * Maps the log, its strings and its index for reading
+ * The index is rebuilt first if it is missing or behind the log
+ * Returns NULL on fail
+ */
+PROBE_HISTORY *open_history(const char *base) {
+    PROBE_HISTORY *history = NULL;
+    char name[1024];
+    BOOL ok = FALSE;
+    
+    for (int attempt = 0; attempt < 2; attempt++) {
+        history = (PROBE_HISTORY*) calloc(1, sizeof(PROBE_HISTORY));
+        history->log.file = history->strings.file = history->index.file = INVALID_HANDLE_VALUE;
+        file_name(name, 1024, base, "log");
+        ok = map_file(name, &history->log) && 
+                valid_header(&history->log, LOG_MAGIC, sizeof(HOP_RECORD));
+        file_name(name, 1024, base, "str");
+        ok = ok && map_file(name, &history->strings);
+        file_name(name, 1024, base, "idx");
+        ok = ok && map_file(name, &history->index) &&
+                valid_header(&history->index, IDX_MAGIC, sizeof(INDEX_ENTRY));
+        
+        if (ok) {
+            history->record_count = (history->log.size - sizeof(LOG_HEADER)) / 
+                    sizeof(HOP_RECORD);
+            if (((const LOG_HEADER*) history->index.data)->records == 
+                    history->record_count) break;
+            ok = FALSE;
+        }
+        close_history(history);
+        history = NULL;
+        if (attempt || !build_index(base)) break;
+    }
+    if (!ok) {
+        printf("unable to open probe log: %s\n", base);
+        return NULL;
+    }
+    history->records = (const HOP_RECORD*) (history->log.data + sizeof(LOG_HEADER));
+    history->entries = (const INDEX_ENTRY*) (history->index.data + sizeof(LOG_HEADER));
+    history->entry_count = (history->index.size - sizeof(LOG_HEADER)) / sizeof(INDEX_ENTRY);
+    return history;
+}
+
+/*
+ * Returns the string with the given id, NULL if not present
+ */
+const char *history_string(PROBE_HISTORY *history, u_int id) {
+    return mapped_string(&history->strings, id);
+}
+
+/*
+ * Finds the index entries of the host with a binary search
+ * Entries are sorted by time, count is set to their number
+ * Entries of other hosts with the same hash may be mixed in,
+ * callers compare history_string(entry->host) with the host
+ */
+const INDEX_ENTRY *history_find_host(PROBE_HISTORY *history, const char *host,
+        ULONGLONG *count) {
+    char lower[1024];
+    u_int i;
+    for (i = 0; host[i] && i < 1023; i++) {
+        lower[i] = (host[i] >= 'A' && host[i] <= 'Z') ? host[i] + 'a' - 'A' : host[i];
+    }
+    lower[i] = '\0';
+    u_int hash = hash_string(lower);
+    
+    ULONGLONG low = 0, high = history->entry_count;
+    while (low < high) {
+        ULONGLONG mid = low + (high - low) / 2;
+        if (history->entries[mid].host_hash < hash) low = mid + 1;
+        else high = mid;
+    }
+    ULONGLONG end = low;
+    while (end < history->entry_count && history->entries[end].host_hash == hash) end++;
+    *count = end - low;
+    return &history->entries[low];
+}
+
+/*
+ * Prepares the query to return its first match
+ * A host query walks the host's index entries from since onwards,
+ * any other query walks the log itself from since onwards
+ */
+void history_query(PROBE_HISTORY *history, HISTORY_QUERY *query) {
+    ULONGLONG low = 0, high;
+    query->host_id = 0;
+    
+    if (query->host) {
+        query->entries = history_find_host(history, query->host, &query->count);
+        high = query->count;
+        while (low < high) {
+            ULONGLONG mid = low + (high - low) / 2;
+            if (query->entries[mid].time < query->since) low = mid + 1;
+            else high = mid;
+        }
+    } else {
+        query->entries = NULL;
+        query->count = history->record_count;
+        high = query->count;
+        while (low < high) {
+            ULONGLONG mid = low + (high - low) / 2;
+            if (history->records[mid].time < query->since) low = mid + 1;
+            else high = mid;
+        }
+    }
+    query->next = low;
+}
+
+/*
+ * Checks the parts of the filter not covered by the index walk
+ */
+static BOOL query_matches(PROBE_HISTORY *history, HISTORY_QUERY *query, 
+        const HOP_RECORD *record) {
+    if (query->code_max && (record->code < query->code_min || 
+            record->code > query->code_max)) return FALSE;
+    if (query->host && record->strings[LS_HOST] != query->host_id) {
+        const char *host = history_string(history, record->strings[LS_HOST]);
+        if (!host || _stricmp(host, query->host) != 0) return FALSE;
+        query->host_id = record->strings[LS_HOST];
+    }
+    if (query->location) {
+        const char *location = history_string(history, record->strings[LS_LOCATION]);
+        if (!location || strcmp(location, query->location) != 0) return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Returns the next record matching the query in time order
+ * Returns NULL when there are no more
+ */
+const HOP_RECORD *history_next(PROBE_HISTORY *history, HISTORY_QUERY *query) {
+    while (query->next < query->count) {
+        const HOP_RECORD *record;
+        if (query->entries) {
+            // the entry answers time and code, the record is only read for a match
+            const INDEX_ENTRY *entry = &query->entries[query->next];
+            if (query->until && entry->time >= query->until) break;
+            query->next++;
+            if (query->code_max && (entry->code < query->code_min || 
+                    entry->code > query->code_max)) continue;
+            record = &history->records[entry->record];
+        } else {
+            record = &history->records[query->next];
+            if (query->until && record->time >= query->until) break;
+            query->next++;
+        }
+        if (query_matches(history, query, record)) return record;
+    }
+    query->next = query->count;
+    return NULL;
+}
+
+/*
+ * Unmaps every file of the history
+ */
+void close_history(PROBE_HISTORY *history) {
+    unmap_file(&history->log);
+    unmap_file(&history->strings);
+    unmap_file(&history->index);
+    free(history);
+}
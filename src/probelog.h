@@ -0,0 +1,164 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   probelog.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Append only binary history of probed hops
+ *      name.log - fixed size hop records
+ *      name.str - interned strings referenced by the records
+ *      name.idx - records sorted by host and time, rebuilt on close
+ *                 or when a reader finds it behind the log
+ * All three are read back through memory mapped views
+ * 
+ * Created on October 21, 2026, 11:20 AM
+ */
+
+#ifndef PROBELOG_H
+#define PROBELOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+#include "sockopt.h"
+
+#define LOG_MAGIC "ARCLOG1"
+#define STR_MAGIC "ARCSTR1"
+#define IDX_MAGIC "ARCIDX1"
+#define INTERN_SLOTS (1 << 16) // recently interned strings kept in memory
+
+// Strings stored with each hop
+enum {
+    LS_HOST,
+    LS_PATH,
+    LS_MEANING,
+    LS_LOCATION,
+    LS_DATE,
+    LS_LAST_MODIFIED,
+    LS_ENCODING,
+    LOG_STRINGS
+};
+
+// Header of each of the three files
+typedef struct {
+    char magic[8];
+    u_int version;
+    u_int record_size;
+    ULONGLONG records; // index only, log records it covers
+}LOG_HEADER;
+
+// One hop as stored in the log
+typedef struct {
+    ULONGLONG time; // seconds since 1970
+    u_int chain; // hops of the same chain share this
+    u_short hop; // position in the chain
+    u_short code; // reply code, 0 if the hop failed
+    u_int server_ip; // IPv4, network order
+    u_int client_ip;
+    u_short server_port;
+    u_short client_port;
+    u_int strings[LOG_STRINGS]; // string ids, 0 if not present
+    ULONGLONG body_size; // GET only
+    ULONGLONG body_hash; // FNV-1a 64 of the body, 0 if it was not read
+    TCP_STATS tcp; // all 0 if the hop did not connect
+}HOP_RECORD;
+
+// Index entry, sorted by host_hash, time, record
+typedef struct {
+    u_int host_hash;
+    u_int host; // string id
+    ULONGLONG time;
+    u_int record; // record number in the log
+    u_int code;
+}INDEX_ENTRY;
+
+// Slot of the intern cache
+typedef struct {
+    u_int hash;
+    u_int id;
+    char *str;
+}INTERNED;
+
+// Log opened for appending
+typedef struct {
+    char *base;
+    FILE *log;
+    FILE *strings;
+    ULONGLONG string_size; // next string id - 1
+    u_int chain; // next chain id
+    ULONGLONG last_time; // records are kept in time order
+    INTERNED *interned;
+    CRITICAL_SECTION lock;
+}PROBE_LOG;
+
+// Log opened for reading
+typedef struct {
+    MAPPED_FILE log;
+    MAPPED_FILE strings;
+    MAPPED_FILE index;
+    const HOP_RECORD *records;
+    ULONGLONG record_count;
+    const INDEX_ENTRY *entries;
+    ULONGLONG entry_count;
+}PROBE_HISTORY;
+
+// Filter over a history, fields left 0 or NULL match everything
+typedef struct {
+    const char *host;
+    u_int code_min;
+    u_int code_max;
+    const char *location;
+    ULONGLONG since; // seconds since 1970, inclusive
+    ULONGLONG until; // exclusive, 0 for no limit
+    
+    // position of the query, set by history_query()
+    const INDEX_ENTRY *entries; // index range of the host, NULL to scan the log
+    ULONGLONG count;
+    ULONGLONG next;
+    u_int host_id; // last string id found to be the host
+}HISTORY_QUERY;
+
+u_int hash_string(const char *str);
+PROBE_LOG *open_probe_log(const char *base);
+u_int log_begin_chain(PROBE_LOG *log);
+void log_hop(PROBE_LOG *log, HOP_RECORD *record, const char *strings[LOG_STRINGS]);
+void log_flush(PROBE_LOG *log);
+BOOL close_probe_log(PROBE_LOG *log);
+BOOL build_index(const char *base);
+PROBE_HISTORY *open_history(const char *base);
+const char *history_string(PROBE_HISTORY *history, u_int id);
+const INDEX_ENTRY *history_find_host(PROBE_HISTORY *history, const char *host, 
+        ULONGLONG *count);
+void history_query(PROBE_HISTORY *history, HISTORY_QUERY *query);
+const HOP_RECORD *history_next(PROBE_HISTORY *history, HISTORY_QUERY *query);
+void close_history(PROBE_HISTORY *history);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROBELOG_H */
@@ -0,0 +1,129 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "proxy.h"
+
+/*
+ * Reads host:port, port 8080 if it is not given, and resolves the host
+ * once for the whole run
+ * Returns NULL if the host can not be resolved
+ */
+PROXY *create_proxy(const char *spec) {
+    PROXY *proxy = (PROXY*) calloc(1, sizeof(PROXY));
+    char *colon;
+    
+    proxy->host = strdup(spec);
+    proxy->port = 8080;
+    if ((colon = strrchr(proxy->host, ':')) != NULL) {
+        *colon = '\0';
+        proxy->port = atoi(colon + 1);
+    }
+    struct hostent *entry = gethostbyname(proxy->host);
+    if (!entry || proxy->port <= 0 || proxy->port > 65535) {
+        printf("Invalid proxy: %s\n", spec);
+        free(proxy->host);
+        free(proxy);
+        return NULL;
+    }
+    memcpy(&proxy->address.sin_addr, entry->h_addr_list[0], sizeof(struct in_addr));
+    proxy->address.sin_family = AF_INET;
+    proxy->address.sin_port = htons(proxy->port);
+    snprintf(proxy->ip, 100, "%s", inet_ntoa(proxy->address.sin_addr));
+    InitializeCriticalSection(&proxy->lock);
+    printf("Sending every request through proxy %s (%s:%d)\n", 
+            proxy->host, proxy->ip, proxy->port);
+    return proxy;
+}
+
+/*
+ * Returns a connection to the proxy, a kept alive one if there is
+ * one and fresh is FALSE, reused tells which
+ * Kept alive connections may have been closed by the proxy since,
+ * a request that gets nothing back on them should be tried again
+ * on a fresh one
+ * Returns INVALID_SOCKET if a new connection can not be made
+ */
+SOCKET proxy_connect(PROXY *proxy, SOCKET_TUNING *tuning, BOOL fresh, BOOL *reused) {
+    SOCKET s = INVALID_SOCKET;
+    ULONGLONG now = GetTickCount64();
+    
+    EnterCriticalSection(&proxy->lock);
+    while (!fresh && proxy->idle_count && s == INVALID_SOCKET) {
+        IDLE_CONNECTION *idle = &proxy->idle[--proxy->idle_count];
+        if (now - idle->since < PROXY_IDLE_MS) s = idle->s;
+        else closesocket(idle->s);
+    }
+    LeaveCriticalSection(&proxy->lock);
+    
+    *reused = s != INVALID_SOCKET;
+    if (*reused) {
+        InterlockedIncrement(&proxy->reused);
+        return s;
+    }
+    if ((s = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET) return INVALID_SOCKET;
+    if (!tune_socket(s, tuning) || 
+            connect(s, (struct sockaddr*) &proxy->address, sizeof(proxy->address)) < 0) {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    InterlockedIncrement(&proxy->opened);
+    return s;
+}
+
+/*
+ * Hands a connection back after its reply was read
+ * Only connections left at the end of a reply the proxy keeps
+ * alive are pooled, the others are closed, and so is the oldest
+ * idle connection when the pool is full
+ */
+void proxy_release(PROXY *proxy, SOCKET s, BOOL reusable) {
+    SOCKET oldest = INVALID_SOCKET;
+    
+    if (!reusable) {
+        closesocket(s);
+        return;
+    }
+    EnterCriticalSection(&proxy->lock);
+    if (proxy->idle_count == PROXY_IDLE_MAX) {
+        oldest = proxy->idle[0].s;
+        memmove(proxy->idle, proxy->idle + 1, sizeof(IDLE_CONNECTION) * --proxy->idle_count);
+    }
+    proxy->idle[proxy->idle_count].s = s;
+    proxy->idle[proxy->idle_count++].since = GetTickCount64();
+    LeaveCriticalSection(&proxy->lock);
+    if (oldest != INVALID_SOCKET) closesocket(oldest);
+}
+
+/*
+ * Closes the idle connections and frees the proxy
+ */
+void free_proxy(PROXY *proxy) {
+    printf("Proxy connections made: %ld, requests on kept alive connections: %ld\n",
+            proxy->opened, proxy->reused);
+    for (u_int i = 0; i < proxy->idle_count; i++) closesocket(proxy->idle[i].s);
+    DeleteCriticalSection(&proxy->lock);
+    free(proxy->host);
+    free(proxy);
+}
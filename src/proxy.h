@@ -0,0 +1,77 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   proxy.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Forward proxy every hop is sent through, and the connections to it
+ * Connections the proxy keeps alive are handed back to a pool so the
+ * next probe starts without a TCP handshake
+ * 
+ * Created on October 26, 2026, 9:30 AM
+ */
+
+#ifndef PROXY_H
+#define PROXY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+#include "sockopt.h"
+
+#define PROXY_IDLE_MAX 64 // kept alive connections waiting for a probe
+#define PROXY_IDLE_MS 15000 // idle connections older than this are closed
+
+// Connection kept alive by the proxy
+typedef struct {
+    SOCKET s;
+    ULONGLONG since; // GetTickCount64() when it was handed back
+}IDLE_CONNECTION;
+
+// Proxy address and its idle connections, shared by all workers
+typedef struct {
+    char *host;
+    int port;
+    char ip[100];
+    struct sockaddr_in address;
+    IDLE_CONNECTION idle[PROXY_IDLE_MAX]; // most recently used last
+    u_int idle_count;
+    CRITICAL_SECTION lock;
+    volatile LONG opened; // connections made
+    volatile LONG reused; // probes sent on a kept alive connection
+}PROXY;
+
+PROXY *create_proxy(const char *spec);
+SOCKET proxy_connect(PROXY *proxy, SOCKET_TUNING *tuning, BOOL fresh, BOOL *reused);
+void proxy_release(PROXY *proxy, SOCKET s, BOOL reusable);
+void free_proxy(PROXY *proxy);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROXY_H */
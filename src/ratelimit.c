@@ -0,0 +1,238 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "ratelimit.h"
+
+#define BUSY_RETRY_MS 500 // retry delay for a host at its concurrency cap
+
+/*
+ * FNV-1a hash of the lower case hostname
+ */
+static u_int hash_host(const char *host) {
+    u_int hash = 2166136261u;
+    for (; *host; host++) {
+        char c = *host;
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        hash ^= (unsigned char) c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Creates a limiter able to track the given number of hosts
+ * param max_active - probes allowed in flight per host, 0 for no cap
+ * param rps - requests per second per host, 0 for no limit
+ * param burst - requests a host may receive back to back
+ * param adaptive - each host gets its own cap, starting at ADAPT_START and
+ * never above max_active, or ADAPT_CEILING if max_active is 0
+ * Returns NULL on fail
+ */
+RATE_LIMITER *create_limiter(u_int hosts, u_int max_active, double rps, u_int burst,
+        BOOL adaptive) {
+    RATE_LIMITER *limiter = (RATE_LIMITER*) malloc(sizeof(RATE_LIMITER));
+    if (!limiter) return NULL;
+    
+    limiter->size = 16;
+    while (limiter->size < hosts * 2) limiter->size <<= 1;
+    limiter->hosts = (HOST_LIMIT*) calloc(limiter->size, sizeof(HOST_LIMIT));
+    if (!limiter->hosts) {
+        free(limiter);
+        return NULL;
+    }
+    if (burst < 1) burst = 1;
+    if (burst > TOKEN_MASK / TOKEN_UNIT) burst = TOKEN_MASK / TOKEN_UNIT;
+    
+    if (adaptive && !max_active) max_active = ADAPT_CEILING;
+    limiter->max_active = max_active;
+    limiter->adaptive = adaptive;
+    limiter->rate = (u_int) (rps * TOKEN_UNIT);
+    limiter->burst = burst;
+    limiter->start = GetTickCount64();
+    for (u_int i = 0; i < limiter->size; i++) {
+        limiter->hosts[i].bucket = (LONGLONG) burst * TOKEN_UNIT;
+        limiter->hosts[i].window = ADAPT_START * WINDOW_UNIT;
+    }
+    return limiter;
+}
+
+/*
+ * Returns the limits of the given host, adding it if it is new
+ * Safe to call from several threads at once
+ * Returns NULL if the table is full, such hosts are not limited
+ */
+HOST_LIMIT *find_host_limit(RATE_LIMITER *limiter, const char *host) {
+    u_int mask = limiter->size - 1;
+    u_int i = hash_host(host) & mask;
+    char *copy = NULL;
+    
+    for (u_int probe = 0; probe < limiter->size; probe++, i = (i + 1) & mask) {
+        char *name = limiter->hosts[i].host;
+        if (!name) {
+            if (!copy) copy = strdup(host);
+            name = (char*) InterlockedCompareExchangePointer(
+                    (PVOID volatile*) &limiter->hosts[i].host, copy, NULL);
+            if (!name) return &limiter->hosts[i];
+        }
+        if (_stricmp(name, host) == 0) {
+            if (copy) free(copy);
+            return &limiter->hosts[i];
+        }
+    }
+    if (copy) free(copy);
+    return NULL;
+}
+
+/*
+ * Attempts to start a probe against the host
+ * Takes a concurrency slot and a token from the host bucket
+ * Returns TRUE if the probe may go, host_release() must follow it
+ * Returns FALSE and the suggested delay in wait_ms if host is over its limit
+ */
+BOOL host_acquire(RATE_LIMITER *limiter, HOST_LIMIT *limit, u_int *wait_ms) {
+    *wait_ms = 0;
+    if (!limit) return TRUE;
+    
+    u_int cap = limiter->adaptive ? (u_int) limit->window / WINDOW_UNIT : limiter->max_active;
+    LONG active = InterlockedIncrement(&limit->active);
+    if (cap && (u_int) active > cap) {
+        InterlockedDecrement(&limit->active);
+        *wait_ms = BUSY_RETRY_MS;
+        // adaptive hosts free a slot about every round trip
+        LONG best = limit->best;
+        if (limiter->adaptive && best && (u_int) best / 1000 < BUSY_RETRY_MS) {
+            *wait_ms = (u_int) best / 1000;
+        }
+        return FALSE;
+    }
+    if (!limiter->rate) return TRUE;
+    
+    ULONGLONG now = GetTickCount64() - limiter->start;
+    ULONGLONG max = (ULONGLONG) limiter->burst * TOKEN_UNIT;
+    LONGLONG old, next;
+    do {
+        old = limit->bucket;
+        ULONGLONG then = (ULONGLONG) old >> TOKEN_BITS;
+        ULONGLONG tokens = (ULONGLONG) old & TOKEN_MASK;
+        
+        if (now > then) {
+            ULONGLONG refill = (now - then) * limiter->rate / 1000;
+            if (tokens + refill >= max) {
+                tokens = max;
+                then = now;
+            } else if (refill) {
+                tokens += refill;
+                then += refill * 1000 / limiter->rate;
+            }
+        }
+        if (tokens < TOKEN_UNIT) {
+            *wait_ms = (u_int) ((TOKEN_UNIT - tokens) * 1000 / limiter->rate) + 1;
+            InterlockedDecrement(&limit->active);
+            return FALSE;
+        }
+        next = (LONGLONG) ((then << TOKEN_BITS) | (tokens - TOKEN_UNIT));
+    } while (InterlockedCompareExchange64(&limit->bucket, next, old) != old);
+    
+    return TRUE;
+}
+
+/*
+ * Adds delta to the adaptive cap of the host, keeping it between
+ * one probe and the ceiling
+ */
+static void adjust_window(RATE_LIMITER *limiter, HOST_LIMIT *limit, LONG delta) {
+    LONG max = (LONG) limiter->max_active * WINDOW_UNIT;
+    LONG old, next;
+    do {
+        old = limit->window;
+        next = old + delta;
+        if (next < WINDOW_UNIT) next = WINDOW_UNIT;
+        if (next > max) next = max;
+        if (next == old) return;
+    } while (InterlockedCompareExchange(&limit->window, next, old) != old);
+}
+
+/*
+ * Updates the adaptive cap of the host from a finished probe
+ * Overloaded hosts have their cap halved, at most once per round trip
+ * since probes already in flight report the same overload
+ * Otherwise the cap grows by one probe per cap's worth of probes while
+ * latency stays within ADAPT_SLACK of the best seen, and shrinks at
+ * the same pace once it rises past that, as queues build up at the host
+ * It only grows when the probe ran with the cap full, a host that never
+ * reaches its cap has not shown it can take more
+ */
+static void adapt(RATE_LIMITER *limiter, HOST_LIMIT *limit, const HOST_SAMPLE *sample) {
+    LONG window = limit->window;
+    
+    if (sample->overloaded) {
+        LONGLONG now = (LONGLONG) (GetTickCount64() - limiter->start);
+        LONGLONG last = limit->cut_at;
+        LONGLONG gap = limit->best ? (LONGLONG) limit->best * ADAPT_SLACK / 1000 : ADAPT_CUT_MS;
+        if (gap < ADAPT_CUT_MIN_MS) gap = ADAPT_CUT_MIN_MS;
+        if (gap > ADAPT_CUT_MS) gap = ADAPT_CUT_MS;
+        if (last && now - last < gap) return;
+        if (InterlockedCompareExchange64(&limit->cut_at, now ? now : 1, last) != last) return;
+        adjust_window(limiter, limit, -(window / 2));
+        return;
+    }
+    if (!sample->latency) return;
+    
+    // the best latency slowly drifts up so a route that got slower is learnt
+    LONG best, next;
+    do {
+        best = limit->best;
+        next = best + best / 256 + 1;
+        if (!best || (LONG) sample->latency < next) next = (LONG) sample->latency;
+    } while (InterlockedCompareExchange(&limit->best, next, best) != best);
+    
+    LONG step = WINDOW_UNIT * WINDOW_UNIT / window;
+    if (step < 1) step = 1;
+    if (best && sample->latency > (u_int) best * ADAPT_SLACK) adjust_window(limiter, limit, -step);
+    else if (limit->active >= window / WINDOW_UNIT) adjust_window(limiter, limit, step);
+}
+
+/*
+ * Gives back the concurrency slot taken by host_acquire()
+ * sample is what the probe learnt about the host, NULL if nothing
+ */
+void host_release(RATE_LIMITER *limiter, HOST_LIMIT *limit, const HOST_SAMPLE *sample) {
+    if (!limit) return;
+    if (limiter->adaptive && sample) adapt(limiter, limit, sample);
+    InterlockedDecrement(&limit->active);
+}
+
+/*
+ * Releases the limiter and every host it tracks
+ * No thread may use the limiter any more
+ */
+void free_limiter(RATE_LIMITER *limiter) {
+    if (!limiter) return;
+    for (u_int i = 0; i < limiter->size; i++) {
+        if (limiter->hosts[i].host) free(limiter->hosts[i].host);
+    }
+    free(limiter->hosts);
+    free(limiter);
+}
@@ -0,0 +1,96 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   ratelimit.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Per host politeness limits, concurrency cap and token bucket
+ * Both are updated with interlocked operations only so workers
+ * never wait on each other to check a host
+ * The cap is either fixed or adapted to each host: it grows while the
+ * host answers as fast as it ever did and halves when it is overloaded
+ * 
+ * Created on October 19, 2026, 2:40 PM
+ */
+
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+
+#define TOKEN_BITS 24 // tokens are stored in 1/1000 units in the low bits
+#define TOKEN_MASK ((1ULL << TOKEN_BITS) - 1)
+#define TOKEN_UNIT 1000
+
+#define WINDOW_UNIT 256 // adaptive caps are stored in 1/256 probes
+#define ADAPT_START 2 // adaptive cap of a host not probed yet
+#define ADAPT_CEILING 64 // adaptive cap never grows past this
+#define ADAPT_SLACK 2 // latency up to this times the host's best counts as flat
+#define ADAPT_CUT_MS 1000 // halvings of a host with no latency yet are this far apart
+#define ADAPT_CUT_MIN_MS 10 // and never closer than this otherwise
+
+// Limits and bucket state of a single host
+typedef struct {
+    char * volatile host; // published once with compare exchange
+    volatile LONGLONG bucket; // refill time in ms << TOKEN_BITS | tokens
+    volatile LONG active; // probes in flight
+    volatile LONG window; // adaptive cap in WINDOW_UNIT
+    volatile LONG best; // lowest latency seen in microseconds, 0 if none yet
+    volatile LONGLONG cut_at; // limiter time in ms of the last halving
+}HOST_LIMIT;
+
+// What a finished probe tells about its host
+typedef struct {
+    u_int latency; // microseconds from connecting to the first byte, 0 if unknown
+    BOOL overloaded; // connection reset or refused, timeout, 429 or 503
+}HOST_SAMPLE;
+
+// Open addressing table of hosts, never shrinks
+typedef struct {
+    HOST_LIMIT *hosts;
+    u_int size; // power of 2
+    u_int max_active; // per host concurrency, 0 for no cap
+    BOOL adaptive; // max_active is only the ceiling of each host's own cap
+    u_int rate; // tokens per 1000 seconds, 0 for no limit
+    u_int burst; // bucket size in tokens
+    ULONGLONG start; // ms, bucket times are relative to this
+}RATE_LIMITER;
+
+RATE_LIMITER *create_limiter(u_int hosts, u_int max_active, double rps, u_int burst,
+        BOOL adaptive);
+HOST_LIMIT *find_host_limit(RATE_LIMITER *limiter, const char *host);
+BOOL host_acquire(RATE_LIMITER *limiter, HOST_LIMIT *limit, u_int *wait_ms);
+void host_release(RATE_LIMITER *limiter, HOST_LIMIT *limit, const HOST_SAMPLE *sample);
+void free_limiter(RATE_LIMITER *limiter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RATELIMIT_H */
@@ -0,0 +1,315 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "reply.h"
+#include "headers.h"
+
+// Bytes waiting to be consumed, leftovers of the head first
+typedef struct {
+    REPLY_SOURCE *source;
+    char *data;
+    u_int pos;
+    u_int len;
+    char *buffer; // BODY_BUFFER bytes
+    BODY_DECODER *decoder; // NULL if the body is not decoded
+}BODY_STREAM;
+
+/*
+ * Reads from the socket of the source, or a socket with its
+ * received bytes also kept on tape
+ */
+void socket_source(REPLY_SOURCE *source, SOCKET s, BOOL keep) {
+    memset(source, 0, sizeof(REPLY_SOURCE));
+    source->s = s;
+    if (keep) {
+        source->tape_size = 4096;
+        source->tape = (char*) malloc(source->tape_size);
+    }
+}
+
+/*
+ * Reads the given captured bytes as if they came off a socket
+ */
+void bytes_source(REPLY_SOURCE *source, const char *bytes, u_int size) {
+    memset(source, 0, sizeof(REPLY_SOURCE));
+    source->s = INVALID_SOCKET;
+    source->bytes = bytes;
+    source->size = size;
+}
+
+/*
+ * recv() on the source
+ * Returns the bytes read, 0 at the end and -1 on error
+ */
+static int source_recv(REPLY_SOURCE *source, char *buffer, int size) {
+    if (source->s == INVALID_SOCKET) {
+        if ((u_int) size > source->size - source->pos) size = source->size - source->pos;
+        memcpy(buffer, source->bytes + source->pos, size);
+        source->pos += size;
+        return size;
+    }
+    
+    int got = recv(source->s, buffer, size, 0);
+    if (got > 0 && !source->first_byte.QuadPart) QueryPerformanceCounter(&source->first_byte);
+    if (got > 0 && source->tape && !source->truncated) {
+        if (source->tape_len + got > CAPTURE_TAPE_MAX) {
+            source->truncated = TRUE;
+            return got;
+        }
+        if (source->tape_len + got > source->tape_size) {
+            while (source->tape_len + got > source->tape_size) source->tape_size *= 2;
+            source->tape = (char*) realloc(source->tape, source->tape_size);
+        }
+        memcpy(source->tape + source->tape_len, buffer, got);
+        source->tape_len += got;
+    }
+    return got;
+}
+
+/*
+ * Makes sure there are unread bytes in the stream
+ * Returns FALSE at the end of the connection or on error
+ */
+static BOOL fill(BODY_STREAM *stream) {
+    if (stream->pos < stream->len) return TRUE;
+    int size = source_recv(stream->source, stream->buffer, BODY_BUFFER);
+    if (size <= 0) return FALSE;
+    stream->data = stream->buffer;
+    stream->pos = 0;
+    stream->len = size;
+    return TRUE;
+}
+
+/*
+ * Hashes and drops count bytes of body, or everything up to the
+ * end of the connection if count is -1
+ * Returns FALSE if the connection ended early
+ */
+static BOOL consume(BODY_STREAM *stream, ULONGLONG count, HTTP_REPLY *reply) {
+    ULONGLONG hash = reply->body.hash;
+    while (count) {
+        if (!fill(stream)) {
+            reply->body.hash = hash;
+            return count == (ULONGLONG) -1;
+        }
+        u_int take = stream->len - stream->pos;
+        if (take > count) take = (u_int) count;
+        const unsigned char *bytes = (const unsigned char*) stream->data + stream->pos;
+        for (u_int i = 0; i < take; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        if (stream->decoder) decoder_feed(stream->decoder, bytes, take);
+        stream->pos += take;
+        reply->body.size += take;
+        if (count != (ULONGLONG) -1) count -= take;
+    }
+    reply->body.hash = hash;
+    return TRUE;
+}
+
+/*
+ * Reads a CRLF terminated line of chunked framing into line
+ * Overlong lines are cut, the rest is skipped
+ * Returns FALSE if the connection ended first
+ */
+static BOOL read_line(BODY_STREAM *stream, char *line, u_int size) {
+    u_int len = 0;
+    while (fill(stream)) {
+        char c = stream->data[stream->pos++];
+        if (c == '\n') {
+            if (len && line[len - 1] == '\r') len--;
+            line[len] = '\0';
+            return TRUE;
+        }
+        if (len < size - 1) line[len++] = c;
+    }
+    return FALSE;
+}
+
+/*
+ * Reads a chunked body up to and including its trailers
+ * Returns FALSE on a framing error or if the connection ended first
+ */
+static BOOL consume_chunked(BODY_STREAM *stream, HTTP_REPLY *reply) {
+    char line[1024];
+    while (TRUE) {
+        char *end;
+        if (!read_line(stream, line, 1024)) return FALSE;
+        ULONGLONG size = strtoull(line, &end, 16);
+        if (end == line) return FALSE;
+        if (!size) break;
+        if (!consume(stream, size, reply) || !read_line(stream, line, 1024) || line[0]) {
+            return FALSE;
+        }
+    }
+    do {
+        if (!read_line(stream, line, 1024)) return FALSE;
+    } while (line[0]);
+    return TRUE;
+}
+
+/*
+ * Finds the end of the head in the first len bytes of data
+ * Returns the length of the head including its blank line, 0 if not there yet
+ */
+static u_int head_length(const char *data, u_int len) {
+    for (u_int i = 0; i + 1 < len; i++) {
+        if (data[i] != '\n') continue;
+        if (data[i + 1] == '\n') return i + 2;
+        if (data[i + 1] == '\r' && i + 2 < len && data[i + 2] == '\n') return i + 3;
+    }
+    return 0;
+}
+
+/*
+ * Checks whether the comma separated header value contains token
+ */
+static BOOL has_token(const char *value, u_int len, const char *token) {
+    u_int token_len = strlen(token);
+    for (u_int i = 0; i + token_len <= len; i++) {
+        if (_strnicmp(value + i, token, token_len) == 0) return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Reads one reply from the source
+ * If body is TRUE the request was a GET and the body is read as
+ * framed by Content-Length, chunked encoding or the end of the connection
+ * If decode is TRUE the body is also run through its Content-Encoding
+ * Only as much as the framing says is read, so a reusable
+ * connection is left at the start of the next reply
+ * Interim 1xx heads such as 103 Early Hints are skipped
+ * Returns FALSE if no complete head arrived
+ */
+BOOL read_reply(REPLY_SOURCE *source, BOOL body, BOOL decode, HTTP_REPLY *reply) {
+    u_int size = 4096, len = 0, head_len = 0, interim = 0;
+    char *data = (char*) malloc(size);
+    
+    memset(reply, 0, sizeof(HTTP_REPLY));
+    while (TRUE) {
+        while (!(head_len = head_length(data, len))) {
+            if (len == size) {
+                if (size == REPLY_HEAD_MAX) break;
+                size *= 2;
+                data = (char*) realloc(data, size);
+            }
+            int got = source_recv(source, data + len, size - len);
+            if (got <= 0) break;
+            len += got;
+        }
+        if (!head_len || len < 12 || strncmp(data, "HTTP/", 5) != 0) {
+            free(data);
+            return FALSE;
+        }
+        // interim 1xx heads are dropped, 101 switches protocols and is final
+        int code = atoi(data + 9);
+        if (code < 100 || code >= 200 || code == 101 || 
+                ++interim > REPLY_INTERIM_MAX) break;
+        memmove(data, data + head_len, len - head_len);
+        len -= head_len;
+    }
+    reply->head = (char*) malloc(head_len + 1);
+    memcpy(reply->head, data, head_len);
+    reply->head[head_len] = '\0';
+    reply->code = atoi(data + 9);
+    if (source->head_read) source->head_read(source->context, reply->head);
+    
+    // framing headers
+    ULONGLONG length = (ULONGLONG) -1;
+    BOOL chunked = FALSE, closing = FALSE, keep_alive = FALSE;
+    int coding = CODING_IDENTITY;
+    char *line = strchr(reply->head, '\n') + 1;
+    while (*line && *line != '\r' && *line != '\n') {
+        char *end = strchr(line, '\n');
+        char *colon = memchr(line, ':', end - line);
+        if (colon) {
+            char *value = colon + 1;
+            while (*value == ' ' || *value == '\t') value++;
+            switch (header_id(line, colon - line)) {
+                case HDR_CONTENT_LENGTH:
+                    length = strtoull(value, NULL, 10);
+                    break;
+                case HDR_TRANSFER_ENCODING:
+                    chunked = has_token(value, end - value, "chunked");
+                    break;
+                case HDR_CONNECTION:
+                case HDR_PROXY_CONNECTION:
+                    if (has_token(value, end - value, "close")) closing = TRUE;
+                    if (has_token(value, end - value, "keep-alive")) keep_alive = TRUE;
+                    break;
+                case HDR_CONTENT_ENCODING:
+                    coding = coding_from_header(value, end - value);
+                    break;
+            }
+        }
+        line = end + 1;
+    }
+    // HTTP/1.0 connections close unless asked to stay
+    if (strncmp(data, "HTTP/1.0", 8) == 0 && !keep_alive) closing = TRUE;
+    
+    BOOL complete = TRUE;
+    if (body && reply->code >= 200 && reply->code != 204 && reply->code != 304) {
+        BODY_STREAM stream;
+        BODY_DECODER decoder;
+        stream.source = source;
+        stream.data = data;
+        stream.pos = head_len;
+        stream.len = len;
+        stream.buffer = (char*) malloc(BODY_BUFFER);
+        stream.decoder = NULL;
+        reply->body.read = TRUE;
+        reply->body.hash = BODY_HASH_SEED;
+        reply->body.coding = coding;
+        if (decode && coding != CODING_IDENTITY) {
+            decoder_init(&decoder, coding);
+            stream.decoder = &decoder;
+        }
+        
+        if (chunked) complete = consume_chunked(&stream, reply);
+        else if (length != (ULONGLONG) -1) complete = consume(&stream, length, reply);
+        else {
+            consume(&stream, (ULONGLONG) -1, reply);
+            closing = TRUE;
+        }
+        if (stream.pos < stream.len) closing = TRUE; // more than the framing allows
+        free(stream.buffer);
+        
+        reply->body.decoded = decode;
+        reply->body.decoded_size = reply->body.size;
+        if (stream.decoder) {
+            decoder_end(&decoder);
+            reply->body.decoded_size = decoder.decoded_size;
+            reply->body.decode_seconds = decoder_seconds(&decoder);
+            reply->body.decode_failed = decoder.failed;
+        }
+    } else if (len > head_len) {
+        closing = TRUE;
+    }
+    reply->reusable = complete && !closing;
+    free(data);
+    return TRUE;
+}
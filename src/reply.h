@@ -0,0 +1,95 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   reply.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Reads an HTTP/1.1 reply off a socket, or out of captured bytes
+ * The head is kept, the body is streamed through a hash and
+ * dropped so it is never held in memory
+ * 
+ * Created on October 22, 2026, 9:40 AM
+ */
+
+#ifndef REPLY_H
+#define REPLY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+#include "decode.h"
+#include "capture.h"
+
+#define REPLY_HEAD_MAX 65536 // longest status line and headers accepted
+#define REPLY_INTERIM_MAX 16 // 1xx heads skipped before the final one
+#define BODY_BUFFER 16384 // body bytes read from the socket at once
+#define BODY_HASH_SEED 14695981039346656037ULL // FNV-1a 64 offset basis
+
+// What was learnt about a body
+typedef struct {
+    BOOL read; // a body was read, GET only
+    ULONGLONG size; // as sent, without chunked framing
+    ULONGLONG hash; // FNV-1a 64 of the bytes as sent
+    BOOL decoded; // Content-Encoding was decoded
+    int coding;
+    ULONGLONG decoded_size;
+    double decode_seconds;
+    BOOL decode_failed;
+}BODY_INFO;
+
+// Where read_reply() takes its bytes from
+typedef struct {
+    SOCKET s; // INVALID_SOCKET to read the bytes below
+    const char *bytes; // captured reply
+    u_int size;
+    u_int pos;
+    char *tape; // everything received from the socket, NULL if not kept
+    u_int tape_len;
+    u_int tape_size;
+    BOOL truncated; // tape reached CAPTURE_TAPE_MAX
+    LARGE_INTEGER first_byte; // QueryPerformanceCounter() of the first bytes
+    void (*head_read)(void *context, const char *head); // before the body, NULL for none
+    void *context;
+}REPLY_SOURCE;
+
+// Reply read by read_reply()
+typedef struct {
+    char *head; // status line and headers, NUL terminated
+    u_int code;
+    BODY_INFO body;
+    BOOL reusable; // reply fully consumed, connection may be kept alive
+}HTTP_REPLY;
+
+void socket_source(REPLY_SOURCE *source, SOCKET s, BOOL keep);
+void bytes_source(REPLY_SOURCE *source, const char *bytes, u_int size);
+BOOL read_reply(REPLY_SOURCE *source, BOOL body, BOOL decode, HTTP_REPLY *reply);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REPLY_H */
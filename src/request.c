@@ -0,0 +1,158 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "request.h"
+
+/*
+ * Builds the template for requests with the given method
+ * headers are complete header lines without CRLF, such as
+ * "User-Agent: arc", added to every request in the given order
+ */
+REQUEST_TEMPLATE *create_template(const char *method, char **headers, u_int count) {
+    REQUEST_TEMPLATE *request = (REQUEST_TEMPLATE*) malloc(sizeof(REQUEST_TEMPLATE));
+    u_int size = 5;
+    
+    request->start_len = strlen(method) + 1;
+    request->start = (char*) malloc(request->start_len + 1);
+    memcpy(request->start, method, request->start_len - 1);
+    strcpy(request->start + request->start_len - 1, " ");
+    
+    request->version = strdup(" HTTP/1.1\r\nHost: ");
+    request->version_len = strlen(request->version);
+    
+    for (u_int i = 0; i < count; i++) size += strlen(headers[i]) + 2;
+    request->rest = (char*) malloc(size);
+    strcpy(request->rest, "\r\n");
+    for (u_int i = 0; i < count; i++) {
+        strcat(request->rest, headers[i]);
+        strcat(request->rest, "\r\n");
+    }
+    strcat(request->rest, "\r\n");
+    request->rest_len = strlen(request->rest);
+    return request;
+}
+
+/*
+ * Writes the port as ":digits" into out, nothing if port is 0
+ * Returns the length written
+ */
+static u_int port_suffix(char *out, int port) {
+    char digits[8];
+    u_int len = 0, count = 0;
+    if (port <= 0) return 0;
+    while (port && count < 8) {
+        digits[count++] = '0' + port % 10;
+        port /= 10;
+    }
+    out[len++] = ':';
+    while (count) out[len++] = digits[--count];
+    return len;
+}
+
+/*
+ * Points buffers at the segments of a request for path on host:port
+ * port_text must hold 8 bytes
+ * Returns the number of buffers used
+ */
+static u_int request_buffers(WSABUF buffers[REQUEST_SEGMENTS], REQUEST_TEMPLATE *request, 
+        char *path, char *host, int port, char *port_text) {
+    u_int count = 0;
+    buffers[count].buf = request->start;
+    buffers[count++].len = request->start_len;
+    buffers[count].buf = path;
+    buffers[count++].len = strlen(path);
+    buffers[count].buf = request->version;
+    buffers[count++].len = request->version_len;
+    buffers[count].buf = host;
+    buffers[count++].len = strlen(host);
+    buffers[count].buf = port_text;
+    buffers[count++].len = port_suffix(port_text, port);
+    buffers[count].buf = request->rest;
+    buffers[count++].len = request->rest_len;
+    return count;
+}
+
+/*
+ * Sends a request for path on host:port made from the template
+ * port is 0 when it is the default port of the scheme
+ * All segments go out in one WSASend(), if the socket takes only
+ * part of them the rest is sent from where it stopped
+ * Returns FALSE if the socket fails
+ */
+BOOL send_request(SOCKET s, REQUEST_TEMPLATE *request, char *path, char *host, int port) {
+    WSABUF buffers[REQUEST_SEGMENTS];
+    char port_text[8];
+    DWORD sent;
+    u_int first = 0;
+    u_int count = request_buffers(buffers, request, path, host, port, port_text);
+    
+    while (first < count) {
+        if (WSASend(s, &buffers[first], count - first, &sent, 0, NULL, NULL) == SOCKET_ERROR) {
+            return FALSE;
+        }
+        if (!sent) return FALSE;
+        // skip what went out, the first buffer left may be partly sent
+        while (first < count && sent >= buffers[first].len) {
+            sent -= buffers[first++].len;
+        }
+        if (first < count) {
+            buffers[first].buf += sent;
+            buffers[first].len -= sent;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * Returns the bytes send_request() sends for the same arguments as one
+ * NUL terminated string, len is set to their length
+ */
+char *format_request(REQUEST_TEMPLATE *request, char *path, char *host, int port, 
+        u_int *len) {
+    WSABUF buffers[REQUEST_SEGMENTS];
+    char port_text[8];
+    u_int count = request_buffers(buffers, request, path, host, port, port_text);
+    
+    *len = 0;
+    for (u_int i = 0; i < count; i++) *len += buffers[i].len;
+    char *bytes = (char*) malloc(*len + 1);
+    char *end = bytes;
+    for (u_int i = 0; i < count; i++) {
+        memcpy(end, buffers[i].buf, buffers[i].len);
+        end += buffers[i].len;
+    }
+    *end = '\0';
+    return bytes;
+}
+
+/*
+ * Frees the template
+ */
+void free_template(REQUEST_TEMPLATE *request) {
+    free(request->start);
+    free(request->version);
+    free(request->rest);
+    free(request);
+}
@@ -0,0 +1,67 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   request.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Request templates built once per run
+ * Every request is the same fixed segments around the path and host,
+ * sent together with one gathering WSASend()
+ * 
+ * Created on October 22, 2026, 6:05 PM
+ */
+
+#ifndef REQUEST_H
+#define REQUEST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+
+#define REQUEST_SEGMENTS 6
+
+// Fixed parts of every request
+typedef struct {
+    char *start; // "GET "
+    u_int start_len;
+    char *version; // " HTTP/1.1\r\nHost: "
+    u_int version_len;
+    char *rest; // end of the Host line, configured headers and the blank line
+    u_int rest_len;
+}REQUEST_TEMPLATE;
+
+REQUEST_TEMPLATE *create_template(const char *method, char **headers, u_int count);
+BOOL send_request(SOCKET s, REQUEST_TEMPLATE *request, char *path, char *host, int port);
+char *format_request(REQUEST_TEMPLATE *request, char *path, char *host, int port, 
+        u_int *len);
+void free_template(REQUEST_TEMPLATE *request);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REQUEST_H */
@@ -0,0 +1,239 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "resultq.h"
+#include "budget.h"
+#include <io.h>
+
+/*
+ * Links the item in as the newest of the queue
+ * Any number of threads may push at once
+ */
+static void push_item(RESULT_WRITER *writer, RESULT_ITEM *item) {
+    item->next = NULL;
+    RESULT_ITEM *prev = (RESULT_ITEM*) InterlockedExchangePointer(
+            (PVOID volatile*) &writer->head, item);
+    // until this store the item can not be reached, it also
+    // publishes the item's text to the writer
+    InterlockedExchangePointer((PVOID volatile*) &prev->next, item);
+}
+
+/*
+ * Reads the link to the item pushed after item, with the
+ * ordering the push published it with
+ */
+static RESULT_ITEM *next_item(RESULT_ITEM *item) {
+    return (RESULT_ITEM*) InterlockedCompareExchangePointer(
+            (PVOID volatile*) &item->next, NULL, NULL);
+}
+
+/*
+ * Unlinks the oldest item of the queue, writer thread only
+ * Returns NULL if the queue is empty, or its oldest item is
+ * still being linked by a worker
+ */
+static RESULT_ITEM *pop_item(RESULT_WRITER *writer) {
+    RESULT_ITEM *tail = writer->tail;
+    RESULT_ITEM *next = next_item(tail);
+    
+    if (tail == &writer->stub) {
+        if (!next) return NULL;
+        writer->tail = next;
+        tail = next;
+        next = next_item(next);
+    }
+    if (next) {
+        writer->tail = next;
+        return tail;
+    }
+    if (tail != writer->head) return NULL;
+    // tail is the last item, the stub goes behind it so it can be taken
+    push_item(writer, &writer->stub);
+    next = next_item(tail);
+    if (next) {
+        writer->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+/*
+ * Checks whether everything pushed has been popped
+ */
+static BOOL queue_empty(RESULT_WRITER *writer) {
+    return writer->head == writer->tail;
+}
+
+/*
+ * Hands the gathered results to the output and tells waiting
+ * workers and writer_sync() about them
+ */
+static void write_batch(RESULT_WRITER *writer, u_int *len, LONGLONG *count, LONGLONG *bytes) {
+    if (*len) fwrite(writer->buffer, 1, *len, writer->out);
+    if (queue_empty(writer)) fflush(writer->out);
+    
+    EnterCriticalSection(&writer->lock);
+    writer->written += *count;
+    InterlockedExchangeAdd64(&writer->pending, -*bytes);
+    LeaveCriticalSection(&writer->lock);
+    budget_release(MEM_RESULTS, *bytes);
+    WakeAllConditionVariable(&writer->space);
+    *len = 0;
+    *count = *bytes = 0;
+}
+
+/*
+ * Writer thread
+ * Copies results into the buffer until it is full or the queue is
+ * drained, then writes the buffer out at once
+ * Stops once stop_writer() was called and the queue is empty
+ */
+static DWORD WINAPI writer_main(LPVOID param) {
+    RESULT_WRITER *writer = (RESULT_WRITER*) param;
+    LONGLONG count = 0, bytes = 0;
+    u_int len = 0;
+    
+    while (TRUE) {
+        RESULT_ITEM *item = pop_item(writer);
+        if (item) {
+            if (len + item->len > WRITER_BUFFER) write_batch(writer, &len, &count, &bytes);
+            if (item->len > WRITER_BUFFER) fwrite(item + 1, 1, item->len, writer->out);
+            else {
+                memcpy(writer->buffer + len, item + 1, item->len);
+                len += item->len;
+            }
+            count++;
+            bytes += item->len;
+            free(item);
+            continue;
+        }
+        if (count) {
+            write_batch(writer, &len, &count, &bytes);
+            continue;
+        }
+        
+        EnterCriticalSection(&writer->lock);
+        if (writer->stopping && queue_empty(writer)) {
+            LeaveCriticalSection(&writer->lock);
+            break;
+        }
+        InterlockedExchange(&writer->sleeping, 1);
+        if (queue_empty(writer)) {
+            SleepConditionVariableCS(&writer->ready, &writer->lock, WRITER_IDLE_MS);
+        }
+        InterlockedExchange(&writer->sleeping, 0);
+        LeaveCriticalSection(&writer->lock);
+    }
+    return 0;
+}
+
+/*
+ * Starts the writer thread for out
+ * Returns NULL if the thread can not be created
+ */
+RESULT_WRITER *start_writer(FILE *out) {
+    RESULT_WRITER *writer = (RESULT_WRITER*) calloc(1, sizeof(RESULT_WRITER));
+    writer->out = out;
+    writer->head = writer->tail = &writer->stub;
+    writer->buffer = (char*) malloc(WRITER_BUFFER);
+    InitializeCriticalSection(&writer->lock);
+    InitializeConditionVariable(&writer->ready);
+    InitializeConditionVariable(&writer->space);
+    
+    writer->thread = CreateThread(NULL, 0, writer_main, writer, 0, NULL);
+    if (!writer->thread) {
+        printf("Could not create writer thread\n");
+        free(writer->buffer);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+/*
+ * Queues head followed by body to be written as one piece
+ * Waits first if the writer is too far behind
+ */
+void writer_push(RESULT_WRITER *writer, const char *head, const char *body) {
+    u_int head_len = strlen(head), body_len = strlen(body);
+    
+    if (writer->pending > WRITER_PENDING_MAX) {
+        EnterCriticalSection(&writer->lock);
+        while (writer->pending > WRITER_PENDING_MAX) {
+            SleepConditionVariableCS(&writer->space, &writer->lock, INFINITE);
+        }
+        LeaveCriticalSection(&writer->lock);
+    }
+    RESULT_ITEM *item = (RESULT_ITEM*) malloc(sizeof(RESULT_ITEM) + head_len + body_len);
+    item->len = head_len + body_len;
+    memcpy(item + 1, head, head_len);
+    memcpy((char*) (item + 1) + head_len, body, body_len);
+    InterlockedExchangeAdd64(&writer->pending, item->len);
+    budget_charge(MEM_RESULTS, item->len);
+    InterlockedExchangeAdd64(&writer->pushed, 1);
+    push_item(writer, item);
+    
+    // the lock orders this wake after the writer's last look at the queue
+    if (writer->sleeping) {
+        EnterCriticalSection(&writer->lock);
+        LeaveCriticalSection(&writer->lock);
+        WakeConditionVariable(&writer->ready);
+    }
+}
+
+/*
+ * Waits until every result pushed so far is written, then forces
+ * the output to disk
+ * Returns FALSE if the output can not be flushed
+ */
+BOOL writer_sync(RESULT_WRITER *writer) {
+    LONGLONG target = writer->pushed;
+    
+    EnterCriticalSection(&writer->lock);
+    while (writer->written < target) {
+        WakeConditionVariable(&writer->ready);
+        SleepConditionVariableCS(&writer->space, &writer->lock, WRITER_IDLE_MS);
+    }
+    LeaveCriticalSection(&writer->lock);
+    if (fflush(writer->out) != 0) return FALSE;
+    _commit(_fileno(writer->out));
+    return TRUE;
+}
+
+/*
+ * Writes out every queued result and stops the writer thread
+ * The output is left open
+ */
+void stop_writer(RESULT_WRITER *writer) {
+    EnterCriticalSection(&writer->lock);
+    writer->stopping = TRUE;
+    LeaveCriticalSection(&writer->lock);
+    WakeConditionVariable(&writer->ready);
+    WaitForSingleObject(writer->thread, INFINITE);
+    CloseHandle(writer->thread);
+    fflush(writer->out);
+    free(writer->buffer);
+    free(writer);
+}
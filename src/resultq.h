@@ -0,0 +1,84 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   resultq.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Results of the monitor and batch workers, written by one thread
+ * Workers push finished results onto a lock free multi producer, single
+ * consumer queue and go back to probing, the writer thread drains it
+ * into large buffered writes
+ * Queued bytes are capped, workers wait for the writer past the cap
+ * 
+ * Created on October 25, 2026, 10:20 AM
+ */
+
+#ifndef RESULTQ_H
+#define RESULTQ_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+
+#define WRITER_BUFFER (256 << 10) // results gathered into one write
+#define WRITER_PENDING_MAX (8 << 20) // queued bytes before workers wait
+#define WRITER_IDLE_MS 1000 // longest sleep of the writer without results
+
+// Result waiting to be written, its text follows
+typedef struct RESULT_ITEM {
+    struct RESULT_ITEM * volatile next;
+    u_int len;
+}RESULT_ITEM;
+
+// Queue of results and the thread writing them
+typedef struct {
+    FILE *out;
+    RESULT_ITEM * volatile head; // pushed last, workers swap themselves in
+    RESULT_ITEM *tail; // popped next, writer thread only
+    RESULT_ITEM stub; // keeps the queue from ever being empty of items
+    volatile LONGLONG pending; // bytes pushed and not written yet
+    volatile LONGLONG pushed; // results pushed
+    LONGLONG written; // results handed to out, under lock
+    volatile LONG sleeping; // writer is waiting on ready
+    BOOL stopping;
+    char *buffer; // WRITER_BUFFER bytes
+    HANDLE thread;
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE ready; // results were pushed
+    CONDITION_VARIABLE space; // results were written
+}RESULT_WRITER;
+
+RESULT_WRITER *start_writer(FILE *out);
+void writer_push(RESULT_WRITER *writer, const char *head, const char *body);
+BOOL writer_sync(RESULT_WRITER *writer);
+void stop_writer(RESULT_WRITER *writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RESULTQ_H */
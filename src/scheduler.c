@@ -0,0 +1,210 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "scheduler.h"
+
+/*
+ * Resets the given list head to an empty circular list
+ */
+static void init_list(TIMER *head) {
+    head->next = head;
+    head->prev = head;
+}
+
+/*
+ * Links the given timer at the end of the list
+ */
+static void link_timer(TIMER *head, TIMER *timer) {
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+/*
+ * Removes the timer from whichever list it is in
+ */
+static void unlink_timer(TIMER *timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+/*
+ * Finds the slot for the timer relative to wheel->now
+ * A timer due now goes to the current slot, which is only still
+ * to be processed while wheel_advance() cascades into it
+ * Timers too far in the future are clamped to the last level
+ */
+static void place_timer(TIMING_WHEEL *wheel, TIMER *timer) {
+    TICK at = timer->expires;
+    if (at < wheel->now) at = wheel->now;
+    TICK delta = at - wheel->now;
+    int level = 0;
+    
+    while (level < WHEEL_LEVELS - 1 && 
+            delta >= ((TICK) 1 << (WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    if (delta >= ((TICK) 1 << (WHEEL_BITS * WHEEL_LEVELS))) {
+        at = wheel->now + ((TICK) 1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+    }
+    link_timer(&wheel->slots[level][(at >> (WHEEL_BITS * level)) & WHEEL_MASK], 
+            timer);
+}
+
+/*
+ * Moves every timer in the given slot down to the lower levels
+ */
+static void cascade(TIMING_WHEEL *wheel, int level, u_int index) {
+    TIMER *head = &wheel->slots[level][index];
+    TIMER *timer = head->next;
+    init_list(head);
+    while (timer != head) {
+        TIMER *next = timer->next;
+        place_timer(wheel, timer);
+        timer = next;
+    }
+}
+
+/*
+ * Creates and returns an empty timing wheel
+ * param now - tick the wheel starts from
+ */
+TIMING_WHEEL *create_wheel(TICK now) {
+    TIMING_WHEEL *wheel = (TIMING_WHEEL*) malloc(sizeof(TIMING_WHEEL));
+    if (!wheel) return NULL;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        for (int i = 0; i < WHEEL_SLOTS; i++) {
+            init_list(&wheel->slots[level][i]);
+        }
+    }
+    wheel->now = now;
+    wheel->count = 0;
+    wheel->seed = (unsigned long long) now * 0x9E3779B97F4A7C15ULL + 1;
+    return wheel;
+}
+
+/*
+ * Frees the wheel, timers belong to the caller
+ */
+void free_wheel(TIMING_WHEEL *wheel) {
+    if (wheel) free(wheel);
+}
+
+/*
+ * Prepares a timer that is not scheduled yet
+ */
+void init_timer(TIMER *timer, void *data) {
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->expires = 0;
+    timer->data = data;
+}
+
+/*
+ * Schedules the timer to fire at the given absolute tick
+ * Timers that are already due go to the next tick, the slot
+ * of the current one has been processed
+ * A timer that is already scheduled is moved
+ * Constant time
+ */
+void wheel_schedule(TIMING_WHEEL *wheel, TIMER *timer, TICK expires) {
+    if (timer->prev) unlink_timer(timer);
+    else wheel->count++;
+    if (expires <= wheel->now) expires = wheel->now + 1;
+    timer->expires = expires;
+    place_timer(wheel, timer);
+}
+
+/*
+ * Removes a scheduled timer from the wheel
+ * Does nothing if the timer is not scheduled
+ */
+void wheel_cancel(TIMING_WHEEL *wheel, TIMER *timer) {
+    if (!timer->prev) return;
+    unlink_timer(timer);
+    wheel->count--;
+}
+
+/*
+ * Advances the wheel up to the given tick
+ * Returns the expired timers as a NULL terminated chain through 'next'
+ * Expired timers are no longer scheduled, caller must save
+ * timer->next before scheduling it again
+ */
+TIMER *wheel_advance(TIMING_WHEEL *wheel, TICK to) {
+    TIMER *expired = NULL;
+    TIMER *last = NULL;
+    
+    while (wheel->now < to) {
+        if (!wheel->count) {
+            wheel->now = to;
+            break;
+        }
+        wheel->now++;
+        
+        for (int level = 1; level < WHEEL_LEVELS; level++) {
+            if ((wheel->now >> (WHEEL_BITS * (level - 1))) & WHEEL_MASK) break;
+            cascade(wheel, level, 
+                    (wheel->now >> (WHEEL_BITS * level)) & WHEEL_MASK);
+        }
+        
+        TIMER *head = &wheel->slots[0][wheel->now & WHEEL_MASK];
+        while (head->next != head) {
+            TIMER *timer = head->next;
+            unlink_timer(timer);
+            wheel->count--;
+            if (last) last->next = timer;
+            else expired = timer;
+            last = timer;
+        }
+    }
+    return expired;
+}
+
+/*
+ * Returns the interval with +/- percent random jitter applied
+ * Never returns less than one tick
+ */
+TICK jitter_ticks(TIMING_WHEEL *wheel, TICK interval, u_int percent) {
+    TICK spread = interval * percent / 100;
+    // xorshift64*
+    wheel->seed ^= wheel->seed >> 12;
+    wheel->seed ^= wheel->seed << 25;
+    wheel->seed ^= wheel->seed >> 27;
+    TICK r = (wheel->seed * 0x2545F4914F6CDD1DULL) >> 11;
+    
+    TICK out = interval - spread + (spread ? r % (spread * 2 + 1) : 0);
+    return out ? out : 1;
+}
+
+/*
+ * Returns the current time in wheel ticks
+ */
+TICK current_tick(void) {
+    return (TICK) GetTickCount64() / WHEEL_TICK_MS;
+}
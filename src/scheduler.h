@@ -0,0 +1,81 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   scheduler.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Hierarchical timing wheel used by the monitor (daemon) mode
+ * to schedule the next probe of every url
+ * 
+ * Created on October 19, 2026, 9:12 AM
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+
+#define WHEEL_TICK_MS 100 // resolution of a single wheel tick
+#define WHEEL_BITS 8
+#define WHEEL_SLOTS (1 << WHEEL_BITS) // slots per level
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4 // 2^32 ticks, more than 13 years at 100ms
+
+typedef unsigned long long TICK;
+
+// Timer node, embedded into the caller's own struct
+typedef struct TIMER {
+    struct TIMER *next;
+    struct TIMER *prev;
+    TICK expires;
+    void *data;
+}TIMER;
+
+// Wheel of list heads, one list per slot per level
+typedef struct {
+    TIMER slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    TICK now;
+    u_int count;
+    unsigned long long seed; // state of the jitter generator
+}TIMING_WHEEL;
+
+TIMING_WHEEL *create_wheel(TICK now);
+void free_wheel(TIMING_WHEEL *wheel);
+void init_timer(TIMER *timer, void *data);
+void wheel_schedule(TIMING_WHEEL *wheel, TIMER *timer, TICK expires);
+void wheel_cancel(TIMING_WHEEL *wheel, TIMER *timer);
+TIMER *wheel_advance(TIMING_WHEEL *wheel, TICK to);
+TICK jitter_ticks(TIMING_WHEEL *wheel, TICK interval, u_int percent);
+TICK current_tick(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCHEDULER_H */
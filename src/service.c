@@ -0,0 +1,213 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "service.h"
+
+// A client connection handed to its thread
+typedef struct {
+    SERVICE *service;
+    SOCKET s;
+}SERVICE_CLIENT;
+
+/*
+ * Sends the whole text
+ * Returns FALSE if the client went away
+ */
+static BOOL send_all(SOCKET s, const char *text, u_int len) {
+    while (len) {
+        int sent = send(s, text, len, 0);
+        if (sent <= 0) return FALSE;
+        text += sent;
+        len -= sent;
+    }
+    return TRUE;
+}
+
+/*
+ * Answers one request line
+ * quit closes the connection, shutdown stops the whole service,
+ * anything else goes to the handler
+ * Returns FALSE if the connection should be closed
+ */
+static BOOL serve_line(SERVICE *service, SOCKET s, char *line) {
+    if (!line[0]) return TRUE;
+    if (strcmp(line, "quit") == 0) return FALSE;
+    if (strcmp(line, "shutdown") == 0) {
+        InterlockedExchange(&service->stopping, 1);
+        send_all(s, "{\"status\":\"stopping\"}\n", 22);
+        return FALSE;
+    }
+    char *reply = service->handler(line);
+    BOOL sent = send_all(s, reply, strlen(reply));
+    free(reply);
+    return sent;
+}
+
+/*
+ * Thread serving one client connection until it closes, sends quit
+ * or the service stops
+ * A stop is noticed within SERVICE_POLL_MS between requests
+ * Requests are split on newlines, a trailing CR is dropped
+ */
+static DWORD WINAPI serve_client(LPVOID param) {
+    SERVICE_CLIENT *client = (SERVICE_CLIENT*) param;
+    SERVICE *service = client->service;
+    SOCKET s = client->s;
+    char *buffer = (char*) malloc(SERVICE_LINE_MAX);
+    u_int len = 0;
+    BOOL open = TRUE;
+    free(client);
+    
+    while (open && !service->stopping) {
+        // a recv() already waiting is not woken by shutdown() on every
+        // system, so wait in steps and check for a stop between them
+        fd_set ready;
+        struct timeval wait;
+        FD_ZERO(&ready);
+        FD_SET(s, &ready);
+        wait.tv_sec = 0;
+        wait.tv_usec = SERVICE_POLL_MS * 1000;
+        int found = select((int) s + 1, &ready, NULL, NULL, &wait);
+        if (found < 0) break;
+        if (!found) continue;
+        
+        int got = recv(s, buffer + len, SERVICE_LINE_MAX - len, 0);
+        if (got <= 0) break;
+        len += got;
+        
+        char *line = buffer, *end;
+        while (open && (end = memchr(line, '\n', buffer + len - line)) != NULL) {
+            *end = '\0';
+            if (end > line && end[-1] == '\r') end[-1] = '\0';
+            open = serve_line(service, s, line);
+            line = end + 1;
+        }
+        len -= line - buffer;
+        memmove(buffer, line, len);
+        if (len == SERVICE_LINE_MAX) {
+            send_all(s, "{\"error\":\"request line too long\"}\n", 34);
+            break;
+        }
+    }
+    free(buffer);
+    
+    EnterCriticalSection(&service->lock);
+    for (u_int i = 0; i < service->client_count; i++) {
+        if (service->clients[i] == s) {
+            service->clients[i] = service->clients[--service->client_count];
+            break;
+        }
+    }
+    closesocket(s);
+    WakeAllConditionVariable(&service->left);
+    LeaveCriticalSection(&service->lock);
+    return 0;
+}
+
+/*
+ * Starts a thread for a new client connection, or turns it away
+ * when SERVICE_CLIENTS_MAX are already served
+ */
+static void add_client(SERVICE *service, SOCKET s) {
+    EnterCriticalSection(&service->lock);
+    if (service->client_count == SERVICE_CLIENTS_MAX) {
+        LeaveCriticalSection(&service->lock);
+        send_all(s, "{\"error\":\"too many clients\"}\n", 29);
+        closesocket(s);
+        return;
+    }
+    SERVICE_CLIENT *client = (SERVICE_CLIENT*) malloc(sizeof(SERVICE_CLIENT));
+    client->service = service;
+    client->s = s;
+    HANDLE thread = CreateThread(NULL, 0, serve_client, client, 0, NULL);
+    if (thread) {
+        service->clients[service->client_count++] = s;
+        CloseHandle(thread);
+    } else {
+        printf("Could not create client thread\n");
+        free(client);
+        closesocket(s);
+    }
+    LeaveCriticalSection(&service->lock);
+}
+
+/*
+ * Serves probe requests on 127.0.0.1:port until a client asks for
+ * shutdown, then waits for the connections still open to finish
+ * their current request
+ * tick is called about every SERVICE_POLL_MS, NULL for none
+ * Returns FALSE if the port can not be listened on
+ */
+BOOL run_service(int port, SERVICE_HANDLER handler, SERVICE_TICK tick) {
+    SERVICE service;
+    struct sockaddr_in address;
+    int on = 1;
+    
+    memset(&service, 0, sizeof(SERVICE));
+    service.handler = handler;
+    service.listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (service.listener == INVALID_SOCKET) {
+        printf("Could not create socket : %d\n", WSAGetLastError());
+        return FALSE;
+    }
+    setsockopt(service.listener, SOL_SOCKET, SO_REUSEADDR, (char*) &on, sizeof(on));
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (bind(service.listener, (struct sockaddr*) &address, sizeof(address)) != 0 ||
+            listen(service.listener, SOMAXCONN) != 0) {
+        printf("Unable to listen on 127.0.0.1:%d : %d\n", port, WSAGetLastError());
+        closesocket(service.listener);
+        return FALSE;
+    }
+    InitializeCriticalSection(&service.lock);
+    InitializeConditionVariable(&service.left);
+    printf("Serving probe requests on 127.0.0.1:%d\n", port);
+    
+    while (!service.stopping) {
+        fd_set ready;
+        struct timeval wait;
+        FD_ZERO(&ready);
+        FD_SET(service.listener, &ready);
+        wait.tv_sec = 0;
+        wait.tv_usec = SERVICE_POLL_MS * 1000;
+        if (tick) tick();
+        if (select((int) service.listener + 1, &ready, NULL, NULL, &wait) <= 0) continue;
+        
+        SOCKET s = accept(service.listener, NULL, NULL);
+        if (s != INVALID_SOCKET) add_client(&service, s);
+    }
+    closesocket(service.listener);
+    
+    // clients waiting for a request leave at their next poll, the
+    // others still finish and answer the one they are serving
+    EnterCriticalSection(&service.lock);
+    while (service.client_count) SleepConditionVariableCS(&service.left, &service.lock, INFINITE);
+    LeaveCriticalSection(&service.lock);
+    DeleteCriticalSection(&service.lock);
+    printf("Service stopped\n");
+    return TRUE;
+}
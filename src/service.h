@@ -0,0 +1,73 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   service.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Resident service answering probe requests on a loopback port
+ * Clients send one request per line and get one reply line back,
+ * each connection is served by its own thread and may send any
+ * number of requests
+ * 
+ * Created on October 26, 2026, 2:15 PM
+ */
+
+#ifndef SERVICE_H
+#define SERVICE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+
+#define SERVICE_LINE_MAX 8192 // longest request line
+#define SERVICE_CLIENTS_MAX 64 // connections served at once
+#define SERVICE_POLL_MS 500 // the listener and clients check for shutdown this often
+
+// Answers a request line, without its newline, with a reply line ending in one
+typedef char *(*SERVICE_HANDLER)(char *line);
+
+// Called every SERVICE_POLL_MS from the listening thread
+typedef void (*SERVICE_TICK)(void);
+
+// Listener and the connections being served
+typedef struct {
+    SOCKET listener;
+    SERVICE_HANDLER handler;
+    SOCKET clients[SERVICE_CLIENTS_MAX];
+    u_int client_count;
+    volatile LONG stopping; // set by a shutdown request
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE left; // a client connection was closed
+}SERVICE;
+
+BOOL run_service(int port, SERVICE_HANDLER handler, SERVICE_TICK tick);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERVICE_H */
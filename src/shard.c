@@ -0,0 +1,186 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "shard.h"
+
+// Result block found in a shard stream
+typedef struct {
+    u_int line;
+    u_int file;
+    const char *start;
+    ULONGLONG len;
+}MERGE_BLOCK;
+
+/*
+ * FNV-1a of the lower case string, finished with the murmur3 mixer
+ * so that similar names land far apart on the ring
+ */
+static u_int ring_hash(const char *str) {
+    u_int hash = 2166136261u;
+    for (; *str; str++) {
+        char c = *str;
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        hash ^= (unsigned char) c;
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/*
+ * Orders ring points by hash, ties by shard so every process
+ * builds the same ring
+ */
+static int compare_points(const void *a, const void *b) {
+    const RING_POINT *x = (const RING_POINT*) a;
+    const RING_POINT *y = (const RING_POINT*) b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return x->shard < y->shard ? -1 : x->shard > y->shard;
+}
+
+/*
+ * Creates the ring for the given number of shards
+ */
+SHARD_RING *create_ring(u_int shards) {
+    SHARD_RING *ring = (SHARD_RING*) malloc(sizeof(SHARD_RING));
+    char name[32];
+    
+    ring->shards = shards;
+    ring->count = shards * RING_REPLICAS;
+    ring->points = (RING_POINT*) malloc(sizeof(RING_POINT) * ring->count);
+    for (u_int shard = 0; shard < shards; shard++) {
+        for (u_int i = 0; i < RING_REPLICAS; i++) {
+            snprintf(name, 32, "shard-%u-%u", shard, i);
+            ring->points[shard * RING_REPLICAS + i].hash = ring_hash(name);
+            ring->points[shard * RING_REPLICAS + i].shard = shard;
+        }
+    }
+    qsort(ring->points, ring->count, sizeof(RING_POINT), compare_points);
+    return ring;
+}
+
+/*
+ * Returns the shard owning the host, the first point at or after
+ * the host's hash going round the ring
+ */
+u_int ring_shard(SHARD_RING *ring, const char *host) {
+    u_int hash = ring_hash(host);
+    u_int low = 0, high = ring->count;
+    while (low < high) {
+        u_int mid = low + (high - low) / 2;
+        if (ring->points[mid].hash < hash) low = mid + 1;
+        else high = mid;
+    }
+    return ring->points[low == ring->count ? 0 : low].shard;
+}
+
+/*
+ * Frees the ring
+ */
+void free_ring(SHARD_RING *ring) {
+    free(ring->points);
+    free(ring);
+}
+
+/*
+ * Orders blocks by list line, then by shard file and position
+ * so repeated probes of a line keep their order
+ */
+static int compare_blocks(const void *a, const void *b) {
+    const MERGE_BLOCK *x = (const MERGE_BLOCK*) a;
+    const MERGE_BLOCK *y = (const MERGE_BLOCK*) b;
+    if (x->line != y->line) return x->line < y->line ? -1 : 1;
+    if (x->file != y->file) return x->file < y->file ? -1 : 1;
+    return x->start < y->start ? -1 : x->start > y->start;
+}
+
+/*
+ * Merges shard result streams into one report in list order
+ * Only the position of each block is kept in memory, the
+ * streams themselves are read through mapped views
+ * Returns FALSE if a file can not be read or written
+ */
+BOOL merge_shards(const char *out_file, char **files, u_int count) {
+    MAPPED_FILE *maps = (MAPPED_FILE*) calloc(count, sizeof(MAPPED_FILE));
+    u_int size = 1024, blocks = 0, mapped = 0;
+    MERGE_BLOCK *list = (MERGE_BLOCK*) malloc(sizeof(MERGE_BLOCK) * size);
+    u_int mark_len = strlen(SHARD_MARK);
+    BOOL ok = TRUE;
+    
+    for (; mapped < count && ok; mapped++) {
+        if (!map_file(files[mapped], &maps[mapped])) {
+            printf("unable to read shard stream: %s\n", files[mapped]);
+            ok = FALSE;
+            break;
+        }
+        const char *data = maps[mapped].data, *end = data + maps[mapped].size;
+        const char *pos = data;
+        while (pos < end) {
+            const char *eol = memchr(pos, '\n', end - pos);
+            if (!eol) eol = end;
+            if ((ULONGLONG) (eol - pos) > mark_len && memcmp(pos, SHARD_MARK, mark_len) == 0) {
+                if (blocks && list[blocks - 1].file == mapped) {
+                    list[blocks - 1].len = pos - list[blocks - 1].start;
+                }
+                if (blocks == size) {
+                    size *= 2;
+                    list = (MERGE_BLOCK*) realloc(list, sizeof(MERGE_BLOCK) * size);
+                }
+                list[blocks].line = strtoul(pos + mark_len, NULL, 10);
+                list[blocks].file = mapped;
+                list[blocks].start = eol < end ? eol + 1 : end;
+                list[blocks].len = 0;
+                blocks++;
+            }
+            pos = eol + 1; // text before the first mark is not a result
+        }
+        if (blocks && list[blocks - 1].file == mapped) {
+            list[blocks - 1].len = end - list[blocks - 1].start;
+        }
+    }
+    
+    FILE *out = NULL;
+    if (ok && !(out = fopen(out_file, "w"))) {
+        printf("unable to open output file: %s\n", out_file);
+        ok = FALSE;
+    }
+    if (ok) {
+        qsort(list, blocks, sizeof(MERGE_BLOCK), compare_blocks);
+        for (u_int i = 0; i < blocks; i++) {
+            fwrite(list[i].start, 1, list[i].len, out);
+        }
+        ok = fclose(out) == 0;
+        printf("Merged %u results from %u shards into %s\n", blocks, count, out_file);
+    }
+    
+    for (u_int i = 0; i < mapped; i++) unmap_file(&maps[i]);
+    free(maps);
+    free(list);
+    return ok;
+}
@@ -0,0 +1,73 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   shard.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Splitting url lists between processes by host
+ * Hosts are placed on a consistent hash ring so each host, and with it
+ * its connections and DNS lookups, stays with one shard, and changing
+ * the number of shards only moves the hosts of the shards added or removed
+ * Sharded results carry the list line of each probe so the shard
+ * streams can be merged back into one report in list order
+ * 
+ * Created on October 23, 2026, 3:20 PM
+ */
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+
+#define RING_REPLICAS 128 // points per shard on the ring
+#define SHARD_MARK "#line " // starts every result block of a shard stream
+
+// Point of a shard on the ring
+typedef struct {
+    u_int hash;
+    u_int shard;
+}RING_POINT;
+
+// Consistent hash ring
+typedef struct {
+    RING_POINT *points; // sorted by hash
+    u_int count;
+    u_int shards;
+}SHARD_RING;
+
+SHARD_RING *create_ring(u_int shards);
+u_int ring_shard(SHARD_RING *ring, const char *host);
+void free_ring(SHARD_RING *ring);
+BOOL merge_shards(const char *out_file, char **files, u_int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHARD_H */
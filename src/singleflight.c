@@ -0,0 +1,146 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "singleflight.h"
+
+/*
+ * FNV-1a hash of the key
+ */
+static u_int hash_key(const char *key) {
+    u_int hash = 2166136261u;
+    for (; *key; key++) {
+        hash ^= (unsigned char) *key;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Unlinks the flight from its bucket so new callers start a new fetch
+ * Must be called with the group lock held
+ */
+static void unlist_flight(FLIGHT_GROUP *group, FLIGHT *flight) {
+    FLIGHT **link = &group->buckets[flight->hash & (group->size - 1)];
+    while (*link != flight) link = &(*link)->next;
+    *link = flight->next;
+    flight->listed = FALSE;
+}
+
+/*
+ * Creates an empty group
+ * param size - expected number of fetches in flight at once
+ * param free_result - releases a result once nobody shares it
+ */
+FLIGHT_GROUP *create_flight_group(u_int size, void (*free_result)(void *result)) {
+    FLIGHT_GROUP *group = (FLIGHT_GROUP*) malloc(sizeof(FLIGHT_GROUP));
+    if (!group) return NULL;
+    group->size = 16;
+    while (group->size < size) group->size <<= 1;
+    group->buckets = (FLIGHT**) calloc(group->size, sizeof(FLIGHT*));
+    if (!group->buckets) {
+        free(group);
+        return NULL;
+    }
+    InitializeCriticalSection(&group->lock);
+    group->free_result = free_result;
+    group->shared = 0;
+    return group;
+}
+
+/*
+ * Joins the fetch for the given key, starting it if none is in flight
+ * Sets leader to TRUE if the caller has to fetch and call flight_finish()
+ * otherwise the caller should flight_wait() for the leader's result
+ * Every join must be followed by flight_leave()
+ */
+FLIGHT *flight_join(FLIGHT_GROUP *group, const char *key, BOOL *leader) {
+    u_int hash = hash_key(key);
+    EnterCriticalSection(&group->lock);
+    
+    FLIGHT *flight = group->buckets[hash & (group->size - 1)];
+    while (flight && (flight->hash != hash || strcmp(flight->key, key) != 0)) {
+        flight = flight->next;
+    }
+    if (flight) {
+        flight->refs++;
+        group->shared++;
+        *leader = FALSE;
+    } else {
+        flight = (FLIGHT*) malloc(sizeof(FLIGHT));
+        flight->key = strdup(key);
+        flight->hash = hash;
+        flight->refs = 1;
+        flight->done = FALSE;
+        flight->listed = TRUE;
+        flight->result = NULL;
+        InitializeConditionVariable(&flight->finished);
+        flight->next = group->buckets[hash & (group->size - 1)];
+        group->buckets[hash & (group->size - 1)] = flight;
+        *leader = TRUE;
+    }
+    LeaveCriticalSection(&group->lock);
+    return flight;
+}
+
+/*
+ * Publishes the leader's result and wakes up every waiting caller
+ */
+void flight_finish(FLIGHT_GROUP *group, FLIGHT *flight, void *result) {
+    EnterCriticalSection(&group->lock);
+    flight->result = result;
+    flight->done = TRUE;
+    unlist_flight(group, flight);
+    LeaveCriticalSection(&group->lock);
+    WakeAllConditionVariable(&flight->finished);
+}
+
+/*
+ * Waits until the leader publishes its result and returns it
+ * Result stays valid until the caller leaves the flight
+ */
+void *flight_wait(FLIGHT_GROUP *group, FLIGHT *flight) {
+    EnterCriticalSection(&group->lock);
+    while (!flight->done) {
+        SleepConditionVariableCS(&flight->finished, &group->lock, INFINITE);
+    }
+    LeaveCriticalSection(&group->lock);
+    return flight->result;
+}
+
+/*
+ * Drops the caller's reference, last one frees the flight and result
+ */
+void flight_leave(FLIGHT_GROUP *group, FLIGHT *flight) {
+    EnterCriticalSection(&group->lock);
+    BOOL last = (--flight->refs == 0);
+    if (last && flight->listed) unlist_flight(group, flight);
+    LeaveCriticalSection(&group->lock);
+    
+    if (last) {
+        if (flight->result && group->free_result) group->free_result(flight->result);
+        free(flight->key);
+        free(flight);
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   singleflight.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Coalesces identical fetches that are in flight at the same time
+ * The first caller of a key fetches, later callers wait and share
+ * its result. Finished fetches are forgotten, this is not a cache.
+ * 
+ * Created on October 19, 2026, 5:05 PM
+ */
+
+#ifndef SINGLEFLIGHT_H
+#define SINGLEFLIGHT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+
+// A fetch in progress and the callers sharing it
+typedef struct FLIGHT {
+    struct FLIGHT *next; // bucket chain
+    char *key;
+    u_int hash;
+    u_int refs; // leader plus waiting callers
+    BOOL done;
+    BOOL listed; // still reachable from the table
+    void *result;
+    CONDITION_VARIABLE finished;
+}FLIGHT;
+
+// Table of fetches in progress
+typedef struct {
+    FLIGHT **buckets;
+    u_int size; // power of 2
+    CRITICAL_SECTION lock;
+    void (*free_result)(void *result);
+    u_int shared; // fetches saved so far
+}FLIGHT_GROUP;
+
+FLIGHT_GROUP *create_flight_group(u_int size, void (*free_result)(void *result));
+FLIGHT *flight_join(FLIGHT_GROUP *group, const char *key, BOOL *leader);
+void flight_finish(FLIGHT_GROUP *group, FLIGHT *flight, void *result);
+void *flight_wait(FLIGHT_GROUP *group, FLIGHT *flight);
+void flight_leave(FLIGHT_GROUP *group, FLIGHT *flight);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SINGLEFLIGHT_H */
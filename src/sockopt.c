@@ -0,0 +1,180 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "sockopt.h"
+
+// Windows 10 names, missing from older headers
+#ifndef TCP_FASTOPEN
+#define TCP_FASTOPEN 15
+#endif
+#ifndef SO_REUSE_UNICASTPORT
+#define SO_REUSE_UNICASTPORT 0x3007
+#endif
+#ifndef SIO_TCP_INFO
+#define SIO_TCP_INFO _WSAIORW(IOC_VENDOR, 39)
+#endif
+
+// TCP_INFO_v0 of mstcpip.h, Windows 10 1703 and later
+typedef struct {
+    int state;
+    u_int mss;
+    ULONGLONG connection_ms;
+    unsigned char timestamps;
+    u_int rtt_us;
+    u_int min_rtt_us;
+    u_int bytes_in_flight;
+    u_int cwnd;
+    u_int send_window;
+    u_int receive_window;
+    u_int receive_buffer;
+    ULONGLONG bytes_out;
+    ULONGLONG bytes_in;
+    u_int bytes_reordered;
+    u_int bytes_retransmitted;
+    u_int fast_retransmits;
+    u_int duplicate_acks;
+    u_int timeouts;
+    unsigned char syn_retransmits;
+}KERNEL_TCP_INFO;
+
+// Options that may be refused, each is warned about on its own
+enum {OPT_NODELAY, OPT_FASTOPEN, OPT_LINGER, OPT_UNICASTPORT, OPT_TCP_INFO, OPT_COUNT};
+
+static const char *option_names[OPT_COUNT] = {
+    "TCP_NODELAY", "TCP_FASTOPEN", "SO_LINGER", "SO_REUSE_UNICASTPORT", "SIO_TCP_INFO"
+};
+static volatile LONG warned[OPT_COUNT];
+
+/*
+ * Reports a socket option the system refused, only the first time
+ */
+static void warn_option(int option) {
+    if (InterlockedExchange(&warned[option], 1) == 0) {
+        printf("Socket option %s not supported here (%d), carrying on without it\n", 
+                option_names[option], WSAGetLastError());
+    }
+}
+
+/*
+ * Reads a comma separated list of nodelay, fastopen, quickclose and noport
+ * Returns FALSE on an unknown name
+ */
+BOOL parse_tuning(char *list, SOCKET_TUNING *tuning) {
+    char *copy = strdup(list);
+    BOOL ok = TRUE;
+    for (char *name = strtok(copy, ","); name && ok; 
+            name = strtok(NULL, ",")) {
+        if (strcmp(name, "nodelay") == 0) tuning->nodelay = TRUE;
+        else if (strcmp(name, "fastopen") == 0) tuning->fastopen = TRUE;
+        else if (strcmp(name, "quickclose") == 0) tuning->quick_close = TRUE;
+        else if (strcmp(name, "noport") == 0) tuning->no_port = TRUE;
+        else ok = FALSE;
+    }
+    free(copy);
+    return ok;
+}
+
+/*
+ * Reads a comma separated list of local IPv4 addresses to bind to
+ * Returns FALSE if one is not an address or there are too many
+ */
+BOOL parse_sources(char *list, SOCKET_TUNING *tuning) {
+    char *copy = strdup(list);
+    BOOL ok = TRUE;
+    for (char *addr = strtok(copy, ","); addr && ok; 
+            addr = strtok(NULL, ",")) {
+        u_long ip = inet_addr(addr);
+        ok = ip != INADDR_NONE && tuning->source_count < MAX_SOURCES;
+        if (ok) tuning->sources[tuning->source_count++].s_addr = ip;
+    }
+    free(copy);
+    return ok;
+}
+
+/*
+ * Applies the tuning to a new socket before it connects
+ * Options the system does not know are skipped with a warning,
+ * sources are taken in turn so every address carries its share
+ * of ports
+ * Returns FALSE if the socket could not be bound
+ */
+BOOL tune_socket(SOCKET s, SOCKET_TUNING *tuning) {
+    int on = 1;
+    if (tuning->nodelay && 
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (char*) &on, sizeof(on)) != 0) {
+        warn_option(OPT_NODELAY);
+    }
+    if (tuning->fastopen && 
+            setsockopt(s, IPPROTO_TCP, TCP_FASTOPEN, (char*) &on, sizeof(on)) != 0) {
+        warn_option(OPT_FASTOPEN);
+    }
+    if (tuning->quick_close) {
+        struct linger linger;
+        linger.l_onoff = 1;
+        linger.l_linger = 0;
+        if (setsockopt(s, SOL_SOCKET, SO_LINGER, (char*) &linger, sizeof(linger)) != 0) {
+            warn_option(OPT_LINGER);
+        }
+    }
+    if (!tuning->source_count) return TRUE;
+    
+    if (tuning->no_port && 
+            setsockopt(s, SOL_SOCKET, SO_REUSE_UNICASTPORT, (char*) &on, sizeof(on)) != 0) {
+        warn_option(OPT_UNICASTPORT);
+    }
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = 0;
+    local.sin_addr = tuning->sources[
+            (u_int) InterlockedIncrement(&tuning->next_source) % tuning->source_count];
+    if (bind(s, (struct sockaddr*) &local, sizeof(local)) != 0) {
+        printf("Could not bind to %s : %d\n", inet_ntoa(local.sin_addr), WSAGetLastError());
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Reads the kernel's view of a connected socket, before it is closed
+ * Systems without SIO_TCP_INFO are warned about once
+ * Returns FALSE with stats zeroed if it could not be read
+ */
+BOOL read_tcp_stats(SOCKET s, TCP_STATS *stats) {
+    KERNEL_TCP_INFO info;
+    DWORD version = 0, bytes = 0;
+    
+    memset(stats, 0, sizeof(TCP_STATS));
+    if (WSAIoctl(s, SIO_TCP_INFO, &version, sizeof(version), &info, sizeof(info), &bytes, 
+            NULL, NULL) != 0) {
+        warn_option(OPT_TCP_INFO);
+        return FALSE;
+    }
+    stats->rtt = info.rtt_us;
+    stats->rtt_min = info.min_rtt_us;
+    stats->retransmits = info.fast_retransmits + info.timeouts + info.syn_retransmits;
+    stats->cwnd = info.cwnd;
+    return TRUE;
+}
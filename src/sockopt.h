@@ -0,0 +1,74 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   sockopt.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Options applied to every probe socket, and binding probes
+ * across several local source addresses
+ * 
+ * Created on October 23, 2026, 10:30 AM
+ */
+
+#ifndef SOCKOPT_H
+#define SOCKOPT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+
+#define MAX_SOURCES 16
+
+// Socket tuning chosen on the command line
+typedef struct {
+    BOOL nodelay; // TCP_NODELAY
+    BOOL fastopen; // TCP_FASTOPEN
+    BOOL quick_close; // SO_LINGER 0, reset instead of TIME_WAIT
+    BOOL no_port; // SO_REUSE_UNICASTPORT, port picked at connect
+    struct in_addr sources[MAX_SOURCES];
+    u_int source_count;
+    volatile LONG next_source;
+}SOCKET_TUNING;
+
+// What the kernel knows of a connection, all 0 if it could not be read
+typedef struct {
+    u_int rtt; // smoothed round trip time in microseconds
+    u_int rtt_min; // lowest round trip time seen, the rest of rtt is queueing
+    u_int retransmits; // fast retransmits, timeouts and SYNs sent again
+    u_int cwnd; // congestion window in bytes
+}TCP_STATS;
+
+BOOL parse_tuning(char *list, SOCKET_TUNING *tuning);
+BOOL parse_sources(char *list, SOCKET_TUNING *tuning);
+BOOL tune_socket(SOCKET s, SOCKET_TUNING *tuning);
+BOOL read_tcp_stats(SOCKET s, TCP_STATS *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SOCKOPT_H */
@@ -0,0 +1,258 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "stats.h"
+#include <math.h>
+#include <ctype.h>
+
+/*
+ * FNV-1a 64 of the text, with its bits mixed so that every part
+ * of the hash is usable as register index or counter position
+ */
+static ULONGLONG hash_text(const char *text) {
+    ULONGLONG hash = 14695981039346656037ULL;
+    for (; *text; text++) {
+        hash ^= (unsigned char) *text;
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/*
+ * Allocates an empty summary
+ * Returns NULL on fail
+ */
+RUN_STATS *create_stats(void) {
+    RUN_STATS *stats = (RUN_STATS*) calloc(1, sizeof(RUN_STATS));
+    if (!stats) return NULL;
+    InitializeCriticalSection(&stats->lock);
+    return stats;
+}
+
+/*
+ * Counts one more occurrence of the value
+ * Each row of the sketch takes a counter picked by its own
+ * combination of the two halves of the hash, the estimate is
+ * the lowest of them, as the others also count colliding values
+ * The value replaces the rarest heavy hitter if it beats it
+ */
+static void count_value(HEAVY_HITTERS *hitters, const char *value) {
+    char name[TOP_NAME_MAX];
+    snprintf(name, TOP_NAME_MAX, "%s", value);
+    
+    ULONGLONG hash = hash_text(name);
+    u_int low = (u_int) hash, high = (u_int) (hash >> 32) | 1;
+    u_int estimate = 0;
+    for (u_int row = 0; row < SKETCH_DEPTH; row++) {
+        u_int *counter = &hitters->counts[row][(low + row * high) & (SKETCH_WIDTH - 1)];
+        (*counter)++;
+        if (!row || *counter < estimate) estimate = *counter;
+    }
+    hitters->total++;
+    
+    u_int rarest = 0;
+    for (u_int i = 0; i < hitters->top_count; i++) {
+        if (strcmp(hitters->top[i].name, name) == 0) {
+            hitters->top[i].count = estimate;
+            return;
+        }
+        if (hitters->top[i].count < hitters->top[rarest].count) rarest = i;
+    }
+    if (hitters->top_count < TOP_SIZE) rarest = hitters->top_count++;
+    else if (hitters->top[rarest].count >= estimate) return;
+    strcpy(hitters->top[rarest].name, name);
+    hitters->top[rarest].count = estimate;
+}
+
+/*
+ * Adds the value to the distinct count
+ * The first HLL_BITS bits of its hash pick a register, which keeps
+ * the longest run of leading zeros seen in the remaining bits
+ */
+static void add_distinct(DISTINCT *distinct, const char *value) {
+    ULONGLONG hash = hash_text(value);
+    u_int index = (u_int) (hash >> (64 - HLL_BITS));
+    ULONGLONG rest = hash << HLL_BITS;
+    unsigned char rank = 1;
+    
+    while (rank <= 64 - HLL_BITS && !(rest & (1ULL << 63))) {
+        rest <<= 1;
+        rank++;
+    }
+    if (rank > distinct->registers[index]) distinct->registers[index] = rank;
+}
+
+/*
+ * Estimates how many distinct values were added
+ * Few values leave registers empty, they are then counted from
+ * the share of empty registers instead, which is exact there
+ */
+static ULONGLONG count_distinct(DISTINCT *distinct) {
+    double m = 1 << HLL_BITS, sum = 0;
+    u_int empty = 0;
+    
+    for (u_int i = 0; i < (1 << HLL_BITS); i++) {
+        sum += ldexp(1.0, -distinct->registers[i]);
+        if (!distinct->registers[i]) empty++;
+    }
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (estimate <= 2.5 * m && empty) estimate = m * log(m / empty);
+    return (ULONGLONG) (estimate + 0.5);
+}
+
+/*
+ * Records a hop of a chain
+ * code is 0 if the hop got no reply, host is the host it was sent to
+ * and server and encoding the values of those headers, NULL if absent
+ */
+void stats_hop(RUN_STATS *stats, int code, const char *host, const char *server, 
+        const char *encoding) {
+    char name[TOP_NAME_MAX];
+    u_int i;
+    
+    // hosts are case insensitive
+    for (i = 0; host[i] && i < TOP_NAME_MAX - 1; i++) name[i] = tolower((unsigned char) host[i]);
+    name[i] = '\0';
+    if (code < 0 || code >= STATUS_CODES) code = 0;
+    
+    EnterCriticalSection(&stats->lock);
+    stats->hops++;
+    stats->codes[code]++;
+    add_distinct(&stats->hosts, name);
+    if (code) {
+        count_value(&stats->servers, server ? server : "(none)");
+        count_value(&stats->encodings, encoding ? encoding : "(none)");
+    }
+    LeaveCriticalSection(&stats->lock);
+}
+
+/*
+ * Records a finished chain, after its hops
+ * hops is 0 for a url that could not be parsed, target the
+ * normalized url of its last hop
+ */
+void stats_chain(RUN_STATS *stats, u_int hops, const char *target, BOOL loop, 
+        BOOL too_long) {
+    EnterCriticalSection(&stats->lock);
+    stats->chains++;
+    if (!hops) stats->invalid++;
+    if (loop) stats->loops++;
+    if (too_long) stats->too_long++;
+    stats->lengths[hops < CHAIN_BUCKETS ? hops : CHAIN_BUCKETS - 1]++;
+    if (hops) add_distinct(&stats->targets, target);
+    LeaveCriticalSection(&stats->lock);
+}
+
+/*
+ * Orders heavy hitters most common first
+ */
+static int compare_top(const void *a, const void *b) {
+    ULONGLONG x = ((const TOP_ENTRY*) a)->count, y = ((const TOP_ENTRY*) b)->count;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/*
+ * Prints the heavy hitters of a sketch with their share of all values
+ */
+static void print_top(HEAVY_HITTERS *hitters, const char *title, FILE *out) {
+    TOP_ENTRY top[TOP_SIZE];
+    memcpy(top, hitters->top, sizeof(TOP_ENTRY) * hitters->top_count);
+    qsort(top, hitters->top_count, sizeof(TOP_ENTRY), compare_top);
+    
+    fprintf(out, "\nTop %s values (estimated):\n", title);
+    for (u_int i = 0; i < hitters->top_count; i++) {
+        fprintf(out, "    %-40s %12llu %6.2f%%\n", top[i].name, 
+                (unsigned long long) top[i].count, 100.0 * top[i].count / hitters->total);
+    }
+}
+
+/*
+ * Prints the summary tables
+ */
+void print_stats(RUN_STATS *stats, FILE *out) {
+    EnterCriticalSection(&stats->lock);
+    ULONGLONG chains = stats->chains ? stats->chains : 1, hops = stats->hops ? stats->hops : 1;
+    
+    fprintf(out, "Run summary\n\n");
+    fprintf(out, "Urls probed: %llu\n", (unsigned long long) stats->chains);
+    fprintf(out, "Invalid urls: %llu\n", (unsigned long long) stats->invalid);
+    fprintf(out, "Redirect loops: %llu\n", (unsigned long long) stats->loops);
+    fprintf(out, "Chains cut at the hop limit: %llu\n", (unsigned long long) stats->too_long);
+    fprintf(out, "Hops made: %llu\n", (unsigned long long) stats->hops);
+    
+    fprintf(out, "\nStatus codes:\n");
+    for (u_int i = 0; i < STATUS_CODES; i++) {
+        if (!stats->codes[i]) continue;
+        if (i) fprintf(out, "    %-40u", i);
+        else fprintf(out, "    %-40s", "no reply");
+        fprintf(out, " %12llu %6.2f%%\n", (unsigned long long) stats->codes[i], 
+                100.0 * stats->codes[i] / hops);
+    }
+    
+    fprintf(out, "\nRedirect chain length (hops):\n");
+    for (u_int i = 1; i < CHAIN_BUCKETS; i++) {
+        if (!stats->lengths[i]) continue;
+        char label[16];
+        snprintf(label, 16, i == CHAIN_BUCKETS - 1 ? "%u+" : "%u", i);
+        fprintf(out, "    %-40s %12llu %6.2f%%\n", label, 
+                (unsigned long long) stats->lengths[i], 100.0 * stats->lengths[i] / chains);
+    }
+    
+    print_top(&stats->servers, "Server", out);
+    print_top(&stats->encodings, "Content-Encoding", out);
+    
+    fprintf(out, "\nDistinct hosts (estimated): %llu\n", 
+            (unsigned long long) count_distinct(&stats->hosts));
+    fprintf(out, "Distinct final targets (estimated): %llu\n", 
+            (unsigned long long) count_distinct(&stats->targets));
+    LeaveCriticalSection(&stats->lock);
+}
+
+/*
+ * Writes the summary tables over the file
+ * Returns FALSE if the file could not be written
+ */
+BOOL write_stats(RUN_STATS *stats, const char *file) {
+    FILE *out = fopen(file, "w");
+    if (!out) {
+        printf("unable to write summary file: %s\n", file);
+        return FALSE;
+    }
+    print_stats(stats, out);
+    return fclose(out) == 0;
+}
+
+/*
+ * Frees the summary
+ */
+void free_stats(RUN_STATS *stats) {
+    DeleteCriticalSection(&stats->lock);
+    free(stats);
+}
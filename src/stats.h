@@ -0,0 +1,103 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   stats.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Summary of a whole run built as chains finish, in fixed memory
+ * Status codes and chain lengths are counted exactly, the most common
+ * Server and Content-Encoding values come from count-min sketches and
+ * distinct hosts and final targets from HyperLogLog registers
+ * 
+ * Created on October 25, 2026, 3:40 PM
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+
+#define SKETCH_DEPTH 4 // rows of a count-min sketch
+#define SKETCH_WIDTH 4096 // counters per row, power of 2
+#define TOP_SIZE 10 // heavy hitters kept per sketch
+#define TOP_NAME_MAX 64 // longer values are cut to this
+#define HLL_BITS 14 // 2^14 registers, about 0.8% standard error
+#define STATUS_CODES 1000 // 0 counts hops that got no reply
+#define CHAIN_BUCKETS 32 // the last one counts every longer chain
+#define STATS_PERIOD_MS 60000 // monitor mode rewrites its summary this often
+
+// Value among the most common of a sketch
+typedef struct {
+    char name[TOP_NAME_MAX];
+    ULONGLONG count; // estimated, never below the true count
+}TOP_ENTRY;
+
+// Count-min sketch and the values it rates highest
+typedef struct {
+    u_int counts[SKETCH_DEPTH][SKETCH_WIDTH];
+    ULONGLONG total;
+    TOP_ENTRY top[TOP_SIZE];
+    u_int top_count;
+}HEAVY_HITTERS;
+
+// HyperLogLog registers, each the longest run of leading zeros seen + 1
+typedef struct {
+    unsigned char registers[1 << HLL_BITS];
+}DISTINCT;
+
+// Summary of every chain probed so far, shared by all workers
+typedef struct {
+    ULONGLONG chains;
+    ULONGLONG hops;
+    ULONGLONG invalid; // urls that could not be parsed
+    ULONGLONG loops; // chains that redirected back to an earlier url
+    ULONGLONG too_long; // chains cut at the hop limit
+    ULONGLONG codes[STATUS_CODES];
+    ULONGLONG lengths[CHAIN_BUCKETS]; // chains by hops made
+    HEAVY_HITTERS servers;
+    HEAVY_HITTERS encodings;
+    DISTINCT hosts;
+    DISTINCT targets; // final urls of the chains
+    CRITICAL_SECTION lock;
+}RUN_STATS;
+
+RUN_STATS *create_stats(void);
+void stats_hop(RUN_STATS *stats, int code, const char *host, const char *server, 
+        const char *encoding);
+void stats_chain(RUN_STATS *stats, u_int hops, const char *target, BOOL loop, 
+        BOOL too_long);
+void print_stats(RUN_STATS *stats, FILE *out);
+BOOL write_stats(RUN_STATS *stats, const char *file);
+void free_stats(RUN_STATS *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STATS_H */
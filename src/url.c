@@ -0,0 +1,490 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "url.h"
+
+// Output buffer of resolve and normalize
+typedef struct {
+    char *out;
+    u_int size;
+    u_int len;
+    BOOL overflow;
+}URL_WRITER;
+
+/*
+ * Appends n bytes to the writer, sets overflow if there is no room
+ * One byte is always kept for the terminating Null character
+ */
+static void put(URL_WRITER *w, const char *data, u_int n) {
+    if (w->overflow || w->len + n >= w->size) {
+        w->overflow = TRUE;
+        return;
+    }
+    memcpy(w->out + w->len, data, n);
+    w->len += n;
+}
+
+/*
+ * Appends a url part to the writer
+ */
+static void put_part(URL_WRITER *w, URL_PART part) {
+    if (part.ptr) put(w, part.ptr, part.len);
+}
+
+/*
+ * Appends a url part to the writer in lower case
+ */
+static void put_lower(URL_WRITER *w, URL_PART part) {
+    u_int start = w->len;
+    put_part(w, part);
+    if (w->overflow) return;
+    for (u_int i = start; i < w->len; i++) {
+        if (w->out[i] >= 'A' && w->out[i] <= 'Z') w->out[i] += 'a' - 'A';
+    }
+}
+
+static BOOL is_alpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static BOOL is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/*
+ * Compares the part with a lower case string ignoring case
+ */
+static BOOL part_is(URL_PART part, const char *str) {
+    u_int i;
+    if (!part.ptr) return FALSE;
+    for (i = 0; i < part.len && str[i]; i++) {
+        char c = part.ptr[i];
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        if (c != str[i]) return FALSE;
+    }
+    return i == part.len && !str[i];
+}
+
+/*
+ * Returns the decimal value of a part made of digits
+ */
+static int part_number(URL_PART part) {
+    int value = 0;
+    for (u_int i = 0; i < part.len; i++) value = value * 10 + (part.ptr[i] - '0');
+    return value;
+}
+
+/*
+ * Parses userinfo, host and port starting at p
+ * Returns pointer to the first character after the authority
+ * Returns NULL if the authority is invalid
+ */
+static const char *parse_authority(const char *p, const char *end, URL *url) {
+    const char *stop = p;
+    const char *at = NULL;
+    while (stop < end && *stop != '/' && *stop != '?' && *stop != '#') {
+        if (*stop == '@') at = stop;
+        stop++;
+    }
+    url->authority = TRUE;
+    if (at) {
+        url->userinfo.ptr = p;
+        url->userinfo.len = at - p;
+        p = at + 1;
+    }
+    
+    const char *host_end = p;
+    if (p < stop && *p == '[') {
+        while (host_end < stop && *host_end != ']') host_end++;
+        if (host_end == stop) return NULL;
+        host_end++;
+    } else {
+        while (host_end < stop && *host_end != ':') host_end++;
+    }
+    url->host.ptr = p;
+    url->host.len = host_end - p;
+    
+    if (host_end < stop) {
+        if (*host_end != ':') return NULL;
+        url->port.ptr = host_end + 1;
+        url->port.len = stop - host_end - 1;
+        if (url->port.len > 5) return NULL;
+        for (u_int i = 0; i < url->port.len; i++) {
+            if (!is_digit(url->port.ptr[i])) return NULL;
+        }
+        if (part_number(url->port) > 65535) return NULL;
+    }
+    return stop;
+}
+
+/*
+ * Parses path, query and fragment starting at p
+ */
+static void parse_rest(const char *p, const char *end, URL *url) {
+    url->path.ptr = p;
+    while (p < end && *p != '?' && *p != '#') p++;
+    url->path.len = p - url->path.ptr;
+    
+    if (p < end && *p == '?') {
+        url->query.ptr = ++p;
+        while (p < end && *p != '#') p++;
+        url->query.len = p - url->query.ptr;
+    }
+    if (p < end && *p == '#') {
+        url->fragment.ptr = ++p;
+        url->fragment.len = end - p;
+    }
+}
+
+/*
+ * Removes '.' and '..' segments of the path, RFC 3986 5.2.4
+ * Output is never longer than the input
+ * Returns length written to out
+ */
+static u_int remove_dots(const char *in, u_int len, char *out) {
+    u_int i = 0, o = 0;
+    
+    while (i < len) {
+        u_int left = len - i;
+        const char *p = in + i;
+        
+        if (left >= 3 && strncmp(p, "../", 3) == 0) i += 3;
+        else if (left >= 2 && strncmp(p, "./", 2) == 0) i += 2;
+        else if (left >= 3 && strncmp(p, "/./", 3) == 0) i += 2;
+        else if (left == 2 && strncmp(p, "/.", 2) == 0) {
+            out[o++] = '/';
+            i += 2;
+        }
+        else if ((left >= 4 && strncmp(p, "/../", 4) == 0) ||
+                (left == 3 && strncmp(p, "/..", 3) == 0)) {
+            while (o > 0 && out[--o] != '/');
+            if (left == 3) out[o++] = '/';
+            i += 3;
+        }
+        else if ((left == 1 && p[0] == '.') || 
+                (left == 2 && strncmp(p, "..", 2) == 0)) {
+            break;
+        }
+        else {
+            do {
+                out[o++] = in[i++];
+            } while (i < len && in[i] != '/');
+        }
+    }
+    return o;
+}
+
+/*
+ * Appends the path to the writer without dot segments
+ */
+static void put_path(URL_WRITER *w, const char *path, u_int len) {
+    if (w->overflow || w->len + len >= w->size) {
+        w->overflow = TRUE;
+        return;
+    }
+    w->len += remove_dots(path, len, w->out + w->len);
+}
+
+/*
+ * Appends the authority part, '//' included
+ */
+static void put_authority(URL_WRITER *w, const URL *url, BOOL lower) {
+    put(w, "//", 2);
+    if (url->userinfo.ptr) {
+        put_part(w, url->userinfo);
+        put(w, "@", 1);
+    }
+    if (lower) put_lower(w, url->host);
+    else put_part(w, url->host);
+    if (url->port.ptr) {
+        put(w, ":", 1);
+        put_part(w, url->port);
+    }
+}
+
+/*
+ * Terminates the writer output
+ * Returns the length or 0 if the output did not fit
+ */
+static u_int finish(URL_WRITER *w) {
+    if (w->overflow) {
+        if (w->size) w->out[0] = '\0';
+        return 0;
+    }
+    w->out[w->len] = '\0';
+    return w->len;
+}
+
+/*
+ * Parses the url into its parts with a single pass
+ * Parts point into str, str must stay alive while url is used
+ * Returns FALSE if the url contains spaces, control characters
+ * or an invalid authority
+ */
+BOOL url_parse(const char *str, u_int len, URL *url) {
+    const char *p = str;
+    const char *end = str + len;
+    memset(url, 0, sizeof(URL));
+    
+    for (u_int i = 0; i < len; i++) {
+        if ((unsigned char) str[i] <= ' ' || str[i] == 0x7f) return FALSE;
+    }
+    if (p < end && is_alpha(*p)) {
+        const char *q = p + 1;
+        while (q < end && (is_alpha(*q) || is_digit(*q) || 
+                *q == '+' || *q == '-' || *q == '.')) q++;
+        if (q < end && *q == ':') {
+            url->scheme.ptr = p;
+            url->scheme.len = q - p;
+            p = q + 1;
+        }
+    }
+    if (end - p >= 2 && p[0] == '/' && p[1] == '/') {
+        if (!(p = parse_authority(p + 2, end, url))) return FALSE;
+    }
+    parse_rest(p, end, url);
+    return TRUE;
+}
+
+/*
+ * Parses a url typed by the user or read from a list
+ * Scheme may be left out, as in www.example.com/about
+ * Returns FALSE if the url has no hostname or a scheme
+ * other than http and https
+ */
+BOOL url_parse_input(const char *str, u_int len, URL *url) {
+    if (!url_parse(str, len, url)) return FALSE;
+    if (url->authority) {
+        return url->host.len > 0 && 
+                (part_is(url->scheme, "http") || part_is(url->scheme, "https"));
+    }
+    if (part_is(url->scheme, "http") || part_is(url->scheme, "https")) return FALSE;
+    
+    // no scheme, the input starts with the host
+    memset(url, 0, sizeof(URL));
+    const char *rest = parse_authority(str, str + len, url);
+    if (!rest) return FALSE;
+    parse_rest(rest, str + len, url);
+    return url->host.len > 0;
+}
+
+/*
+ * Resolves a reference such as a Location value against
+ * the base url, RFC 3986 5.2.2
+ * Writes the target url to out
+ * Returns its length, 0 if it does not fit
+ */
+u_int url_resolve(const URL *base, const URL *ref, char *out, u_int size) {
+    URL_WRITER w = {out, size, 0, FALSE};
+    char merged[URL_MAX];
+    const URL *auth = base;
+    URL_PART scheme = base->scheme;
+    URL_PART path = ref->path;
+    URL_PART query = ref->query;
+    BOOL dots = TRUE;
+    
+    if (ref->scheme.ptr) {
+        scheme = ref->scheme;
+        auth = ref;
+    } else if (ref->authority) {
+        auth = ref;
+    } else if (!ref->path.len) {
+        path = base->path;
+        if (!ref->query.ptr) query = base->query;
+        dots = FALSE;
+    } else if (ref->path.ptr[0] != '/') {
+        // merge with the directory of the base path
+        u_int n = 0;
+        if (base->authority && !base->path.len) merged[n++] = '/';
+        else {
+            for (u_int i = 0; i < base->path.len; i++) {
+                if (base->path.ptr[i] == '/') n = i + 1;
+            }
+            memcpy(merged, base->path.ptr, n);
+        }
+        if (n + ref->path.len > URL_MAX) {
+            w.overflow = TRUE;
+            return finish(&w);
+        }
+        memcpy(merged + n, ref->path.ptr, ref->path.len);
+        path.ptr = merged;
+        path.len = n + ref->path.len;
+    }
+    
+    if (scheme.ptr) {
+        put_part(&w, scheme);
+        put(&w, ":", 1);
+    }
+    if (auth->authority) put_authority(&w, auth, FALSE);
+    if (dots) put_path(&w, path.ptr, path.len);
+    else put_part(&w, path);
+    if (query.ptr) {
+        put(&w, "?", 1);
+        put_part(&w, query);
+    }
+    if (ref->fragment.ptr) {
+        put(&w, "#", 1);
+        put_part(&w, ref->fragment);
+    }
+    return finish(&w);
+}
+
+/*
+ * Writes the normalized form of the url to out, used as
+ * key for sharing and caching:
+ * lower case scheme and host, default port and fragment dropped,
+ * dot segments removed, empty path as '/', upper case escapes
+ * Returns its length, 0 if it does not fit
+ */
+u_int url_normalize(const URL *url, char *out, u_int size) {
+    URL_WRITER w = {out, size, 0, FALSE};
+    
+    if (url->scheme.ptr) put_lower(&w, url->scheme);
+    else put(&w, "http", 4);
+    put(&w, ":", 1);
+    
+    URL copy = *url;
+    if (copy.port.ptr && (!copy.port.len || url_port(url) == (url_is_https(url) ? 443 : 80))) {
+        copy.port.ptr = NULL;
+    }
+    put_authority(&w, &copy, TRUE);
+    
+    u_int start = w.len;
+    if (url->path.len) put_path(&w, url->path.ptr, url->path.len);
+    if (w.len == start) put(&w, "/", 1);
+    if (url->query.ptr) {
+        put(&w, "?", 1);
+        put_part(&w, url->query);
+    }
+    if (w.overflow) return finish(&w);
+    
+    for (u_int i = start; i + 2 < w.len; i++) {
+        if (w.out[i] != '%') continue;
+        for (int k = 1; k <= 2; k++) {
+            if (w.out[i + k] >= 'a' && w.out[i + k] <= 'f') w.out[i + k] -= 'a' - 'A';
+        }
+    }
+    return finish(&w);
+}
+
+/*
+ * Returns the port of the url, scheme default if not given
+ */
+int url_port(const URL *url) {
+    if (url->port.len) return part_number(url->port);
+    return url_is_https(url) ? 443 : 80;
+}
+
+/*
+ * Checks whether the url scheme is https
+ */
+BOOL url_is_https(const URL *url) {
+    return part_is(url->scheme, "https");
+}
+
+/*
+ * Copies the part into out as a Null terminated string
+ * Truncates parts that do not fit, returns out
+ */
+char *url_copy_part(URL_PART part, char *out, u_int size) {
+    u_int n = part.len < size ? part.len : size - 1;
+    if (part.ptr) memcpy(out, part.ptr, n);
+    else n = 0;
+    out[n] = '\0';
+    return out;
+}
+
+/*
+ * FNV-1a hash of the url
+ */
+static u_int url_hash(const char *url) {
+    u_int hash = 2166136261u;
+    for (; *url; url++) {
+        hash ^= (unsigned char) *url;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Prepares an empty set, size is rounded up to a power of two
+ */
+void url_set_init(URL_SET *set, u_int size) {
+    set->size = 8;
+    while (set->size < size) set->size *= 2;
+    set->hashes = (u_int*) malloc(sizeof(u_int) * set->size);
+    set->urls = (char**) calloc(set->size, sizeof(char*));
+    set->count = 0;
+}
+
+/*
+ * Finds the slot of the url, or the empty slot it would go in
+ */
+static u_int url_set_slot(URL_SET *set, const char *url, u_int hash) {
+    u_int slot = hash & (set->size - 1);
+    while (set->urls[slot] && (set->hashes[slot] != hash || strcmp(set->urls[slot], url) != 0)) {
+        slot = (slot + 1) & (set->size - 1);
+    }
+    return slot;
+}
+
+/*
+ * Adds the url to the set, doubling it once half full
+ * Returns FALSE if the url was already in the set
+ */
+BOOL url_set_add(URL_SET *set, const char *url) {
+    u_int hash = url_hash(url);
+    u_int slot = url_set_slot(set, url, hash);
+    if (set->urls[slot]) return FALSE;
+    
+    set->hashes[slot] = hash;
+    set->urls[slot] = strdup(url);
+    if (++set->count * 2 > set->size) {
+        URL_SET grown;
+        url_set_init(&grown, set->size * 2);
+        for (u_int i = 0; i < set->size; i++) {
+            if (!set->urls[i]) continue;
+            slot = url_set_slot(&grown, set->urls[i], set->hashes[i]);
+            grown.hashes[slot] = set->hashes[i];
+            grown.urls[slot] = set->urls[i];
+        }
+        grown.count = set->count;
+        free(set->hashes);
+        free(set->urls);
+        *set = grown;
+    }
+    return TRUE;
+}
+
+/*
+ * Frees the urls of the set
+ */
+void url_set_free(URL_SET *set) {
+    for (u_int i = 0; i < set->size; i++) {
+        if (set->urls[i]) free(set->urls[i]);
+    }
+    free(set->hashes);
+    free(set->urls);
+}
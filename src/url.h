@@ -0,0 +1,89 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   url.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * RFC 3986 url parsing, reference resolution and normalization
+ * Parsed parts are views into the caller's string, nothing is allocated
+ * Sets of normalized urls find redirect loops
+ * 
+ * Created on October 20, 2026, 10:15 AM
+ */
+
+#ifndef URL_H
+#define URL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+
+#define URL_MAX 2048 // longest url built by resolve and normalize
+
+// Part of a string, not NUL terminated
+// ptr is NULL if the part is not present at all
+typedef struct {
+    const char *ptr;
+    u_int len;
+}URL_PART;
+
+// Components of a url, the delimiters are not included
+typedef struct {
+    URL_PART scheme;
+    URL_PART userinfo;
+    URL_PART host; // brackets kept for IPv6 literals
+    URL_PART port;
+    URL_PART path;
+    URL_PART query;
+    URL_PART fragment;
+    BOOL authority; // '//' was present
+}URL;
+
+// Set of normalized urls, open addressed
+typedef struct {
+    u_int *hashes;
+    char **urls; // NULL for empty slots
+    u_int size; // slots, a power of two
+    u_int count;
+}URL_SET;
+
+BOOL url_parse(const char *str, u_int len, URL *url);
+BOOL url_parse_input(const char *str, u_int len, URL *url);
+u_int url_resolve(const URL *base, const URL *ref, char *out, u_int size);
+u_int url_normalize(const URL *url, char *out, u_int size);
+int url_port(const URL *url);
+BOOL url_is_https(const URL *url);
+char *url_copy_part(URL_PART part, char *out, u_int size);
+void url_set_init(URL_SET *set, u_int size);
+BOOL url_set_add(URL_SET *set, const char *url);
+void url_set_free(URL_SET *set);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* URL_H */
@@ -0,0 +1,204 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "urllist.h"
+#include "url.h"
+
+/*
+ * Appends a url to the chunk tables, growing them as needed
+ */
+static void add_url(URL_CHUNK *chunk, const char *url, u_int len, u_int interval,
+        u_int line, u_int *url_cap, u_int *text_cap) {
+    if (chunk->count == *url_cap) {
+        *url_cap = *url_cap ? *url_cap * 2 : 256;
+        chunk->offsets = (u_int*) realloc(chunk->offsets, sizeof(u_int) * *url_cap);
+        chunk->lines = (u_int*) realloc(chunk->lines, sizeof(u_int) * *url_cap);
+        chunk->intervals = (u_int*) realloc(chunk->intervals, sizeof(u_int) * *url_cap);
+    }
+    while (chunk->text_len + len + 1 > *text_cap) {
+        *text_cap = *text_cap ? *text_cap * 2 : 16384;
+        chunk->text = (char*) realloc(chunk->text, *text_cap);
+    }
+    chunk->offsets[chunk->count] = chunk->text_len;
+    chunk->lines[chunk->count] = line;
+    chunk->intervals[chunk->count] = interval;
+    memcpy(chunk->text + chunk->text_len, url, len);
+    chunk->text_len += len;
+    chunk->text[chunk->text_len++] = '\0';
+    chunk->count++;
+}
+
+/*
+ * Parses every line of the chunk
+ * Each line is a url, optionally followed by a number
+ * Empty lines and lines starting with '#' are skipped
+ * Valid urls are stored normalized, invalid ones as they are
+ */
+static void parse_chunk(URL_CHUNK *chunk) {
+    const char *p = chunk->start;
+    const char *end = p + chunk->len;
+    u_int url_cap = 0, text_cap = 0, line = 0;
+    char normal[URL_MAX];
+    
+    while (p < end) {
+        const char *eol = (const char*) memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+        const char *q = p;
+        
+        while (q < eol && (*q == ' ' || *q == '\t' || *q == '\r')) q++;
+        if (q < eol && *q != '#') {
+            const char *url = q;
+            while (q < eol && *q != ' ' && *q != '\t' && *q != '\r') q++;
+            u_int len = q - url;
+            u_int interval = 0;
+            while (q < eol && (*q == ' ' || *q == '\t')) q++;
+            while (q < eol && *q >= '0' && *q <= '9') interval = interval * 10 + (*q++ - '0');
+            
+            URL parsed;
+            u_int normal_len = 0;
+            if (len < URL_MAX && url_parse_input(url, len, &parsed)) {
+                normal_len = url_normalize(&parsed, normal, URL_MAX);
+            }
+            if (normal_len) add_url(chunk, normal, normal_len, interval, line, &url_cap, &text_cap);
+            else add_url(chunk, url, len, interval, line, &url_cap, &text_cap);
+        }
+        line++;
+        p = eol + 1;
+    }
+    chunk->line_count = line;
+}
+
+/*
+ * Parser thread, takes chunks in file order until none are left
+ */
+static DWORD WINAPI parser_thread(LPVOID param) {
+    URL_LIST *list = (URL_LIST*) param;
+    LONG i;
+    
+    while ((i = InterlockedIncrement(&list->next_chunk) - 1) < (LONG) list->chunk_count) {
+        parse_chunk(&list->chunks[i]);
+        EnterCriticalSection(&list->lock);
+        list->chunks[i].ready = TRUE;
+        LeaveCriticalSection(&list->lock);
+        WakeAllConditionVariable(&list->ready);
+    }
+    return 0;
+}
+
+/*
+ * Maps the list file and starts parsing it in the background
+ * Returns NULL if the file can not be opened or mapped
+ */
+URL_LIST *open_url_list(const char *filename) {
+    URL_LIST *list = (URL_LIST*) calloc(1, sizeof(URL_LIST));
+    
+    if (!map_file(filename, &list->map)) {
+        printf("unable to open url list: %s\n", filename);
+        free(list);
+        return NULL;
+    }
+    InitializeCriticalSection(&list->lock);
+    InitializeConditionVariable(&list->ready);
+    
+    const char *data = list->map.data;
+    ULONGLONG size = list->map.size;
+    
+    // newline aligned chunks, each at least CHUNK_SIZE except the last
+    list->chunks = (URL_CHUNK*) calloc(size / CHUNK_SIZE + 1, sizeof(URL_CHUNK));
+    ULONGLONG pos = 0;
+    while (pos < size) {
+        ULONGLONG end = pos + CHUNK_SIZE;
+        if (end >= size) end = size;
+        else {
+            const char *nl = (const char*) memchr(data + end, '\n', size - end);
+            end = nl ? (ULONGLONG) (nl - data) + 1 : size;
+        }
+        list->chunks[list->chunk_count].start = data + pos;
+        list->chunks[list->chunk_count].len = (u_int) (end - pos);
+        list->chunk_count++;
+        pos = end;
+    }
+    
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    u_int parsers = info.dwNumberOfProcessors;
+    if (parsers > MAX_PARSERS) parsers = MAX_PARSERS;
+    if (parsers > list->chunk_count) parsers = list->chunk_count;
+    for (u_int i = 0; i < parsers; i++) {
+        list->parsers[i] = CreateThread(NULL, 0, parser_thread, list, 0, NULL);
+        if (list->parsers[i]) list->parser_count++;
+    }
+    if (!list->parser_count) parser_thread(list);
+    return list;
+}
+
+/*
+ * Hands out the next url of the list in file order
+ * Waits for its chunk to be parsed if needed
+ * Returns FALSE at the end of the list
+ */
+BOOL next_url(URL_LIST *list, URL_ENTRY *entry) {
+    while (list->cursor_chunk < list->chunk_count) {
+        URL_CHUNK *chunk = &list->chunks[list->cursor_chunk];
+        if (!chunk->ready) {
+            EnterCriticalSection(&list->lock);
+            while (!chunk->ready) {
+                SleepConditionVariableCS(&list->ready, &list->lock, INFINITE);
+            }
+            LeaveCriticalSection(&list->lock);
+        }
+        if (list->cursor_index < chunk->count) {
+            u_int i = list->cursor_index++;
+            entry->url = chunk->text + chunk->offsets[i];
+            entry->interval = chunk->intervals[i];
+            entry->line = list->base_line + chunk->lines[i] + 1;
+            return TRUE;
+        }
+        list->base_line += chunk->line_count;
+        list->cursor_chunk++;
+        list->cursor_index = 0;
+    }
+    return FALSE;
+}
+
+/*
+ * Waits for the parsers, unmaps the file and frees the tables
+ */
+void close_url_list(URL_LIST *list) {
+    for (u_int i = 0; i < list->parser_count; i++) {
+        WaitForSingleObject(list->parsers[i], INFINITE);
+        CloseHandle(list->parsers[i]);
+    }
+    for (u_int i = 0; i < list->chunk_count; i++) {
+        free(list->chunks[i].text);
+        free(list->chunks[i].offsets);
+        free(list->chunks[i].lines);
+        free(list->chunks[i].intervals);
+    }
+    if (list->chunks) free(list->chunks);
+    unmap_file(&list->map);
+    DeleteCriticalSection(&list->lock);
+    free(list);
+}
@@ -0,0 +1,93 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   urllist.h
+ * Author: Arda 'Arc' Akgur
+ *
+ * Url list ingestion for the batch and monitor modes
+ * The list file is memory mapped and split into newline aligned chunks
+ * that are parsed and normalized in parallel into compact tables.
+ * Urls can be consumed in order as soon as their chunk is ready.
+ * 
+ * Created on October 20, 2026, 3:30 PM
+ */
+
+#ifndef URLLIST_H
+#define URLLIST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utilities.h"
+
+#define CHUNK_SIZE (4 << 20) // bytes of list file per chunk
+#define MAX_PARSERS 16
+
+// Parsed urls of one chunk
+typedef struct {
+    const char *start; // chunk bytes in the mapped file
+    u_int len;
+    char *text; // normalized urls, Null separated
+    u_int text_len;
+    u_int *offsets; // url i starts at text + offsets[i]
+    u_int *lines; // line of url i within the chunk, from 0
+    u_int *intervals; // optional second column, 0 if not given
+    u_int count;
+    u_int line_count; // lines in the chunk
+    volatile LONG ready;
+}URL_CHUNK;
+
+// A url handed out by next_url()
+typedef struct {
+    char *url; // valid until the list is closed
+    u_int interval;
+    u_int line; // input line number, from 1
+}URL_ENTRY;
+
+// Memory mapped list file and its chunks
+typedef struct {
+    MAPPED_FILE map;
+    URL_CHUNK *chunks;
+    u_int chunk_count;
+    volatile LONG next_chunk; // next chunk for a parser thread
+    HANDLE parsers[MAX_PARSERS];
+    u_int parser_count;
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE ready;
+    u_int cursor_chunk; // consumer position
+    u_int cursor_index;
+    u_int base_line; // lines in the chunks before cursor_chunk
+}URL_LIST;
+
+URL_LIST *open_url_list(const char *filename);
+BOOL next_url(URL_LIST *list, URL_ENTRY *entry);
+void close_url_list(URL_LIST *list);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* URLLIST_H */
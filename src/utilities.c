@@ -1,152 +1,235 @@
-/*
- * The MIT License
- *
- * Copyright 2018 Arda 'Arc' Akgur.
- *
- * Permission is hereby granted, free of charge, to any person obtaining a copy
- * of this software and associated documentation files (the "Software"), to deal
- * in the Software without restriction, including without limitation the rights
- * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
- * copies of the Software, and to permit persons to whom the Software is
- * furnished to do so, subject to the following conditions:
- *
- * The above copyright notice and this permission notice shall be included in
- * all copies or substantial portions of the Software.
- *
- * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
- * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
- * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
- * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
- * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
- * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
- * THE SOFTWARE.
- */
-
-
-#include "utilities.h"
-
-
-/*
- * Replaces the carriage return '\r' character
- * with Null character
- */
-void change_carriage_return(char *data) {
-    for (int i = 0; i < strlen(data); i++) {
-        if (data[i] == '\r') data[i] = '\0';
-    }
-}
-
-/*
- * Counts how many times the Delimeter appears in 
- * the given data
- */
-u_int how_many_lines(char *data, char delim) {
-    u_int count = 0;
-    for (int i = 0; i < strlen(data); i++) {
-        if (data[i] == delim) count++;
-    }
-    return count;
-}
-
-/*
- * Splits the given string into array of strings
- * Split occurs via delimeter character
- * Return value needs to be freed after usage
- */
-char **split_string(char *str, char delim) {
-    char **out = (char**) malloc(sizeof(char*) * how_many_lines(str, delim));
-    for (u_int i = 0; i < how_many_lines(str, delim); i++)
-        out[i] = (char*) malloc(sizeof(char) * 1024);
-    int line = 0;
-    int pos = 0;
-    for (int i = 0; i < strlen(str); i++) {
-        if (str[i] == delim) {
-            out[line][pos] = '\0';
-            line++;
-            pos = 0;
-            continue;
-        }
-        out[line][pos++] = str[i];
-    }
-    return out;
-}
-
-/*
- * Writes the given results to a file
- * it asks user for a output file name
- */
-void save_results(char *results) {
-    
-    char filename[100];
-    FILE *file = NULL;
-    while (file == NULL) {
-        printf("Please enter output file name(ex: out.txt): ");
-        if (!fgets(filename, 99, stdin)) {
-            puts("End of input from user, saving output to output.txt");
-            strcpy(filename, "output.txt");
-        }
-        filename[strlen(filename) - 1] = '\0';
-        file = fopen(filename, "w");
-        if (!file) puts("unable to open file for save");
-    }
-    
-    fputs(results, file);
-    
-    fclose(file);
-    
-}
-
-char **split_url(char *url) {
-    // www.abc.com/news
-    // /news/sport
-    char **ret = (char**) malloc(sizeof(char*) * 2);
-    for (int i = 0; i < 2; i++) {
-        ret[i] = (char*) malloc(sizeof(char) * 300);
-    }
-    int k = 0;
-    int z = 0;
-    BOOL ok = TRUE;
-    for (int i = 0; i < strlen(url); i++) {
-        if (ok && url[i] == '/') {
-            ret[k][z] = '\0';
-            k++;
-            z = 0;
-            ok = FALSE;
-            continue;
-        }
-        ret[k][z++] = url[i];
-    }
-    ret[k][z] = '\0';
-    
-    return ret;
-}
-
-/*
- * Gets and returns the Code from the given data
- * Data input must be like 302 Found, 404 Not Found, 200 OK etc..
- * Return value is a new string pointer
- */
-char *get_code(char *data) {
-    // 302 Found
-    char *out = (char*) malloc(4);
-    for (int i = 0; i < 3; i++) {
-        out[i] = data[i];
-    }
-    out[3] = '\0';
-    return out;
-}
-
-/*
- * Duplicates the given string
- * Returns a brand new String pointer
- */
-char *strdup(const char *data) {
-    
-    char *out = (char*) malloc(strlen(data) + 1);
-    int i;
-    for (i = 0; i < strlen(data); i++) {
-        out[i] = data[i];
-    }
-    out[i] = '\0';
-    return out;
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "utilities.h"
+
+
+/*
+ * Replaces the carriage return '\r' character
+ * with Null character
+ */
+void change_carriage_return(char *data) {
+    for (int i = 0; i < strlen(data); i++) {
+        if (data[i] == '\r') data[i] = '\0';
+    }
+}
+
+/*
+ * Counts how many times the Delimeter appears in 
+ * the given data
+ */
+u_int how_many_lines(char *data, char delim) {
+    u_int count = 0;
+    for (int i = 0; i < strlen(data); i++) {
+        if (data[i] == delim) count++;
+    }
+    return count;
+}
+
+/*
+ * Splits the given string into array of strings
+ * Split occurs via delimeter character
+ * Return value needs to be freed after usage
+ */
+char **split_string(char *str, char delim) {
+    char **out = (char**) malloc(sizeof(char*) * how_many_lines(str, delim));
+    for (u_int i = 0; i < how_many_lines(str, delim); i++)
+        out[i] = (char*) malloc(sizeof(char) * 1024);
+    int line = 0;
+    int pos = 0;
+    for (int i = 0; i < strlen(str); i++) {
+        if (str[i] == delim) {
+            out[line][pos] = '\0';
+            line++;
+            pos = 0;
+            continue;
+        }
+        if (pos < 1023) out[line][pos++] = str[i];
+    }
+    return out;
+}
+
+/*
+ * Writes the given results to a file
+ * it asks user for a output file name
+ */
+void save_results(char *results) {
+    
+    char filename[100];
+    FILE *file = NULL;
+    while (file == NULL) {
+        printf("Please enter output file name(ex: out.txt): ");
+        if (!fgets(filename, 99, stdin)) {
+            puts("End of input from user, saving output to output.txt");
+            strcpy(filename, "output.txt");
+        }
+        filename[strlen(filename) - 1] = '\0';
+        file = fopen(filename, "w");
+        if (!file) puts("unable to open file for save");
+    }
+    
+    fputs(results, file);
+    
+    fclose(file);
+    
+}
+
+/*
+ * Maps the whole file read only
+ * Empty files are not mapped, map->data is NULL for them
+ * Returns FALSE if the file can not be opened or mapped
+ */
+BOOL map_file(const char *filename, MAPPED_FILE *map) {
+    LARGE_INTEGER size;
+    map->mapping = NULL;
+    map->data = NULL;
+    map->size = 0;
+    map->file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+            NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (map->file == INVALID_HANDLE_VALUE) return FALSE;
+    if (!GetFileSizeEx(map->file, &size)) {
+        CloseHandle(map->file);
+        map->file = INVALID_HANDLE_VALUE;
+        return FALSE;
+    }
+    map->size = (ULONGLONG) size.QuadPart;
+    if (!map->size) return TRUE;
+    
+    map->mapping = CreateFileMappingA(map->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (map->mapping) {
+        map->data = (const char*) MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (!map->data) {
+        unmap_file(map);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Releases a view created by map_file()
+ */
+void unmap_file(MAPPED_FILE *map) {
+    if (map->data) UnmapViewOfFile(map->data);
+    if (map->mapping) CloseHandle(map->mapping);
+    if (map->file != INVALID_HANDLE_VALUE) CloseHandle(map->file);
+    map->data = NULL;
+    map->mapping = NULL;
+    map->file = INVALID_HANDLE_VALUE;
+}
+
+/*
+ * Cuts the file down to size bytes
+ */
+BOOL truncate_file(const char *name, ULONGLONG size) {
+    LARGE_INTEGER end;
+    HANDLE file = CreateFileA(name, GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_EXISTING, 
+            FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return FALSE;
+    end.QuadPart = (LONGLONG) size;
+    BOOL ok = SetFilePointerEx(file, end, NULL, FILE_BEGIN) && SetEndOfFile(file);
+    CloseHandle(file);
+    return ok;
+}
+
+/*
+ * Starts an empty text with room for size bytes
+ */
+void text_init(TEXT_BUFFER *text, u_int size) {
+    text->size = size ? size : 64;
+    text->data = (char*) malloc(text->size);
+    text->data[0] = '\0';
+    text->len = 0;
+}
+
+/*
+ * Appends printf style formatted text, growing the buffer as needed
+ */
+void text_append(TEXT_BUFFER *text, const char *format, ...) {
+    va_list args;
+    while (TRUE) {
+        va_start(args, format);
+        int len = vsnprintf(text->data + text->len, text->size - text->len, format, args);
+        va_end(args);
+        if (len < 0) return;
+        if (text->len + len < text->size) {
+            text->len += len;
+            return;
+        }
+        while (text->len + len >= text->size) text->size *= 2;
+        text->data = (char*) realloc(text->data, text->size);
+    }
+}
+
+/*
+ * Appends str as a quoted JSON string, null if str is NULL
+ */
+void text_json_string(TEXT_BUFFER *text, const char *str) {
+    if (!str) {
+        text_append(text, "null");
+        return;
+    }
+    const char *run = str;
+    text_append(text, "\"");
+    for (; *str; str++) {
+        unsigned char c = (unsigned char) *str;
+        if (c != '"' && c != '\\' && c >= 0x20) continue;
+        text_append(text, "%.*s", (int) (str - run), run);
+        if (c < 0x20) text_append(text, "\\u%04x", c);
+        else text_append(text, "\\%c", c);
+        run = str + 1;
+    }
+    text_append(text, "%s\"", run);
+}
+
+/*
+ * Gets and returns the Code from the given data
+ * Data input must be like 302 Found, 404 Not Found, 200 OK etc..
+ * Return value is a new string pointer
+ */
+char *get_code(char *data) {
+    // 302 Found
+    char *out = (char*) malloc(4);
+    for (int i = 0; i < 3; i++) {
+        out[i] = data[i];
+    }
+    out[3] = '\0';
+    return out;
+}
+
+/*
+ * Duplicates the given string
+ * Returns a brand new String pointer
+ */
+char *strdup(const char *data) {
+    
+    char *out = (char*) malloc(strlen(data) + 1);
+    int i;
+    for (i = 0; i < strlen(data); i++) {
+        out[i] = data[i];
+    }
+    out[i] = '\0';
+    return out;
 }
\ No newline at end of file
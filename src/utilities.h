@@ -1,66 +1,95 @@
-/*
- * The MIT License
- *
- * Copyright 2018 Arda 'Arc' Akgur.
- *
- * Permission is hereby granted, free of charge, to any person obtaining a copy
- * of this software and associated documentation files (the "Software"), to deal
- * in the Software without restriction, including without limitation the rights
- * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
- * copies of the Software, and to permit persons to whom the Software is
- * furnished to do so, subject to the following conditions:
- *
- * The above copyright notice and this permission notice shall be included in
- * all copies or substantial portions of the Software.
- *
- * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
- * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
- * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
- * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
- * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
- * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
- * THE SOFTWARE.
- */
-
-/* 
- * File:   utilities.h
- * Author: arc
- *
- * Created on March 22, 2018, 10:54 PM
- */
-
-#ifndef UTILITIES_H
-#define UTILITIES_H
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-#include <string.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <winsock2.h>
-#define TRUE 1  
-#define FALSE 0
-#define HTTP "http://"
-#define HTTPS "https://"
-
-typedef int BOOL; //Boolean type
-char *strdup(const char *data); //String duplicate method
-char *get_code(char *data);
-void change_carriage_return(char *data);
-char **split_string(char *str, char delim);
-u_int how_many_lines(char *data, char delim);
-char **split_url(char *url);
-void save_results(char *results);
-
-    
-
-
-
-#ifdef __cplusplus
-}
-#endif
-
-#endif /* UTILITIES_H */
-
+/*
+ * The MIT License
+ *
+ * Copyright 2018 Arda 'Arc' Akgur.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   utilities.h
+ * Author: arc
+ *
+ * Created on March 22, 2018, 10:54 PM
+ */
+
+#ifndef UTILITIES_H
+#define UTILITIES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <winsock2.h>
+#define TRUE 1  
+#define FALSE 0
+#define HTTP "http://"
+#define HTTPS "https://"
+
+// Storage that is private to each thread
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+typedef int BOOL; //Boolean type
+
+// Read only memory mapped view of a whole file
+typedef struct {
+    HANDLE file;
+    HANDLE mapping;
+    const char *data; // NULL for empty files
+    ULONGLONG size;
+}MAPPED_FILE;
+
+// Text that grows as it is appended to, always NUL terminated
+typedef struct {
+    char *data;
+    u_int len;
+    u_int size;
+}TEXT_BUFFER;
+
+char *strdup(const char *data); //String duplicate method
+char *get_code(char *data);
+void change_carriage_return(char *data);
+char **split_string(char *str, char delim);
+u_int how_many_lines(char *data, char delim);
+void save_results(char *results);
+BOOL map_file(const char *filename, MAPPED_FILE *map);
+void unmap_file(MAPPED_FILE *map);
+BOOL truncate_file(const char *name, ULONGLONG size);
+void text_init(TEXT_BUFFER *text, u_int size);
+void text_append(TEXT_BUFFER *text, const char *format, ...);
+void text_json_string(TEXT_BUFFER *text, const char *str);
+
+    
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UTILITIES_H */
+